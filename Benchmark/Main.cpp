@@ -0,0 +1,169 @@
+#include <JuceHeader.h>
+#include "PluginBenchmark.h"
+
+//==============================================================================
+static void printUsage()
+{
+    std::printf ("usage: PluginBenchmark [options]\n"
+                 "  --plugin NAME[,NAME...]  only benchmark these plugins (default: all)\n"
+                 "  --input FILE             loop an audio file as the input instead of the synthetic signal\n"
+                 "  --seconds S              audio time rendered per measurement (default: 2)\n"
+                 "  --rates R[,R...]         sample rates (default: 44100,48000,96000)\n"
+                 "  --blocks N[,N...]        block sizes (default: 32,64,128,256,512,1024)\n"
+                 "  --no-modes               only measure the default parameter values\n"
+                 "  --csv                    print comma separated values instead of a table\n"
+                 "  --list                   print the plugin names and exit\n");
+}
+
+template <typename NumberType>
+static std::vector<NumberType> parseList (const juce::String& text)
+{
+    std::vector<NumberType> values;
+
+    for (const auto& token : juce::StringArray::fromTokens (text, ",", ""))
+        if (token.trim().isNotEmpty())
+            values.push_back ((NumberType) token.trim().getDoubleValue());
+
+    return values;
+}
+
+// Reads a whole audio file, or returns false if it cannot be opened
+static bool loadInput (const juce::File& file, juce::AudioBuffer<float>& buffer)
+{
+    juce::AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+
+    std::unique_ptr<juce::AudioFormatReader> reader (formatManager.createReaderFor (file));
+
+    if (reader == nullptr || reader->lengthInSamples <= 0)
+        return false;
+
+    buffer.setSize ((int) reader->numChannels, (int) reader->lengthInSamples);
+    reader->read (&buffer, 0, (int) reader->lengthInSamples, 0, true, true);
+    return true;
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.containsOption ("--help|-h"))
+    {
+        printUsage();
+        return 0;
+    }
+
+    auto plugins = getAllPlugins();
+
+    if (args.containsOption ("--list"))
+    {
+        for (const auto& plugin : plugins)
+            std::printf ("%s\n", plugin.name.toRawUTF8());
+
+        return 0;
+    }
+
+    BenchmarkOptions options;
+    juce::AudioBuffer<float> input;
+
+    if (args.containsOption ("--plugin"))
+    {
+        const auto names = juce::StringArray::fromTokens (args.getValueForOption ("--plugin"), ",", "");
+
+        plugins.erase (std::remove_if (plugins.begin(), plugins.end(),
+                                       [&] (const PluginInfo& plugin) { return ! names.contains (plugin.name); }),
+                       plugins.end());
+
+        if (plugins.empty())
+        {
+            std::fprintf (stderr, "No plugin matches '%s', see --list\n", args.getValueForOption ("--plugin").toRawUTF8());
+            return 1;
+        }
+    }
+
+    if (args.containsOption ("--input"))
+    {
+        const auto file = juce::File::getCurrentWorkingDirectory().getChildFile (args.getValueForOption ("--input"));
+
+        if (! loadInput (file, input))
+        {
+            std::fprintf (stderr, "Could not read %s\n", file.getFullPathName().toRawUTF8());
+            return 1;
+        }
+
+        options.input = &input;
+    }
+
+    if (args.containsOption ("--seconds"))
+        options.secondsPerRun = juce::jmax (0.01, args.getValueForOption ("--seconds").getDoubleValue());
+
+    if (args.containsOption ("--rates"))
+        options.sampleRates = parseList<double> (args.getValueForOption ("--rates"));
+
+    if (args.containsOption ("--blocks"))
+        options.blockSizes = parseList<int> (args.getValueForOption ("--blocks"));
+
+    options.sweepModes = ! args.containsOption ("--no-modes");
+
+    const bool csv = args.containsOption ("--csv");
+
+    if (csv)
+        std::printf ("plugin,mode,sample_rate,block_size,ns_per_sample,realtime_factor,worst_block_us,worst_block_load\n");
+    else
+        std::printf ("%-14s %-40s %7s %6s %10s %10s %12s %8s\n",
+                     "plugin", "mode", "rate", "block", "ns/sample", "realtime", "worst us", "worst %");
+
+    PluginBenchmark benchmark (options);
+    std::vector<BenchmarkResult> worstCases;
+
+    for (const auto& plugin : plugins)
+    {
+        BenchmarkResult slowest {}, worstBlock {};
+
+        benchmark.run (plugin, [&] (const BenchmarkResult& result)
+        {
+            if (csv)
+                std::printf ("%s,\"%s\",%.0f,%d,%.3f,%.2f,%.3f,%.5f\n",
+                             result.plugin.toRawUTF8(), result.mode.toRawUTF8(), result.sampleRate, result.blockSize,
+                             result.nanosecondsPerSample, result.realTimeFactor,
+                             result.worstBlockMicroseconds, result.worstBlockLoad);
+            else
+                std::printf ("%-14s %-40s %7.0f %6d %10.2f %10.1f %12.2f %8.2f\n",
+                             result.plugin.toRawUTF8(), result.mode.toRawUTF8(), result.sampleRate, result.blockSize,
+                             result.nanosecondsPerSample, result.realTimeFactor,
+                             result.worstBlockMicroseconds, result.worstBlockLoad * 100.0);
+
+            std::fflush (stdout);
+
+            if (result.nanosecondsPerSample > slowest.nanosecondsPerSample)
+                slowest = result;
+
+            if (result.worstBlockLoad > worstBlock.worstBlockLoad)
+                worstBlock = result;
+        });
+
+        worstCases.push_back (slowest);
+        worstCases.push_back (worstBlock);
+    }
+
+    if (! csv)
+    {
+        // Per plugin: the slowest configuration on average, then the one closest to missing a deadline
+        std::printf ("\nWorst cases\n");
+
+        for (size_t i = 0; i + 1 < worstCases.size(); i += 2)
+        {
+            const auto& slowest = worstCases[i];
+            const auto& worstBlock = worstCases[i + 1];
+
+            std::printf ("%-14s %8.2f ns/sample (%s, %.0f Hz, %d)   worst block %6.2f%% of its period (%s, %.0f Hz, %d)\n",
+                         slowest.plugin.toRawUTF8(), slowest.nanosecondsPerSample,
+                         slowest.mode.toRawUTF8(), slowest.sampleRate, slowest.blockSize,
+                         worstBlock.worstBlockLoad * 100.0,
+                         worstBlock.mode.toRawUTF8(), worstBlock.sampleRate, worstBlock.blockSize);
+        }
+    }
+
+    return 0;
+}
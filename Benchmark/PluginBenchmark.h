@@ -0,0 +1,238 @@
+/*******************************************************************************
+
+ name:             PluginBenchmark
+ description:      offline render and timing of plugin processors.
+
+ Drives a processor the way a host does, without an audio device: the processor
+ is configured for stereo at the requested sample rate and block size, prepared,
+ warmed up, and then fed the input one block at a time while every processBlock
+ call is timed. Copying the input into the block is not timed.
+
+ Each integer parameter (waveforms, modes, voice and echo counts) selects a
+ different code path, so by default every combination of them is measured.
+ Float parameters stay at their defaults.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "PluginList.h"
+
+
+//==============================================================================
+struct BenchmarkOptions
+{
+    std::vector<double> sampleRates { 44100.0, 48000.0, 96000.0 };
+    std::vector<int> blockSizes { 32, 64, 128, 256, 512, 1024 };
+    double secondsPerRun = 2.0;                     // Audio time rendered for each measurement
+    bool sweepModes = true;                         // False measures the default parameter values only
+    const juce::AudioBuffer<float>* input = nullptr; // Looped as the input, a synthetic signal is used if null
+};
+
+struct BenchmarkResult
+{
+    juce::String plugin;
+    juce::String mode;
+    double sampleRate;
+    int blockSize;
+    double nanosecondsPerSample;    // Per sample frame, all channels together
+    double realTimeFactor;          // Audio time rendered per second of processing time
+    double worstBlockMicroseconds;
+    double worstBlockLoad;          // Worst block time as a fraction of the block's duration
+};
+
+//==============================================================================
+class PluginBenchmark
+{
+public:
+    static constexpr int numChannels = 2;
+
+    explicit PluginBenchmark (BenchmarkOptions optionsToUse)
+        : options (std::move (optionsToUse))
+    {
+    }
+
+    //==============================================================================
+    // Measures one plugin at every sample rate, block size and mode, calling onResult after each measurement
+    void run (const PluginInfo& plugin, const std::function<void (const BenchmarkResult&)>& onResult)
+    {
+        const auto modes = options.sweepModes ? getModes (*plugin.create()) : std::vector<Mode> { Mode() };
+
+        for (auto sampleRate : options.sampleRates)
+        {
+            const auto& input = getInput (sampleRate);
+
+            for (auto blockSize : options.blockSizes)
+                for (const auto& mode : modes)
+                    onResult (measure (plugin, mode, input, sampleRate, blockSize));
+        }
+    }
+
+private:
+    //==============================================================================
+    // One combination of integer parameter values, by parameter index
+    struct Mode
+    {
+        std::vector<std::pair<int, int>> values;
+        juce::String label { "default" };
+    };
+
+    // Every combination of the processor's integer parameters
+    static std::vector<Mode> getModes (const juce::AudioProcessor& processor)
+    {
+        std::vector<Mode> modes { Mode() };
+        const auto& parameters = processor.getParameters();
+
+        for (int index = 0; index < (int) parameters.size(); ++index)
+        {
+            auto* parameter = dynamic_cast<juce::AudioParameterInt*> (parameters[index]);
+
+            if (parameter == nullptr)
+                continue;
+
+            std::vector<Mode> expanded;
+            const auto range = parameter->getRange();
+
+            for (const auto& mode : modes)
+            {
+                for (int value = range.getStart(); value <= range.getEnd(); ++value)
+                {
+                    auto next = mode;
+                    next.values.emplace_back (index, value);
+                    next.label = (mode.values.empty() ? juce::String() : mode.label + " ")
+                                   + parameter->getName (32) + "=" + juce::String (value);
+                    expanded.push_back (std::move (next));
+                }
+            }
+
+            modes = std::move (expanded);
+        }
+
+        return modes;
+    }
+
+    //==============================================================================
+    BenchmarkResult measure (const PluginInfo& plugin, const Mode& mode, const juce::AudioBuffer<float>& input,
+                             double sampleRate, int blockSize)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        // A fresh processor for every measurement, so no state carries over from the last one
+        auto processor = plugin.create();
+        const auto& parameters = processor->getParameters();
+
+        for (const auto& [index, value] : mode.values)
+            *dynamic_cast<juce::AudioParameterInt*> (parameters[index]) = value;
+
+        processor->setPlayConfigDetails (numChannels, numChannels, sampleRate, blockSize);
+        processor->prepareToPlay (sampleRate, blockSize);
+
+        juce::ScopedNoDenormals noDenormals;
+        juce::AudioBuffer<float> buffer (numChannels, blockSize);
+        juce::MidiBuffer midi;
+        int inputPosition = 0;
+
+        // Lets delay lines fill and parameter ramps settle before anything is timed
+        const int warmUpBlocks = juce::jmax (1, (int) (sampleRate * warmUpSeconds) / blockSize);
+
+        for (int block = 0; block < warmUpBlocks; ++block)
+        {
+            fillBlock (buffer, input, inputPosition);
+            processor->processBlock (buffer, midi);
+        }
+
+        const int numBlocks = juce::jmax (1, (int) (sampleRate * options.secondsPerRun) / blockSize);
+        Clock::duration total {}, worst {};
+
+        for (int block = 0; block < numBlocks; ++block)
+        {
+            fillBlock (buffer, input, inputPosition);
+
+            const auto start = Clock::now();
+            processor->processBlock (buffer, midi);
+            const auto elapsed = Clock::now() - start;
+
+            total += elapsed;
+            worst = juce::jmax (worst, elapsed);
+        }
+
+        processor->releaseResources();
+
+        const auto totalSeconds = std::chrono::duration<double> (total).count();
+        const auto worstSeconds = std::chrono::duration<double> (worst).count();
+        const auto numSamples = (double) numBlocks * blockSize;
+
+        return { plugin.name, mode.label, sampleRate, blockSize,
+                 totalSeconds * 1.0e9 / numSamples,
+                 (numSamples / sampleRate) / juce::jmax (totalSeconds, 1.0e-12),
+                 worstSeconds * 1.0e6,
+                 worstSeconds / (blockSize / sampleRate) };
+    }
+
+    // Copies the next block of the looped input into buffer
+    static void fillBlock (juce::AudioBuffer<float>& buffer, const juce::AudioBuffer<float>& input, int& position)
+    {
+        for (int done = 0; done < buffer.getNumSamples();)
+        {
+            const int chunk = juce::jmin (buffer.getNumSamples() - done, input.getNumSamples() - position);
+
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                buffer.copyFrom (channel, done, input, juce::jmin (channel, input.getNumChannels() - 1), position, chunk);
+
+            done += chunk;
+            position = (position + chunk) % input.getNumSamples();
+        }
+    }
+
+    //==============================================================================
+    const juce::AudioBuffer<float>& getInput (double sampleRate)
+    {
+        if (options.input != nullptr)
+            return *options.input;
+
+        if (synthetic.getNumSamples() == 0 || syntheticRate != sampleRate)
+        {
+            makeSyntheticInput (synthetic, sampleRate);
+            syntheticRate = sampleRate;
+        }
+
+        return synthetic;
+    }
+
+    // Plucked, slightly detuned notes with a little noise, so dynamics processors and clippers see level changes.
+    // Every sample stays well away from the denormal range.
+    static void makeSyntheticInput (juce::AudioBuffer<float>& buffer, double sampleRate)
+    {
+        const int length = (int) (sampleRate * syntheticSeconds);
+        const int noteLength = (int) (sampleRate * 0.25);
+        const float frequencies[] = { 110.0f, 146.83f, 164.81f, 220.0f };
+        juce::Random random (1234);
+
+        buffer.setSize (numChannels, length);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* data = buffer.getWritePointer (channel);
+            const float detune = channel == 0 ? 1.0f : 1.003f;
+
+            for (int sample = 0; sample < length; ++sample)
+            {
+                const int note = sample / noteLength;
+                const float time = (float) (sample % noteLength) / (float) sampleRate;
+                const float frequency = frequencies[note % 4] * detune;
+                const float envelope = 0.1f + 0.5f * std::exp (-8.0f * time);
+
+                data[sample] = envelope * std::sin (juce::MathConstants<float>::twoPi * frequency * time)
+                             + 0.02f * (random.nextFloat() * 2.0f - 1.0f);
+            }
+        }
+    }
+
+    //==============================================================================
+    static constexpr double warmUpSeconds = 0.25;
+    static constexpr double syntheticSeconds = 4.0;
+
+    BenchmarkOptions options;
+    juce::AudioBuffer<float> synthetic;
+    double syntheticRate = 0.0;
+};
@@ -0,0 +1,161 @@
+/*
+  ==============================================================================
+
+   This file is part of the JUCE framework examples.
+   Copyright (c) Raw Material Software Limited
+
+   The code included in this file is provided under the terms of the ISC license
+   http://www.isc.org/downloads/software-support-policy/isc-license. Permission
+   to use, copy, modify, and/or distribute this software for any purpose with or
+   without fee is hereby granted provided that the above copyright notice and
+   this permission notice appear in all copies.
+
+   THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES WITH
+   REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY
+   AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY SPECIAL, DIRECT,
+   INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER RESULTING FROM
+   LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION OF CONTRACT, NEGLIGENCE OR
+   OTHER TORTIOUS ACTION, ARISING OUT OF OR IN CONNECTION WITH THE USE OR
+   PERFORMANCE OF THIS SOFTWARE.
+
+  ==============================================================================
+*/
+
+/*******************************************************************************
+ The block below describes the properties of this PIP. A PIP is a short snippet
+ of code that can be read by the Projucer and used to generate a JUCE project.
+
+ BEGIN_JUCE_PIP_METADATA
+
+ name:             CabinetPlugin
+ version:          1.0.0
+ vendor:           JUCE
+ website:          oshe.io
+ description:      Cabinet impulse response audio plugin.
+
+ dependencies:     juce_audio_basics, juce_audio_devices, juce_audio_formats,
+                   juce_audio_plugin_client, juce_audio_processors,
+                   juce_audio_utils, juce_core, juce_data_structures, juce_dsp,
+                   juce_events, juce_graphics, juce_gui_basics, juce_gui_extra
+ exporter:         Linux Makefile
+
+ moduleFlags:      JUCE_STRICT_REFCOUNTEDPOINTER=1
+
+ type:             AudioProcessor
+ mainClass:        CabinetProcessor
+
+ useLocalCopy:     1
+
+ END_JUCE_PIP_METADATA
+
+*******************************************************************************/
+
+#pragma once
+
+#include "ImpulseResponseLibrary.h"
+#include "PartitionedConvolver.h"
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
+
+//==============================================================================
+class CabinetProcessor final : public juce::AudioProcessor
+{
+public:
+
+    //==============================================================================
+    CabinetProcessor()
+        : juce::AudioProcessor (BusesProperties().withInput  ("Input",  juce::AudioChannelSet::stereo())
+                                                 .withOutput ("Output", juce::AudioChannelSet::stereo())),
+          convolver ([this] (int index, double sampleRate, juce::AudioBuffer<float>& response)
+                     {
+                         library.load (index, sampleRate, response, PartitionedConvolver::maxImpulseSeconds);
+                     })
+    {
+        addParameter (impulse = new juce::AudioParameterChoice ({ "impulse", 1 }, "Impulse Response", library.getNames(), 0)); // 0 is the built-in cab, the rest are the files in ~/IRs
+        addParameter (level = new juce::AudioParameterFloat ({ "level", 1 }, "Level", 0.0f, 2.0f, 1.0f));
+    }
+
+    //==============================================================================
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        smoothedLevel.prepare (sampleRate, samplesPerBlock, level->get());
+
+        // Loads the chosen response before the first block, later changes are loaded by the convolver's worker
+        convolver.prepare (sampleRate, samplesPerBlock, impulse->getIndex());
+
+        if (convolver.getLatencyInSamples() != getLatencySamples())
+            setLatencySamples (convolver.getLatencyInSamples());
+    }
+
+    void releaseResources() override
+    {
+        convolver.release();
+    }
+
+    void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
+    {
+        const auto numSamples = buffer.getNumSamples();
+
+        convolver.setImpulseResponse (impulse->getIndex());
+        smoothedLevel.update (level->get(), numSamples);
+
+        if (getTotalNumInputChannels() == 1)
+            convolver.processMono (buffer.getWritePointer (0), numSamples);
+        else
+            convolver.processStereo (buffer.getWritePointer (0), buffer.getWritePointer (1), numSamples);
+
+        for (int channel = 0; channel < juce::jmin (buffer.getNumChannels(), PartitionedConvolver::maxChannels); ++channel)
+            smoothedLevel.applyGain (buffer.getWritePointer (channel), numSamples);
+    }
+
+    //==============================================================================
+    juce::AudioProcessorEditor* createEditor() override         { return new juce::GenericAudioProcessorEditor (*this); }
+    bool hasEditor() const override                             { return true;   }
+
+    //==============================================================================
+    const juce::String getName() const override                 { return "Cabinet PlugIn"; }
+    bool acceptsMidi() const override                           { return false; }
+    bool producesMidi() const override                          { return false; }
+    double getTailLengthSeconds() const override                { return PartitionedConvolver::maxImpulseSeconds; }
+
+    //==============================================================================
+    int getNumPrograms() override                               { return 1; }
+    int getCurrentProgram() override                            { return 0; }
+    void setCurrentProgram (int) override                       {}
+    const juce::String getProgramName (int) override            { return "None"; }
+    void changeProgramName (int, const juce::String&) override  {}
+
+    //==============================================================================
+    void getStateInformation (juce::MemoryBlock& destData) override
+    {
+        PluginState::save (*this, destData);
+    }
+
+    void setStateInformation (const void* data, int sizeInBytes) override
+    {
+        PluginState::load (*this, data, sizeInBytes);
+    }
+
+    //==============================================================================
+    bool isBusesLayoutSupported (const BusesLayout& layouts) const override
+    {
+        const auto& mainInLayout  = layouts.getChannelSet (true,  0);
+        const auto& mainOutLayout = layouts.getChannelSet (false, 0);
+
+        return (mainInLayout == mainOutLayout && (! mainInLayout.isDisabled()));
+    }
+
+private:
+    //==============================================================================
+    ImpulseResponseLibrary library;
+    PartitionedConvolver convolver;
+
+    juce::AudioParameterChoice* impulse;
+    juce::AudioParameterFloat* level;
+
+    SmoothedParameter smoothedLevel;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CabinetProcessor)
+};
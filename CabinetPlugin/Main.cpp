@@ -0,0 +1,8 @@
+#include <JuceHeader.h>
+#include "CabinetPlugin.h"
+
+//==============================================================================
+juce::AudioProcessor* JUCE_CALLTYPE createPluginFilter()
+{
+    return new CabinetProcessor();
+}
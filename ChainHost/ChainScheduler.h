@@ -0,0 +1,250 @@
+/*******************************************************************************
+
+ name:             ChainScheduler
+ description:      runs the independent branches of a chain on a small pool
+                   of pinned real-time worker threads.
+
+ The audio callback hands run() a number of branches that do not depend on
+ each other, such as the boards that play side by side while PedalChain
+ switches boards, or the two channels of a chorus pedal. run() splits them over the callback thread and the
+ workers, and returns once every branch is done. Each thread starts with its
+ own share of the branches and then steals what is left of the others'.
+ Branches are claimed with a compare-and-swap on a word that also holds the
+ period's number, so a worker that wakes up late can never take a branch of
+ the next period.
+
+ Both ends of a period are spin-then-sleep barriers. A worker spins for
+ spinMicroseconds after its last branch, then sleeps on its thread's event
+ until the callback thread wakes it. Waking takes the event's mutex, so only
+ the first period after a pause pays for a lock and a system call. The callback thread
+ spins until the last branch is done, since it is the one with the
+ deadline. While boards switch, or while a board has several pedals that
+ split their channels, a period starts well within the spin time of the last
+ one ending, so the workers pick it up without a system call.
+
+ Workers are pinned to the last cores, one each, and run at real-time
+ priority. With no workers, or a single branch, everything runs on the
+ callback thread as before.
+
+*******************************************************************************/
+
+#pragma once
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+
+//==============================================================================
+class ChainScheduler final
+{
+public:
+    static constexpr int maxWorkers = 3;
+    static constexpr int maxBranches = 0xffff;     // Branch indices are 16 bits of the claim word
+    static constexpr double spinMicroseconds = 50.0;
+
+    ~ChainScheduler()
+    {
+        stop();
+    }
+
+    //==============================================================================
+    // Starts up to maxWorkers workers, leaving at least one core to the rest of the system. Must not be called while run() is running.
+    void start (int numWorkersWanted)
+    {
+        stop();
+
+        const auto numCores = juce::SystemStats::getNumCpus();
+        const auto numWorkers = juce::jlimit (0, juce::jmin (maxWorkers, numCores - 1), numWorkersWanted);
+
+        for (int index = 0; index < numWorkers; ++index)
+            workers.push_back (std::make_unique<Worker> (*this, index + 1, numCores - 1 - index));
+
+        for (auto& worker : workers)
+            worker->startRealtimeThread (juce::Thread::RealtimeOptions().withPriority (8));
+    }
+
+    void stop()
+    {
+        for (auto& worker : workers)
+            worker->signalThreadShouldExit();
+
+        for (auto& worker : workers)
+        {
+            worker->notify();
+            worker->stopThread (1000);
+        }
+
+        workers.clear();
+    }
+
+    int getNumWorkers() const noexcept                          { return (int) workers.size(); }
+
+    //==============================================================================
+    // Calls branchFunction (index) once for every index below numBranches, spread over the calling thread and the
+    // workers, and returns once every call has returned. Called from the audio thread, it never allocates. It only locks
+    // to wake a worker that has gone to sleep: notify() takes the event's mutex for a moment, which a sleeping worker
+    // never holds for longer than it takes to start waiting.
+    template <typename BranchFunction>
+    void run (int numBranches, BranchFunction& branchFunction) noexcept
+    {
+        jassert (numBranches <= maxBranches);
+
+        if (numBranches <= 1 || workers.empty())
+        {
+            for (int branch = 0; branch < numBranches; ++branch)
+                branchFunction (branch);
+
+            return;
+        }
+
+        job = { [] (void* context, int branch) { (*static_cast<BranchFunction*> (context)) (branch); }, &branchFunction };
+        remaining.store (numBranches, std::memory_order_relaxed);
+
+        // Each thread's share is published with the new period's number, after the job it belongs to
+        const auto period = generation.load (std::memory_order_relaxed) + 1;
+        const auto numThreads = getNumWorkers() + 1;
+
+        for (int thread = 0; thread < numThreads; ++thread)
+            shares[(size_t) thread].claim.store (makeClaim (period, thread * numBranches / numThreads, (thread + 1) * numBranches / numThreads),
+                                                 std::memory_order_release);
+
+        generation.store (period, std::memory_order_seq_cst);
+
+        for (auto& worker : workers)
+            if (worker->sleeping.load (std::memory_order_seq_cst))
+                worker->notify();
+
+        runBranches (0, period);
+
+        while (remaining.load (std::memory_order_acquire) > 0)
+            pause();
+    }
+
+private:
+    //==============================================================================
+    struct Job
+    {
+        void (*function) (void*, int) = nullptr;
+        void* context = nullptr;
+    };
+
+    // One per thread, on its own cache line so threads claiming branches do not slow each other down
+    struct alignas (64) Share
+    {
+        std::atomic<juce::uint64> claim { 0 };  // Period number, next branch and end of the share
+    };
+
+    class Worker final : public juce::Thread
+    {
+    public:
+        Worker (ChainScheduler& schedulerToServe, int threadIndex, int coreToUse)
+            : juce::Thread ("Chain Worker " + juce::String (threadIndex)), scheduler (schedulerToServe), index (threadIndex), core (coreToUse)
+        {
+        }
+
+        void run() override
+        {
+            juce::Thread::setCurrentThreadAffinityMask ((juce::uint32) 1 << core);
+            juce::FloatVectorOperations::disableDenormalisedNumberSupport();
+
+            auto period = scheduler.generation.load (std::memory_order_acquire);
+            const auto spinTicks = (juce::int64) (spinMicroseconds * 1.0e-6 * (double) juce::Time::getHighResolutionTicksPerSecond());
+
+            while (! threadShouldExit())
+            {
+                const auto spinStart = juce::Time::getHighResolutionTicks();
+
+                while (scheduler.generation.load (std::memory_order_acquire) == period && ! threadShouldExit())
+                {
+                    if (juce::Time::getHighResolutionTicks() - spinStart < spinTicks)
+                    {
+                        pause();
+                        continue;
+                    }
+
+                    // run() checks the flag after publishing a period, so one of the two always sees the other.
+                    // The timeout is only there to notice threadShouldExit().
+                    sleeping.store (true, std::memory_order_seq_cst);
+
+                    if (scheduler.generation.load (std::memory_order_seq_cst) == period)
+                        wait (100);
+
+                    sleeping.store (false, std::memory_order_relaxed);
+                }
+
+                period = scheduler.generation.load (std::memory_order_acquire);
+                scheduler.runBranches (index, period);
+            }
+        }
+
+        std::atomic<bool> sleeping { false };
+
+    private:
+        ChainScheduler& scheduler;
+        const int index;
+        const int core;
+    };
+
+    //==============================================================================
+    static juce::uint64 makeClaim (juce::uint32 period, int next, int end) noexcept
+    {
+        return ((juce::uint64) period << 32) | ((juce::uint64) next << 16) | (juce::uint64) end;
+    }
+
+    // Takes the next branch of a share if it is still this period's and not used up, or returns -1
+    int claimBranch (Share& share, juce::uint32 period) noexcept
+    {
+        auto claim = share.claim.load (std::memory_order_acquire);
+
+        for (;;)
+        {
+            const auto next = (int) ((claim >> 16) & 0xffff);
+            const auto end = (int) (claim & 0xffff);
+
+            if ((juce::uint32) (claim >> 32) != period || next >= end)
+                return -1;
+
+            if (share.claim.compare_exchange_weak (claim, makeClaim (period, next + 1, end), std::memory_order_acq_rel))
+                return next;
+        }
+    }
+
+    // Runs the thread's own share of the period, then steals from the others until nothing is left
+    void runBranches (int thread, juce::uint32 period) noexcept
+    {
+        const auto numThreads = getNumWorkers() + 1;
+
+        for (int offset = 0; offset < numThreads; ++offset)
+        {
+            auto& share = shares[(size_t) ((thread + offset) % numThreads)];
+
+            // The job cannot change while a branch of its period is claimed but not finished
+            for (auto branch = claimBranch (share, period); branch >= 0; branch = claimBranch (share, period))
+            {
+                job.function (job.context, branch);
+                remaining.fetch_sub (1, std::memory_order_acq_rel);
+            }
+        }
+    }
+
+    static void pause() noexcept
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    //==============================================================================
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::array<Share, maxWorkers + 1> shares;
+
+    Job job;                                        // Written by run() before the period's shares
+    std::atomic<juce::uint32> generation { 0 };    // Number of the latest period
+    std::atomic<int> remaining { 0 };               // Branches of the current period not finished yet
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChainScheduler)
+};
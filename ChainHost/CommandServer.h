@@ -0,0 +1,196 @@
+/*******************************************************************************
+
+ name:             CommandServer
+ description:      the part of mod-host's socket protocol the GUI uses for a
+                   loaded board.
+
+ Listens on a TCP port and answers each command, terminated by a newline or a
+ null byte, with "resp <code>" and a null byte, like mod-host, so the GUI's
+ modhostmanager functions work unchanged once the board is running. Pipelined
+ commands are answered in the order they were sent. The chain is built from
+ the board file at startup, so only the commands that change a running board
+ are handled: param_set, patch_set, bypass and quit.
+
+ load_board is specific to the chain host and takes the path of a board file,
+ the rest of the line. The new board is crossfaded in while the old one rings
+ out, so the GUI can switch boards without restarting the host. It fails with
+ -902 while the previous switch has not started yet, and with -101 if the
+ board cannot be loaded.
+
+ cpu_load replies like mod-host's, with the chain's average load in percent
+ after the code. pedal_load is specific to the chain host and replies with
+ five numbers per pedal, in chain order: the minimum, average, p99 and
+ maximum load over the last second in percent, then the pedal's xrun count.
+ delay_memory replies with the bytes of delay history every board in the
+ host holds, including boards that are still ringing out.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "PedalChain.h"
+
+
+//==============================================================================
+class CommandServer final : private juce::Thread
+{
+public:
+    CommandServer (PedalChain& chainToControl, juce::WaitableEvent& quitEvent)
+        : juce::Thread ("Command Server"), chain (chainToControl), quit (quitEvent)
+    {
+    }
+
+    ~CommandServer() override
+    {
+        stop();
+    }
+
+    // Starts listening, returns false if the port is taken
+    bool start (int port)
+    {
+        if (! listener.createListener (port, "127.0.0.1"))
+            return false;
+
+        return startThread();
+    }
+
+    void stop()
+    {
+        signalThreadShouldExit();
+        listener.close(); // Wakes the thread if it is waiting for a connection
+        stopThread (1000);
+    }
+
+private:
+    //==============================================================================
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            std::unique_ptr<juce::StreamingSocket> connection (listener.waitForNextConnection());
+
+            if (connection == nullptr)
+                continue;
+
+            juce::MemoryBlock pending;
+            char data[256];
+
+            // One client at a time, the GUI keeps a single connection open
+            while (! threadShouldExit())
+            {
+                // Waits in short steps so stop() does not have to close the connection from another thread
+                const int ready = connection->waitUntilReady (true, 100);
+
+                if (ready < 0)
+                    break;
+
+                if (ready == 0)
+                {
+                    chain.releaseRetiredBoards();
+                    continue;
+                }
+
+                const int bytesRead = connection->read (data, (int) sizeof (data), false);
+
+                if (bytesRead <= 0)
+                    break;
+
+                pending.append (data, (size_t) bytesRead);
+
+                for (auto line = takeLine (pending); line.isNotEmpty(); line = takeLine (pending))
+                {
+                    const auto response = handleCommand (line);
+                    connection->write (response.toRawUTF8(), response.length() + 1); // Includes the null terminator
+                }
+            }
+        }
+    }
+
+    // Removes the first complete command from pending, or returns an empty string if there is none
+    static juce::String takeLine (juce::MemoryBlock& pending)
+    {
+        const auto* begin = static_cast<const char*> (pending.getData());
+        const auto* end = std::find_if (begin, begin + pending.getSize(), [] (char c) { return c == '\n' || c == '\0'; });
+
+        if (end == begin + pending.getSize())
+            return {};
+
+        const auto line = juce::String (begin, (size_t) (end - begin)).trim();
+        pending.removeSection (0, (size_t) (end - begin) + 1);
+
+        // Blank lines are skipped rather than ending the loop in run()
+        return line.isEmpty() ? takeLine (pending) : line;
+    }
+
+    // Returns the whole reply, "resp <code>" followed by any values
+    juce::String handleCommand (const juce::String& line)
+    {
+        // Boards that finished ringing out are deleted here, never on the audio thread
+        chain.releaseRetiredBoards();
+
+        const auto tokens = juce::StringArray::fromTokens (line, " ", "");
+        const auto& command = tokens[0];
+
+        if ((command == "param_set" || command == "patch_set") && tokens.size() >= 4)
+            return reply (chain.setParameter (tokens[1].getIntValue(), tokens[2], tokens[3].getFloatValue()));
+
+        if (command == "bypass" && tokens.size() >= 3)
+            return reply (chain.setBypass (tokens[1].getIntValue(), tokens[2].getIntValue() != 0));
+
+        if (command == "cpu_load")
+            return reply (PedalChain::success) + " " + juce::String (chain.getTotalLoad().average, 2);
+
+        if (command == "pedal_load")
+        {
+            auto response = reply (PedalChain::success);
+
+            for (const auto& load : chain.getPedalLoads())
+                response << " " << juce::String (load.minimum, 2) << " " << juce::String (load.average, 2)
+                         << " " << juce::String (load.p99, 2) << " " << juce::String (load.maximum, 2)
+                         << " " << load.xruns;
+
+            return response;
+        }
+
+        if (command == "delay_memory")
+            return reply (PedalChain::success) + " " + juce::String ((juce::int64) DelayMemory::getTotalSizeInBytes());
+
+        if (command == "load_board" && tokens.size() >= 2)
+        {
+            if (chain.isSwitchPending())
+                return reply (PedalChain::invalidOperation);
+
+            const auto path = line.fromFirstOccurrenceOf (command, false, false).trim();
+            const auto loaded = chain.loadBoard (juce::File::getCurrentWorkingDirectory().getChildFile (path));
+
+            if (loaded.failed())
+            {
+                std::fprintf (stderr, "%s\n", loaded.getErrorMessage().toRawUTF8());
+                return reply (PedalChain::invalidPluginURI);
+            }
+
+            return reply (PedalChain::success);
+        }
+
+        if (command == "quit")
+        {
+            quit.signal();
+            return reply (PedalChain::success);
+        }
+
+        std::fprintf (stderr, "Unsupported command: %s\n", line.toRawUTF8());
+        return reply (unsupportedCommand);
+    }
+
+    static juce::String reply (int code)                        { return "resp " + juce::String (code); }
+
+    //==============================================================================
+    static constexpr int unsupportedCommand = -1;
+
+    PedalChain& chain;
+    juce::WaitableEvent& quit;
+    juce::StreamingSocket listener;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CommandServer)
+};
@@ -0,0 +1,201 @@
+/*******************************************************************************
+
+ name:             LoadMeter
+ description:      per-pedal DSP load of a running chain.
+
+ The audio callback times every pedal of every block and pushes one row per
+ block, the share of the block period each pedal used plus the whole
+ callback, through a lock-free FIFO. That costs two atomics per block
+ however many pedals there are. A background thread empties the FIFO a few
+ times per second and turns the last second of rows into min, average, p99
+ and max figures that the command thread can ask for at any time.
+
+ A block counts as an xrun if the callback overran its period, or if the
+ device reported an xrun since the previous block, in which case the previous
+ block is blamed. Each pedal counts the xruns of blocks in which it was the
+ slowest pedal, which points at the pedal to look at when a board crackles.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+class LoadMeter final : private juce::Thread
+{
+public:
+    // Share of the block period, in percent, over the last second
+    struct Load
+    {
+        float minimum = 0.0f;
+        float average = 0.0f;
+        float p99 = 0.0f;
+        float maximum = 0.0f;
+        int xruns = 0;          // Since the chain started, for pedals only
+    };
+
+    //==============================================================================
+    LoadMeter()
+        : juce::Thread ("Load Meter")
+    {
+    }
+
+    ~LoadMeter() override
+    {
+        stopThread (1000);
+    }
+
+    // Sizes everything for numPedals pedals and starts the background thread. Must be called before the audio starts.
+    void prepare (int numPedals, double sampleRate, int blockSize)
+    {
+        stopThread (1000);
+
+        rowSize = numPedals + 1;
+        blocksPerSecond = juce::jmax (1, juce::roundToInt (sampleRate / blockSize));
+        fifo.setTotalSize (blocksPerSecond + 1);
+        fifo.reset();
+        rows.assign ((size_t) ((blocksPerSecond + 1) * rowSize), 0.0f);
+        window.assign ((size_t) (blocksPerSecond * rowSize), 0.0f);
+        windowPosition = windowFill = 0;
+        xruns = std::make_unique<std::atomic<int>[]> ((size_t) numPedals);
+
+        for (int pedal = 0; pedal < numPedals; ++pedal)
+            xruns[(size_t) pedal] = 0;
+
+        {
+            const juce::SpinLock::ScopedLockType lock (loadLock);
+            loads.assign ((size_t) rowSize, {});
+        }
+
+        startThread();
+    }
+
+    //==============================================================================
+    // Called from the audio thread once per block, with each pedal's time and the whole callback's, as a share of the period
+    void addBlock (const float* pedalLoads, float totalLoad, bool deviceXrun) noexcept
+    {
+        const int numPedals = rowSize - 1;
+        const int slowest = (int) (std::max_element (pedalLoads, pedalLoads + numPedals) - pedalLoads);
+
+        if (totalLoad > 1.0f && numPedals > 0)
+            ++xruns[(size_t) slowest];
+        else if (deviceXrun && previousSlowest >= 0)
+            ++xruns[(size_t) previousSlowest];
+
+        previousSlowest = numPedals > 0 ? slowest : -1;
+
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        // If the meter thread falls behind, blocks go unmeasured rather than waiting
+        if (size1 + size2 == 0)
+            return;
+
+        auto* row = rows.data() + (size1 > 0 ? start1 : start2) * rowSize;
+        std::copy_n (pedalLoads, numPedals, row);
+        row[numPedals] = totalLoad;
+        fifo.finishedWrite (1);
+    }
+
+    //==============================================================================
+    // Loads of every pedal, in chain order
+    std::vector<Load> getPedalLoads() const
+    {
+        const juce::SpinLock::ScopedLockType lock (loadLock);
+        return { loads.begin(), loads.end() - 1 };
+    }
+
+    // Load of the whole callback
+    Load getTotalLoad() const
+    {
+        const juce::SpinLock::ScopedLockType lock (loadLock);
+        return loads.back();
+    }
+
+private:
+    //==============================================================================
+    void run() override
+    {
+        while (! threadShouldExit())
+        {
+            wait (250);
+            collect();
+        }
+    }
+
+    void collect()
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (fifo.getNumReady(), start1, size1, start2, size2);
+
+        // The window holds the last second of rows, the oldest are overwritten
+        for (auto [start, size] : { std::make_pair (start1, size1), std::make_pair (start2, size2) })
+        {
+            for (int block = start; block < start + size; ++block)
+            {
+                std::copy_n (rows.begin() + block * rowSize, rowSize, window.begin() + windowPosition * rowSize);
+                windowPosition = (windowPosition + 1) % blocksPerSecond;
+                windowFill = juce::jmin (windowFill + 1, blocksPerSecond);
+            }
+        }
+
+        fifo.finishedRead (size1 + size2);
+
+        std::vector<Load> newLoads ((size_t) rowSize);
+
+        for (int column = 0; column < rowSize; ++column)
+        {
+            newLoads[(size_t) column] = summarise (column);
+
+            if (column < rowSize - 1)
+                newLoads[(size_t) column].xruns = xruns[(size_t) column].load();
+        }
+
+        const juce::SpinLock::ScopedLockType lock (loadLock);
+        loads = std::move (newLoads);
+    }
+
+    Load summarise (int column)
+    {
+        if (windowFill == 0)
+            return {};
+
+        sorted.clear();
+        float sum = 0.0f;
+
+        for (int block = 0; block < windowFill; ++block)
+        {
+            sorted.push_back (window[(size_t) (block * rowSize + column)] * 100.0f);
+            sum += sorted.back();
+        }
+
+        std::sort (sorted.begin(), sorted.end());
+
+        Load load;
+        load.minimum = sorted.front();
+        load.average = sum / (float) sorted.size();
+        load.p99 = sorted[(sorted.size() - 1) * 99 / 100];
+        load.maximum = sorted.back();
+        return load;
+    }
+
+    //==============================================================================
+    juce::AbstractFifo fifo { 2 };
+    std::vector<float> rows;                    // One row per block: each pedal's load, then the total
+    int rowSize = 1;
+    int blocksPerSecond = 1;
+
+    std::unique_ptr<std::atomic<int>[]> xruns;  // Per pedal, written by the audio thread
+    int previousSlowest = -1;                   // Only used by the audio thread
+
+    std::vector<float> window;                  // The last second of rows, only used by the meter thread
+    int windowPosition = 0;
+    int windowFill = 0;
+    std::vector<float> sorted;
+
+    mutable juce::SpinLock loadLock;
+    std::vector<Load> loads { Load() };
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (LoadMeter)
+};
@@ -0,0 +1,87 @@
+#include <JuceHeader.h>
+#include "CommandServer.h"
+
+#include <csignal>
+
+//==============================================================================
+static juce::WaitableEvent quitEvent;
+static volatile std::sig_atomic_t stopSignalled = 0;
+
+static void printUsage()
+{
+    std::printf ("usage: PedalChainHost BOARD.json [options]\n"
+                 "  --port N          TCP port for the GUI's commands (default: 5555, the same as mod-host)\n"
+                 "  --device-type T   audio device type (default: JACK)\n"
+                 "  --threads N       worker threads for boards that play side by side, 0 for none (default: one per spare core, up to 3)\n");
+}
+
+//==============================================================================
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.size() == 0 || args.containsOption ("--help|-h"))
+    {
+        printUsage();
+        return args.size() == 0 ? 1 : 0;
+    }
+
+    // Needed by the device manager's change messages
+    juce::ScopedJuceInitialiser_GUI juceInitialiser;
+
+    PedalChain chain;
+    const auto board = juce::File::getCurrentWorkingDirectory().getChildFile (args[0].text);
+    const auto loaded = chain.loadBoard (board);
+
+    if (loaded.failed())
+    {
+        std::fprintf (stderr, "%s\n", loaded.getErrorMessage().toRawUTF8());
+        return 1;
+    }
+
+    // The workers are pinned to the last cores, so the audio thread is left with the first
+    chain.setNumWorkerThreads (args.containsOption ("--threads") ? args.getValueForOption ("--threads").getIntValue()
+                                                                 : ChainScheduler::maxWorkers);
+
+    // One device for the whole board. With JACK this is a single client, connected to the system ports when opened.
+    juce::AudioDeviceManager deviceManager;
+    deviceManager.setCurrentAudioDeviceType (args.containsOption ("--device-type") ? args.getValueForOption ("--device-type") : "JACK", true);
+
+    const auto error = deviceManager.initialise (PedalChain::numChannels, PedalChain::numChannels, nullptr, false);
+
+    if (error.isNotEmpty() || deviceManager.getCurrentAudioDevice() == nullptr)
+    {
+        std::fprintf (stderr, "Could not open the audio device: %s\n", error.toRawUTF8());
+        return 1;
+    }
+
+    deviceManager.addAudioCallback (&chain);
+
+    CommandServer server (chain, quitEvent);
+    const int port = args.containsOption ("--port") ? args.getValueForOption ("--port").getIntValue() : 5555;
+
+    if (! server.start (port))
+    {
+        std::fprintf (stderr, "Could not listen on port %d\n", port);
+        deviceManager.removeAudioCallback (&chain);
+        return 1;
+    }
+
+    auto* device = deviceManager.getCurrentAudioDevice();
+    std::printf ("Running %d pedals at %.0f Hz, %d samples per block, %d worker threads\n",
+                 chain.getNumPedals(), device->getCurrentSampleRate(), device->getCurrentBufferSizeSamples(), chain.getNumWorkerThreads());
+    std::fflush (stdout);
+
+    // Runs until the GUI sends quit or the process is told to stop
+    std::signal (SIGINT,  [] (int) { stopSignalled = 1; });
+    std::signal (SIGTERM, [] (int) { stopSignalled = 1; });
+
+    while (! quitEvent.wait (100) && stopSignalled == 0)
+    {
+    }
+
+    server.stop();
+    deviceManager.removeAudioCallback (&chain);
+    deviceManager.closeAudioDevice();
+    return 0;
+}
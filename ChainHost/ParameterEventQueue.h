@@ -0,0 +1,80 @@
+/*******************************************************************************
+
+ name:             ParameterEventQueue
+ description:      lock-free queue of timestamped parameter changes from the
+                   command thread to the audio thread.
+
+ Setting a parameter from the command thread stores it straight into the
+ parameter's atomic, and the processor reads it whenever its next block starts,
+ so two parameters sent together (delay and feedback, say) can be picked up in
+ different blocks. Instead the command thread pushes each change here with the
+ time it arrived, and the audio thread pops everything that is pending at the
+ start of the block and applies each change at the sample matching its arrival
+ time, one block later. Changes keep their order and spacing, and changes that
+ arrived together are applied at the same sample.
+
+ There is one queue per pedal, with a single producer (the command thread) and
+ a single consumer (the audio callback). Pushing and popping each touch two
+ atomics however many events are involved.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+struct ParameterEvent
+{
+    juce::int64 time;                       // juce::Time::getHighResolutionTicks() when the change arrived
+    juce::AudioProcessorParameter* parameter;
+    float value;                            // Normalised, as passed to setValue()
+};
+
+//==============================================================================
+class ParameterEventQueue
+{
+public:
+    static constexpr int capacity = 256;
+
+    ParameterEventQueue()
+        : fifo (capacity + 1) // AbstractFifo keeps one slot empty
+    {
+        events.resize ((size_t) fifo.getTotalSize());
+    }
+
+    //==============================================================================
+    // Called from the command thread. Returns false if the queue is full.
+    bool push (const ParameterEvent& event) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+            return false;
+
+        events[(size_t) (size1 > 0 ? start1 : start2)] = event;
+        fifo.finishedWrite (1);
+        return true;
+    }
+
+    // Called from the audio thread. Copies up to maxEvents pending events into dest, oldest first, and returns how many.
+    int pop (ParameterEvent* dest, int maxEvents) noexcept
+    {
+        int start1, size1, start2, size2;
+        fifo.prepareToRead (maxEvents, start1, size1, start2, size2);
+
+        std::copy_n (events.begin() + start1, size1, dest);
+        std::copy_n (events.begin() + start2, size2, dest + size1);
+
+        fifo.finishedRead (size1 + size2);
+        return size1 + size2;
+    }
+
+private:
+    //==============================================================================
+    juce::AbstractFifo fifo;
+    std::vector<ParameterEvent> events;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE (ParameterEventQueue)
+};
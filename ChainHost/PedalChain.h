@@ -0,0 +1,720 @@
+/*******************************************************************************
+
+ name:             PedalChain
+ description:      a whole board of plugin processors run in place as one
+                   audio callback.
+
+ mod-host loads every pedal as a separate JACK client and connects them port to
+ port, so each pedal boundary is a hop through the JACK graph. Here the board's
+ processors are created directly and called one after the other on the same
+ buffer: the device's output buffers are filled with the input once, and every
+ pedal processes them in place.
+
+ Boards are the Json files the GUI already uses. Each plugin's URI names its
+ folder in this repository, its parameters are set from their "default"
+ values in real units, and a non-zero "bypass" starts it bypassed. Every pedal
+ runs in stereo, so the "channels", "inputs" and "outputs" fields are not
+ needed here.
+
+ Parameter changes made while the board is running go through a
+ ParameterEventQueue per pedal and are applied sample-accurately: the pedal's
+ block is split at each change, so every part of it sees a consistent set of
+ values.
+
+ Every pedal is timed on every block and the times go to a LoadMeter, so the
+ GUI can show how much of the block period each pedal uses.
+
+ Loading a board while the audio is running switches to it without a gap. The
+ new board's processors are created and prepared on the calling thread, then
+ handed to the audio thread, which runs both boards for a while. Over
+ crossfadeSeconds the new board's output fades in and the old board's input
+ fades out. The old board's output is kept at full level, so its delay and
+ reverb tails ring out naturally. It is dropped once it has been silent for
+ a moment, or faded out if it still rings after maxTailSeconds (a frozen
+ reverb, say). Finished boards are passed back to be deleted off the audio
+ thread. Running two boards at once costs both boards' CPU while the tail
+ lasts, so with worker threads the boards that play side by side each run on
+ a core of their own, through a ChainScheduler. Only their mix is left to
+ the audio thread.
+
+ A single board's pedals depend on each other, but the two channels of a
+ pedal that is a PerChannelProcessor (Chorus and Flanger) do not. While one
+ board plays, such a pedal's beginBlock() runs on the audio thread and its
+ channels then run side by side through the ChainScheduler. During a switch
+ the boards already occupy the workers, and every pedal runs its
+ processBlock() as usual.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "ChainScheduler.h"
+#include "LoadMeter.h"
+#include "ParameterEventQueue.h"
+#include "PerChannelProcessor.h"
+#include "PluginList.h"
+
+
+//==============================================================================
+class PedalChain final : public juce::AudioIODeviceCallback
+{
+public:
+    static constexpr int numChannels = 2;
+
+    static constexpr double crossfadeSeconds = 0.01;
+    static constexpr double maxTailSeconds = 10.0;
+
+    // Error codes returned to the GUI, the same ones mod-host uses
+    enum ErrorCode
+    {
+        success                 = 0,
+        instanceDoesNotExist    = -3,
+        invalidPluginURI        = -101,
+        invalidParameterSymbol  = -103,
+        invalidOperation        = -902
+    };
+
+    //==============================================================================
+    // Builds a board from a file and makes it the chain's board. Before the audio starts it simply replaces the
+    // current board. Once the audio is running the board is prepared on the calling thread and crossfaded in.
+    // Fails if the file cannot be loaded, or if the previous switch has not started yet.
+    juce::Result loadBoard (const juce::File& file)
+    {
+        auto board = std::make_unique<Board>();
+        const auto result = buildBoard (file, *board);
+
+        if (result.failed())
+            return result;
+
+        const juce::ScopedLock lock (deviceLock);
+        releaseRetiredBoards();
+
+        if (deviceRunning)
+        {
+            if (pendingBoard.load() != nullptr)
+                return juce::Result::fail ("The previous board is still being switched in");
+
+            prepareBoard (*board);
+        }
+
+        auto* newBoard = board.get();
+        boards.push_back (std::move (board));
+        controlledBoard = newBoard;
+
+        if (deviceRunning)
+        {
+            pendingBoard = newBoard;
+        }
+        else
+        {
+            // Nothing is playing, so the previous board can go straight away
+            keepOnlyControlledBoard();
+        }
+
+        return juce::Result::ok();
+    }
+
+    // True from the moment loadBoard() hands a board to the audio thread until the audio thread starts the crossfade
+    bool isSwitchPending() const noexcept                       { return pendingBoard.load() != nullptr; }
+
+    // The board loadBoard() last loaded, which is the one parameter changes refer to
+    int getNumPedals() const noexcept                           { return controlledBoard != nullptr ? (int) controlledBoard->pedals.size() : 0; }
+
+    // The loads of the board that is playing. During a switch that is still the old board, until the new one has faded in.
+    // Boards are only deleted under the device lock, so the board cannot go while its meter is read.
+    LoadMeter::Load getTotalLoad() const
+    {
+        const juce::ScopedLock lock (deviceLock);
+        return getPlayingMeter().getTotalLoad();
+    }
+
+    std::vector<LoadMeter::Load> getPedalLoads() const
+    {
+        const juce::ScopedLock lock (deviceLock);
+        return getPlayingMeter().getPedalLoads();
+    }
+
+    // Starts the worker threads that run boards on other cores while they play side by side. Must be called before the audio starts.
+    void setNumWorkerThreads (int numWorkers)                   { scheduler.start (numWorkers); }
+
+    int getNumWorkerThreads() const noexcept                    { return scheduler.getNumWorkers(); }
+
+    // Deletes boards the audio thread has finished with. Called from the command thread now and then.
+    void releaseRetiredBoards()
+    {
+        const juce::ScopedLock lock (deviceLock);
+
+        Board* retired[retiredCapacity];
+        int numRetired = 0;
+
+        int start1, size1, start2, size2;
+        retiredFifo.prepareToRead (retiredFifo.getNumReady(), start1, size1, start2, size2);
+
+        for (int i = 0; i < size1; ++i)  retired[numRetired++] = retiredBoards[(size_t) (start1 + i)];
+        for (int i = 0; i < size2; ++i)  retired[numRetired++] = retiredBoards[(size_t) (start2 + i)];
+
+        retiredFifo.finishedRead (size1 + size2);
+
+        for (int i = 0; i < numRetired; ++i)
+            boards.erase (std::remove_if (boards.begin(), boards.end(), [&] (const auto& board) { return board.get() == retired[i]; }),
+                          boards.end());
+    }
+
+    //==============================================================================
+    // Sets a parameter in real units. The symbol is the parameter ID, optionally prefixed with the plugin URI and a colon.
+    // Called from the command thread, the change is queued for the audio thread.
+    int setParameter (int instance, const juce::String& symbol, float value)
+    {
+        if (! juce::isPositiveAndBelow (instance, getNumPedals()))
+            return instanceDoesNotExist;
+
+        auto& pedal = *controlledBoard->pedals[(size_t) instance];
+        auto* parameter = findParameter (pedal, symbol);
+
+        if (parameter == nullptr)
+            return invalidParameterSymbol;
+
+        const auto normalisedValue = juce::jlimit (0.0f, 1.0f, parameter->convertTo0to1 (value));
+
+        // If the audio thread has fallen that far behind, the change is not worth delaying
+        if (! pedal.events.push ({ juce::Time::getHighResolutionTicks(), parameter, normalisedValue }))
+            parameter->setValueNotifyingHost (normalisedValue);
+
+        return success;
+    }
+
+    int setBypass (int instance, bool shouldBeBypassed)
+    {
+        if (! juce::isPositiveAndBelow (instance, getNumPedals()))
+            return instanceDoesNotExist;
+
+        controlledBoard->pedals[(size_t) instance]->bypassed = shouldBeBypassed;
+        return success;
+    }
+
+    //==============================================================================
+    void audioDeviceAboutToStart (juce::AudioIODevice* device) override
+    {
+        const juce::ScopedLock lock (deviceLock);
+
+        sampleRate = device->getCurrentSampleRate();
+        blockSize = device->getCurrentBufferSizeSamples();
+
+        // A switch that was under way when the device stopped is finished off, only the latest board keeps playing
+        keepOnlyControlledBoard();
+
+        if (controlledBoard != nullptr)
+            prepareBoard (*controlledBoard);
+
+        // Only used when the device has fewer than two outputs
+        scratch.setSize (numChannels, juce::jmax (1, blockSize));
+
+        samplesPerTick = sampleRate / (double) juce::Time::getHighResolutionTicksPerSecond();
+        lastBlockStart = juce::Time::getHighResolutionTicks();
+
+        currentDevice = device;
+        lastXRunCount = device->getXRunCount();
+        deviceRunning = true;
+    }
+
+    void audioDeviceStopped() override
+    {
+        const juce::ScopedLock lock (deviceLock);
+
+        deviceRunning = false;
+        currentDevice = nullptr;
+
+        for (auto& slot : slots)
+            if (slot.board != nullptr)
+                for (auto& pedal : slot.board->pedals)
+                    pedal->processor->releaseResources();
+    }
+
+    void audioDeviceIOCallbackWithContext (const float* const* inputChannelData, int numInputChannels,
+                                           float* const* outputChannelData, int numOutputChannels,
+                                           int numSamples, const juce::AudioIODeviceCallbackContext&) override
+    {
+        if (numSamples <= 0)
+            return;
+
+        juce::ScopedNoDenormals noDenormals;
+        const auto blockStart = juce::Time::getHighResolutionTicks();
+
+        // Only the audio thread takes the pending board, so it cannot change between the load and the exchange
+        if (pendingBoard.load() != nullptr && makeRoomForSwitch())
+            startSwitch (pendingBoard.exchange (nullptr));
+
+        // Loads are measured in ticks and stored as a share of this block's period
+        const auto ticksPerBlock = (double) numSamples / samplesPerTick;
+
+        for (auto& slot : slots)
+            if (slot.board != nullptr)
+                std::fill (slot.board->pedalLoads.begin(), slot.board->pedalLoads.end(), 0.0f);
+
+        // The output buffers are processed in place when there are enough of them
+        if (numOutputChannels >= numChannels)
+        {
+            juce::AudioBuffer<float> buffer (outputChannelData, numChannels, numSamples);
+            processChain (inputChannelData, numInputChannels, buffer, 0, ticksPerBlock);
+        }
+        else
+        {
+            // The scratch buffer holds the prepared block size, so a longer block goes through it in pieces
+            for (int start = 0; start < numSamples; start += scratch.getNumSamples())
+            {
+                juce::AudioBuffer<float> buffer (scratch.getArrayOfWritePointers(), numChannels, juce::jmin (scratch.getNumSamples(), numSamples - start));
+                processChain (inputChannelData, numInputChannels, buffer, start, ticksPerBlock);
+
+                for (int channel = 0; channel < numOutputChannels; ++channel)
+                    juce::FloatVectorOperations::copy (outputChannelData[channel] + start, buffer.getReadPointer (channel), buffer.getNumSamples());
+            }
+        }
+
+        lastBlockStart = blockStart;
+
+        // Pedal loads are only reported for the board that is playing, but the total includes every board that ran
+        const auto xRunCount = currentDevice != nullptr ? currentDevice->getXRunCount() : -1;
+        auto* playing = getPlayingBoard();
+        meteredBoard = playing;
+
+        if (playing != nullptr)
+            playing->loadMeter.addBlock (playing->pedalLoads.data(), (float) ((double) (juce::Time::getHighResolutionTicks() - blockStart) / ticksPerBlock),
+                                         xRunCount > lastXRunCount);
+
+        lastXRunCount = xRunCount;
+    }
+
+private:
+    //==============================================================================
+    struct Pedal
+    {
+        juce::String name;
+        std::unique_ptr<juce::AudioProcessor> processor;
+        PerChannelProcessor* perChannel = nullptr;    // The processor, if its channels can run on separate threads
+        std::atomic<bool> bypassed { false };
+
+        ParameterEventQueue events;
+        std::array<ParameterEvent, ParameterEventQueue::capacity> pendingEvents; // Popped at the start of each block
+        juce::MidiBuffer midi;      // Always empty, but not shared, since boards can run on different threads
+    };
+
+    struct Board
+    {
+        std::vector<std::unique_ptr<Pedal>> pedals;
+        juce::AudioBuffer<float> buffer;    // The board's own signal while it shares the callback with another board
+        std::vector<float> pedalLoads;      // Share of the current block's period, per pedal
+        LoadMeter loadMeter;
+    };
+
+    // A board the audio thread is running, with the gains of its input and of its output in the mix. Only used by the audio thread.
+    struct Slot
+    {
+        Board* board = nullptr;
+        float inputGain = 1.0f, inputStep = 0.0f;       // Steps are per sample
+        float outputGain = 1.0f, outputStep = 0.0f;
+        int silentSamples = 0;                          // Since the input faded out, for boards that ring out
+        int tailSamples = 0;
+    };
+
+    // The newest board, the one it replaced, and one more that is being faded out
+    static constexpr int maxSlots = 3;
+    static constexpr int retiredCapacity = 16;
+
+    // Below -80 dB for 100 ms counts as the end of a tail
+    static constexpr float silenceThreshold = 1.0e-4f;
+    static constexpr double silenceSeconds = 0.1;
+
+    //==============================================================================
+    juce::Result buildBoard (const juce::File& file, Board& board)
+    {
+        const auto json = juce::JSON::parse (file);
+        const auto pluginList = json.getProperty ("plugins", {});
+        const auto* plugins = pluginList.getArray();
+
+        if (plugins == nullptr)
+            return juce::Result::fail (file.getFileName() + ": missing 'plugins' field");
+
+        for (const auto& plugin : *plugins)
+        {
+            const auto uri = plugin.getProperty ("uri", {}).toString();
+            const auto* info = findPlugin (uri);
+
+            if (info == nullptr)
+                return juce::Result::fail ("No processor in this repository for '" + uri + "'");
+
+            auto pedal = std::make_unique<Pedal>();
+            pedal->name = plugin.getProperty ("name", info->name).toString();
+            pedal->processor = info->create();
+            pedal->perChannel = dynamic_cast<PerChannelProcessor*> (pedal->processor.get());
+            pedal->bypassed = (int) plugin.getProperty ("bypass", 0) != 0;
+
+            const auto parameterList = plugin.getProperty ("parameters", {});
+
+            if (const auto* parameters = parameterList.getArray())
+            {
+                for (const auto& parameter : *parameters)
+                {
+                    const auto symbol = parameter.getProperty ("symbol", {}).toString();
+
+                    // Unknown symbols are skipped like mod-host does, the GUI reports them when it verifies the board
+                    if (auto* target = findParameter (*pedal, symbol))
+                        setPlainValue (*target, (float) parameter.getProperty ("default", target->convertFrom0to1 (target->getValue())));
+                    else
+                        std::fprintf (stderr, "%s: no parameter '%s'\n", pedal->name.toRawUTF8(), symbol.toRawUTF8());
+                }
+            }
+
+            board.pedals.push_back (std::move (pedal));
+        }
+
+        return juce::Result::ok();
+    }
+
+    // Allocates everything the board needs to run at the device's settings. Never called from the audio thread.
+    void prepareBoard (Board& board)
+    {
+        for (auto& pedal : board.pedals)
+        {
+            pedal->processor->setPlayConfigDetails (numChannels, numChannels, sampleRate, blockSize);
+            pedal->processor->prepareToPlay (sampleRate, blockSize);
+        }
+
+        board.buffer.setSize (numChannels, blockSize);
+        board.pedalLoads.assign (board.pedals.size(), 0.0f);
+        board.loadMeter.prepare ((int) board.pedals.size(), sampleRate, blockSize);
+    }
+
+    // Deletes every board but the last one loaded and makes it the only one playing. Only called while the audio is stopped.
+    void keepOnlyControlledBoard()
+    {
+        releaseRetiredBoards();
+        pendingBoard = nullptr;
+
+        boards.erase (std::remove_if (boards.begin(), boards.end(), [this] (const auto& board) { return board.get() != controlledBoard; }),
+                      boards.end());
+
+        slots = {};
+        slots[0].board = controlledBoard;
+        meteredBoard = controlledBoard;
+    }
+
+    //==============================================================================
+    const LoadMeter& getPlayingMeter() const noexcept
+    {
+        if (auto* board = meteredBoard.load())
+            return board->loadMeter;
+
+        return idleMeter;
+    }
+
+    // The newest board whose output is at full level: the new board once its crossfade is done, the old one before that.
+    // A board that was faded in only partway before the next switch never counts, so the newest board is the fallback.
+    Board* getPlayingBoard() const noexcept
+    {
+        for (const auto& slot : slots)
+            if (slot.board != nullptr && slot.outputGain >= 1.0f)
+                return slot.board;
+
+        return slots[0].board;
+    }
+
+    bool isSwitching() const noexcept
+    {
+        return slots[1].board != nullptr || slots[2].board != nullptr
+                || slots[0].outputGain < 1.0f || slots[0].inputGain < 1.0f;
+    }
+
+    // With every slot taken, the oldest board is dropped at once. That only happens if boards are switched faster
+    // than the old ones ring out. Returns false, leaving the switch for a later block, if it cannot be retired yet.
+    bool makeRoomForSwitch() noexcept
+    {
+        auto& oldest = slots[maxSlots - 1];
+
+        if (oldest.board != nullptr)
+            retireBoard (oldest);
+
+        return oldest.board == nullptr;
+    }
+
+    // Moves every board down a slot and puts the incoming one first
+    void startSwitch (Board* incoming) noexcept
+    {
+        const auto fadeStep = 1.0f / (float) juce::jmax (1.0, crossfadeSeconds * sampleRate);
+
+        // Boards that were already ringing out are faded out, so at most two boards ring at a time
+        for (int i = maxSlots - 1; i > 0; --i)
+        {
+            slots[(size_t) i] = slots[(size_t) i - 1];
+
+            if (i > 1 && slots[(size_t) i].board != nullptr)
+                slots[(size_t) i].outputStep = -fadeStep;
+        }
+
+        // The board that was playing stops taking input but keeps its output where it is, so its tails ring out
+        if (slots[1].board != nullptr)
+        {
+            slots[1].inputStep = -fadeStep;
+            slots[1].outputStep = 0.0f;
+            slots[1].silentSamples = 0;
+            slots[1].tailSamples = 0;
+        }
+
+        slots[0] = { incoming };
+        slots[0].outputGain = 0.0f;
+        slots[0].outputStep = fadeStep;
+    }
+
+    // Fills the buffer from the input, starting at sample start of the device's block, and runs the boards over it
+    void processChain (const float* const* inputChannelData, int numInputChannels, juce::AudioBuffer<float>& buffer, int start, double ticksPerBlock)
+    {
+        // A mono input feeds both channels, like mod-host's capture connections for a mono first pedal
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            if (numInputChannels > 0)
+                buffer.copyFrom (channel, 0, inputChannelData[juce::jmin (channel, numInputChannels - 1)] + start, buffer.getNumSamples());
+            else
+                buffer.clear (channel, 0, buffer.getNumSamples());
+        }
+
+        if (isSwitching())
+            processSwitch (buffer, ticksPerBlock);
+        else if (slots[0].board != nullptr)
+            processBoard (*slots[0].board, buffer, ticksPerBlock, scheduler.getNumWorkers() > 0);
+    }
+
+    // Runs every board on its own copy of the input and mixes their outputs
+    void processSwitch (juce::AudioBuffer<float>& buffer, double ticksPerBlock)
+    {
+        const int numSamples = buffer.getNumSamples();
+        const auto silenceLength = juce::roundToInt (silenceSeconds * sampleRate);
+        const auto maxTailLength = juce::roundToInt (maxTailSeconds * sampleRate);
+
+        jassert (numSamples <= blockSize);
+
+        // Every board takes its input before the first one's output replaces it
+        Board* running[maxSlots];
+        int numRunning = 0;
+
+        for (auto& slot : slots)
+        {
+            if (slot.board == nullptr)
+                continue;
+
+            running[numRunning++] = slot.board;
+            const auto inputEnd = juce::jlimit (0.0f, 1.0f, slot.inputGain + slot.inputStep * (float) numSamples);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                slot.board->buffer.copyFromWithRamp (channel, 0, buffer.getReadPointer (channel), numSamples, slot.inputGain, inputEnd);
+
+            slot.inputGain = inputEnd;
+        }
+
+        // The boards do not depend on each other, so they run on separate cores when there are workers
+        auto processRunningBoard = [&] (int index)
+        {
+            juce::AudioBuffer<float> boardBuffer (running[index]->buffer.getArrayOfWritePointers(), numChannels, numSamples);
+            processBoard (*running[index], boardBuffer, ticksPerBlock, false);
+        };
+
+        scheduler.run (numRunning, processRunningBoard);
+
+        for (auto& slot : slots)
+        {
+            if (slot.board == nullptr)
+                continue;
+
+            juce::AudioBuffer<float> boardBuffer (slot.board->buffer.getArrayOfWritePointers(), numChannels, numSamples);
+            const auto outputEnd = juce::jlimit (0.0f, 1.0f, slot.outputGain + slot.outputStep * (float) numSamples);
+
+            // The first board overwrites the input it was copied from, the others add to it
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                if (&slot == &slots[0])
+                    buffer.copyFromWithRamp (channel, 0, boardBuffer.getReadPointer (channel), numSamples, slot.outputGain, outputEnd);
+                else
+                    buffer.addFromWithRamp (channel, 0, boardBuffer.getReadPointer (channel), numSamples, slot.outputGain, outputEnd);
+            }
+
+            slot.outputGain = outputEnd;
+
+            if (&slot == &slots[0])
+                continue;
+
+            // Once its input is gone, a board is done when its output has been silent for a while or has faded out
+            if (slot.inputGain == 0.0f)
+            {
+                slot.silentSamples = boardBuffer.getMagnitude (0, numSamples) < silenceThreshold ? slot.silentSamples + numSamples : 0;
+                slot.tailSamples += numSamples;
+
+                if (slot.tailSamples >= maxTailLength && slot.outputStep == 0.0f)
+                    slot.outputStep = -1.0f / (float) juce::jmax (1.0, crossfadeSeconds * sampleRate);
+            }
+
+            if (slot.outputGain == 0.0f || slot.silentSamples >= silenceLength)
+                retireBoard (slot);
+        }
+
+        // Boards behind an empty slot move up, so slot 1 is always the most recent one ringing out
+        if (slots[1].board == nullptr && slots[2].board != nullptr)
+            std::swap (slots[1], slots[2]);
+    }
+
+    // Hands a board back to be deleted by releaseRetiredBoards(). If the queue is full it is kept running silently until there is room.
+    void retireBoard (Slot& slot) noexcept
+    {
+        int start1, size1, start2, size2;
+        retiredFifo.prepareToWrite (1, start1, size1, start2, size2);
+
+        if (size1 + size2 == 0)
+        {
+            slot.outputGain = slot.outputStep = 0.0f;
+            return;
+        }
+
+        // The meter moves to another board before this one can be seen in the queue and deleted
+        if (meteredBoard.load() == slot.board)
+            meteredBoard = slots[0].board;
+
+        retiredBoards[(size_t) (size1 > 0 ? start1 : start2)] = slot.board;
+        retiredFifo.finishedWrite (1);
+        slot = {};
+    }
+
+    //==============================================================================
+    // Runs every pedal of a board over the block in place, adding each one's time to its load. With splitChannels, the channels of
+    // PerChannelProcessor pedals run through the scheduler, which must not be running anything else.
+    void processBoard (Board& board, juce::AudioBuffer<float>& buffer, double ticksPerBlock, bool splitChannels)
+    {
+        auto pedalStart = juce::Time::getHighResolutionTicks();
+
+        for (size_t index = 0; index < board.pedals.size(); ++index)
+        {
+            processPedal (*board.pedals[index], buffer, splitChannels);
+
+            const auto pedalEnd = juce::Time::getHighResolutionTicks();
+            board.pedalLoads[index] += (float) ((double) (pedalEnd - pedalStart) / ticksPerBlock);
+            pedalStart = pedalEnd;
+        }
+    }
+
+    // Runs one pedal over the block, split wherever a queued parameter change falls
+    void processPedal (Pedal& pedal, juce::AudioBuffer<float>& buffer, bool splitChannels)
+    {
+        const int numEvents = pedal.events.pop (pedal.pendingEvents.data(), (int) pedal.pendingEvents.size());
+        const int numSamples = buffer.getNumSamples();
+        int start = 0;
+
+        for (int i = 0; i < numEvents;)
+        {
+            const int offset = juce::jmax (start, getSampleOffset (pedal.pendingEvents[(size_t) i].time, numSamples));
+
+            if (offset > start)
+            {
+                processRange (pedal, buffer, start, offset - start, splitChannels);
+                start = offset;
+            }
+
+            // Every change that lands on this sample is applied before any of it is processed
+            for (; i < numEvents && getSampleOffset (pedal.pendingEvents[(size_t) i].time, numSamples) <= start; ++i)
+                pedal.pendingEvents[(size_t) i].parameter->setValue (pedal.pendingEvents[(size_t) i].value);
+        }
+
+        processRange (pedal, buffer, start, numSamples - start, splitChannels);
+    }
+
+    void processRange (Pedal& pedal, juce::AudioBuffer<float>& buffer, int start, int numSamples, bool splitChannels)
+    {
+        if (pedal.bypassed || numSamples == 0)
+            return;
+
+        if (splitChannels && pedal.perChannel != nullptr && numSamples <= blockSize)
+        {
+            if (! pedal.perChannel->beginBlock (numSamples)) // Pass-Through
+                return;
+
+            // The pointers are taken here, since getWritePointer() marks the buffer as not clear and is not safe from several threads
+            auto* const* channels = buffer.getArrayOfWritePointers();
+
+            auto processChannel = [&] (int channel)
+            {
+                pedal.perChannel->processChannel (channel, channels[channel] + start, numSamples);
+            };
+
+            scheduler.run (numChannels, processChannel);
+            return;
+        }
+
+        juce::AudioBuffer<float> range (buffer.getArrayOfWritePointers(), numChannels, start, numSamples);
+        pedal.processor->processBlock (range, pedal.midi);
+    }
+
+    // Changes are applied one block after they arrive, at the same distance from the block start as they
+    // arrived after the start of the previous block
+    int getSampleOffset (juce::int64 time, int numSamples) const noexcept
+    {
+        return juce::jlimit (0, numSamples - 1, (int) ((double) (time - lastBlockStart) * samplesPerTick));
+    }
+
+    // Matches the folder named in a board URI such as ".../tree/main/ChorusPlugin/ChorusJUCE"
+    static const PluginInfo* findPlugin (const juce::String& uri)
+    {
+        static const auto plugins = getAllPlugins();
+
+        // Older boards still use the name FunDistortion had before it was renamed
+        const auto folder = uri.fromFirstOccurrenceOf ("/tree/main/", false, false)
+                               .upToFirstOccurrenceOf ("/", false, false)
+                               .replace ("UniqueDistortionPlugin", "FunDistortionPlugin");
+
+        for (const auto& plugin : plugins)
+            if (plugin.directory == folder)
+                return &plugin;
+
+        return nullptr;
+    }
+
+    static juce::RangedAudioParameter* findParameter (Pedal& pedal, const juce::String& symbol)
+    {
+        const auto id = symbol.fromLastOccurrenceOf (":", false, false);
+
+        for (auto* parameter : pedal.processor->getParameters())
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (parameter))
+                if (ranged->getParameterID() == id)
+                    return ranged;
+
+        return nullptr;
+    }
+
+    static void setPlainValue (juce::RangedAudioParameter& parameter, float value)
+    {
+        parameter.setValueNotifyingHost (parameter.convertTo0to1 (value));
+    }
+
+    //==============================================================================
+    std::vector<std::unique_ptr<Board>> boards;     // Every board that still exists, owned by the command side
+    Board* controlledBoard = nullptr;               // The board last loaded
+    LoadMeter idleMeter;                            // Reports nothing while there is no board
+
+    std::atomic<Board*> pendingBoard { nullptr };   // Prepared and waiting for the audio thread to switch to it
+    std::atomic<Board*> meteredBoard { nullptr };   // The board whose loads are reported, set by the audio thread while it runs
+    std::array<Slot, maxSlots> slots;               // Only used by the audio thread while it runs
+    ChainScheduler scheduler;
+
+    juce::AbstractFifo retiredFifo { retiredCapacity };
+    std::array<Board*, retiredCapacity> retiredBoards {};
+
+    juce::CriticalSection deviceLock;               // Guards the boards and device settings between the command and device threads
+    bool deviceRunning = false;
+    double sampleRate = 44100.0;                    // The device's, set before the audio starts
+    int blockSize = 512;
+
+    juce::AudioBuffer<float> scratch;
+
+    double samplesPerTick = 0.0;
+    juce::int64 lastBlockStart = 0;     // Only used by the audio thread
+
+    juce::AudioIODevice* currentDevice = nullptr;
+    int lastXRunCount = 0;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PedalChain)
+};
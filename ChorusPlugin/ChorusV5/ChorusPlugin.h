@@ -52,9 +52,15 @@
 
 #pragma once
 
+#include "ChorusEngine.h"
+#include "LFOShapes.h"
+#include "PerChannelProcessor.h"
+#include "PluginState.h"
+
 
 //==============================================================================
-class ChorusProcessor final : public juce::AudioProcessor
+class ChorusProcessor final : public juce::AudioProcessor,
+                              public PerChannelProcessor
 {
 public:
 
@@ -71,387 +77,89 @@ public:
         
         // Waveform 0: Pass-Through, Waveform 1: Sinusoidal LFO, Waveform 2: Saw Wave LFO, Waveform 3: Square Wave LFO
         addParameter (waveform = new juce::AudioParameterInt ({ "waveform", 1 }, "Waveform", 0, 3, 1));
+        
+        // Number of chorus voices on the first channel, the second channel uses one fewer
+        addParameter (voices = new juce::AudioParameterInt ({ "voices", 1 }, "Voices", 1, ChorusEngine::maxVoices, ChorusEngine::maxVoices));
     }
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override
     {  
-        // Sets specs for a JUCE DSP processor
-        juce::dsp::ProcessSpec spec;
-        spec.maximumBlockSize = samplesPerBlock;
-        spec.sampleRate = sampleRate;
-        spec.numChannels = getTotalNumOutputChannels();
-        
-        
         // Delay Lines
         
-        // Initializes both delay lines
-        chnl1delay.prepare (spec);
-        chnl2delay.prepare (spec);
-        
-        // Since the delay parameter is limited to a maximum of 0.1s, and based on delayInSamples8
-        // which can double the value of the delay parameter based on the LFO, the maximum possible number of samples is sampleRate in samples/s * 0.2s
-        chnl1delay.setMaximumDelayInSamples (sampleRate * 0.2f);
-        chnl2delay.setMaximumDelayInSamples (sampleRate * 0.2f);
+        // Since the delay parameter is limited to a maximum of 0.1s, and the longest voice
+        // can double the value of the delay parameter based on the LFO, the maximum possible number of samples is sampleRate in samples/s * 0.2s
+        chorus.prepare (getTotalNumOutputChannels(), (int) (sampleRate * 0.2f));
         
-        // Converts delay in seconds to delay in samples and updates delay of both delay lines
-        delayFloat = delay->get();
-        chnl1delay.setDelay (delayFloat * sampleRate);
-        chnl2delay.setDelay (delayFloat * sampleRate);
+        // One LFO value per sample of the block, shared by every voice of a channel. Each channel has its own,
+        // so the channels can run on different threads.
+        for (auto& lfoValues : lfoBuffers)
+            lfoValues.assign ((size_t) juce::jmax (1, samplesPerBlock), 0.0f);
         
         
         // LFOs
         
-        // Initializes all LFOs
-        chnl1sineLFO.prepare (spec);
-        chnl2sineLFO.prepare (spec);
-        chnl1sawLFO.prepare (spec);
-        chnl2sawLFO.prepare (spec);
-        chnl1squareLFO.prepare (spec);
-        chnl2squareLFO.prepare (spec);
+        // Initializes both LFOs
+        for (auto& lfo : channelLFO)
+            lfo.prepare (sampleRate);
         
-        // Updates rate of all LFOs
-        rateFloat = rate->get();
-        chnl1sineLFO.setFrequency (rateFloat);
-        chnl2sineLFO.setFrequency (rateFloat);
-        chnl1sawLFO.setFrequency (rateFloat);
-        chnl2sawLFO.setFrequency (rateFloat);
-        chnl1squareLFO.setFrequency (rateFloat);
-        chnl2squareLFO.setFrequency (rateFloat);
+        
+        // Parameter Smoothing
+        
+        // Delay, depth, mix and gain glide to new values instead of stepping once per block
+        smoothedDelay.prepare (sampleRate, samplesPerBlock, delay->get() * (float) sampleRate);
+        smoothedDepth.prepare (sampleRate, samplesPerBlock, depth->get());
+        smoothedMix.prepare (sampleRate, samplesPerBlock, mix->get());
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
     }
     
     void releaseResources() override {}
 
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
-        gainFloat = gain->get();
+        if (! beginBlock (buffer.getNumSamples())) // Pass-Through
+            return;
+        
+        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+            processChannel (channel, buffer.getWritePointer (channel), buffer.getNumSamples());
+    }
+    
+    //==============================================================================
+    bool beginBlock (int numSamples) override
+    {
         rateFloat = rate->get();
-        depthFloat = depth->get();
-        delayFloat = delay->get();
-        mixFloat = mix->get();
         waveformInt = waveform->get();
+        voicesInt = voices->get();
         
         sampleRate = this->getSampleRate();
         totalNumInputChannels  = getTotalNumInputChannels();
         
-        chnl1sineLFO.setFrequency (rateFloat);
-        chnl2sineLFO.setFrequency (rateFloat);
-        chnl1sawLFO.setFrequency (rateFloat);
-        chnl2sawLFO.setFrequency (rateFloat);
-        chnl1squareLFO.setFrequency (rateFloat);
-        chnl2squareLFO.setFrequency (rateFloat);
+        smoothedDelay.update (delay->get() * (float) sampleRate, numSamples); // Delay in samples
+        smoothedDepth.update (depth->get(), numSamples);
+        smoothedMix.update (mix->get(), numSamples);
+        smoothedGain.update (gain->get(), numSamples);
         
-        for (int channel = 0; channel < totalNumInputChannels; ++channel)
-        {
-            auto* channelData = buffer.getWritePointer (channel);
-            
-            switch(waveformInt)
-            {
-                case 1: // Sinusoidal LFO
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            chnl1delay.pushSample(channel, channelData[sample]);
-                    
-                            drySample = channelData[sample];
-                            
-                            lfoValue = chnl1sineLFO.processSample(0.0f);
-                    
-                            delayInSamples1 = (lfoValue * delayFloat/8.0f + delayFloat/8.0f) * sampleRate;
-                            delayInSamples2 = (lfoValue * delayFloat/4.0f + delayFloat/4.0f) * sampleRate;
-                            delayInSamples3 = (lfoValue * delayFloat/(8.0f/3.0f) + delayFloat/(8.0f/3.0f)) * sampleRate;
-                            delayInSamples4 = (lfoValue * delayFloat/2.0f + delayFloat/2.0f) * sampleRate;
-                            delayInSamples5 = (lfoValue * delayFloat/1.6f + delayFloat/1.6f) * sampleRate;
-                            delayInSamples6 = (lfoValue * delayFloat/(4.0f/3.0f) + delayFloat/(4.0f/3.0f)) * sampleRate;
-                            delayInSamples7 = (lfoValue * delayFloat/(8.0f/7.0f) + delayFloat/(8.0f/7.0f)) * sampleRate;
-                            delayInSamples8 = (lfoValue * delayFloat + delayFloat) * sampleRate; // Delay parameter controls the average delay of the most delayed sample
-                            
-                            lfoValue = 0.5f * abs(lfoValue) + 0.5f;
-                    
-                            wetSample1 = chnl1delay.popSample(channel, delayInSamples1, true);
-                            wetSample1 = (wetSample1 * ((depthFloat/8.0f) * lfoValue + (1.0f - (depthFloat/8.0f)))); // AM
-                    
-                            wetSample2 = chnl1delay.popSample(channel, delayInSamples2, true);
-                            wetSample2 = (wetSample2 * ((depthFloat/4.0f) * lfoValue + (1.0f - (depthFloat/4.0f))));
-                    
-                            wetSample3 = chnl1delay.popSample(channel, delayInSamples3, true);
-                            wetSample3 = (wetSample3 * ((depthFloat/(8.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/3.0f)))));
-                    
-                            wetSample4 = chnl1delay.popSample(channel, delayInSamples4, true);
-                            wetSample4 = (wetSample4 * ((depthFloat/2.0f) * lfoValue + (1.0f - (depthFloat/2.0f))));
-                    
-                            wetSample5 = chnl1delay.popSample(channel, delayInSamples5, true);
-                            wetSample5 = (wetSample5 * ((depthFloat/1.6f) * lfoValue + (1.0f - (depthFloat/1.6f))));
-                    
-                            wetSample6 = chnl1delay.popSample(channel, delayInSamples6, true);
-                            wetSample6 = (wetSample6 * ((depthFloat/(4.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(4.0f/3.0f)))));
-                    
-                            wetSample7 = chnl1delay.popSample(channel, delayInSamples7, true);
-                            wetSample7 = (wetSample7 * ((depthFloat/(8.0f/7.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/7.0f)))));
-                    
-                            wetSample8 = chnl1delay.popSample(channel, delayInSamples8, true);
-                            wetSample8 = (wetSample8 * ((depthFloat) * lfoValue + (1.0f - (depthFloat))));
-                    
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/4.5f) + (wetSample2 * mixFloat/(36.0f/7.0f)) + (wetSample3 * mixFloat/6.0f) + (wetSample4 * mixFloat/7.2f) + (wetSample5 * mixFloat/9.0f) + (wetSample6 * mixFloat/12.0f) + (wetSample7 * mixFloat/18.0f) + (wetSample8 * mixFloat/36.0f); // Mix dry and wet samples
-                            // Uncomment the line below and comment out the line above for a different mixing ratio
-                            //channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/8.0f) + (wetSample2 * mixFloat/8.0f) + (wetSample3 * mixFloat/8.0f) + (wetSample4 * mixFloat/8.0f) + (wetSample5 * mixFloat/8.0f) + (wetSample6 * mixFloat/8.0f) + (wetSample7 * mixFloat/8.0f) + (wetSample8 * mixFloat/8.0f);
-                    
-                            channelData[sample] *= gainFloat; // Gain
-                        }
-                    }
-                    else // Handles the second channel for stereo input but doesn't run for mono input
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            chnl2delay.pushSample(channel, channelData[sample]);
-                            
-                            drySample = channelData[sample];
-                    
-                            lfoValue = chnl2sineLFO.processSample(0.0f);
-                    
-                            delayInSamples1 = (lfoValue * delayFloat/7.0f + delayFloat/7.0f) * sampleRate;
-                            delayInSamples2 = (lfoValue * delayFloat/3.5f + delayFloat/3.5f) * sampleRate;
-                            delayInSamples3 = (lfoValue * delayFloat/(7.0f/3.0f) + delayFloat/(7.0f/3.0f)) * sampleRate;
-                            delayInSamples4 = (lfoValue * delayFloat/1.75f + delayFloat/1.75f) * sampleRate;
-                            delayInSamples5 = (lfoValue * delayFloat/1.4f + delayFloat/1.4f) * sampleRate;
-                            delayInSamples6 = (lfoValue * delayFloat/(7.0f/6.0f) + delayFloat/(7.0f/6.0f)) * sampleRate;
-                            delayInSamples7 = (lfoValue * delayFloat + delayFloat) * sampleRate;
-                    
-                            lfoValue = 0.5f * abs(lfoValue) + 0.5f;
-                    
-                            wetSample1 = chnl2delay.popSample(channel, delayInSamples1, true);
-                            wetSample1 = (wetSample1 * ((depthFloat/8.0f) * lfoValue + (1.0f - (depthFloat/8.0f))));
-                    
-                            wetSample2 = chnl2delay.popSample(channel, delayInSamples2, true);
-                            wetSample2 = (wetSample2 * ((depthFloat/4.0f) * lfoValue + (1.0f - (depthFloat/4.0f))));
-                    
-                            wetSample3 = chnl2delay.popSample(channel, delayInSamples3, true);
-                            wetSample3 = (wetSample3 * ((depthFloat/(8.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/3.0f)))));
-                    
-                            wetSample4 = chnl2delay.popSample(channel, delayInSamples4, true);
-                            wetSample4 = (wetSample4 * ((depthFloat/2.0f) * lfoValue + (1.0f - (depthFloat/2.0f))));
-                    
-                            wetSample5 = chnl2delay.popSample(channel, delayInSamples5, true);
-                            wetSample5 = (wetSample5 * ((depthFloat/1.6f) * lfoValue + (1.0f - (depthFloat/1.6f))));
-                    
-                            wetSample6 = chnl2delay.popSample(channel, delayInSamples6, true);
-                            wetSample6 = (wetSample6 * ((depthFloat/(4.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(4.0f/3.0f)))));
-                    
-                            wetSample7 = chnl2delay.popSample(channel, delayInSamples7, true);
-                            wetSample7 = (wetSample7 * ((depthFloat/(8.0f/7.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/7.0f)))));
-                    
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/4.0f) + (wetSample2 * mixFloat/(14.0f/3.0f)) + (wetSample3 * mixFloat/5.6f) + (wetSample4 * mixFloat/7.0f) + (wetSample5 * mixFloat/(28.0f/3.0f)) + (wetSample6 * mixFloat/14.0f) + (wetSample7 * mixFloat/28.0f);
-                            // Uncomment the line below and comment out the line above for a different mixing ratio
-                            //channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/7.0f) + (wetSample2 * mixFloat/7.0f) + (wetSample3 * mixFloat/7.0f) + (wetSample4 * mixFloat/7.0f) + (wetSample5 * mixFloat/7.0f) + (wetSample6 * mixFloat/7.0f) + (wetSample7 * mixFloat/7.0f);
-                    
-                            channelData[sample] *= gainFloat;
-                        }
-                    }
-                    break;
-                    
-                case 2: // Saw Wave LFO
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            chnl1delay.pushSample(channel, channelData[sample]);
-                    
-                            lfoValue = chnl1sawLFO.processSample(0.0f);
-                    
-                            delayInSamples1 = (lfoValue * delayFloat/8.0f + delayFloat/8.0f) * sampleRate;
-                            delayInSamples2 = (lfoValue * delayFloat/4.0f + delayFloat/4.0f) * sampleRate;
-                            delayInSamples3 = (lfoValue * delayFloat/(8.0f/3.0f) + delayFloat/(8.0f/3.0f)) * sampleRate;
-                            delayInSamples4 = (lfoValue * delayFloat/2.0f + delayFloat/2.0f) * sampleRate;
-                            delayInSamples5 = (lfoValue * delayFloat/1.6f + delayFloat/1.6f) * sampleRate;
-                            delayInSamples6 = (lfoValue * delayFloat/(4.0f/3.0f) + delayFloat/(4.0f/3.0f)) * sampleRate;
-                            delayInSamples7 = (lfoValue * delayFloat/(8.0f/7.0f) + delayFloat/(8.0f/7.0f)) * sampleRate;
-                            delayInSamples8 = (lfoValue * delayFloat + delayFloat) * sampleRate; // Delay parameter controls the average delay of the most delayed sample
-                    
-                            drySample = channelData[sample];
-                    
-                            wetSample1 = chnl1delay.popSample(channel, delayInSamples1, true);
-                            wetSample1 = (wetSample1 * ((depthFloat/8.0f) * lfoValue + (1.0f - (depthFloat/8.0f)))); // AM
-                    
-                            wetSample2 = chnl1delay.popSample(channel, delayInSamples2, true);
-                            wetSample2 = (wetSample2 * ((depthFloat/4.0f) * lfoValue + (1.0f - (depthFloat/4.0f))));
-                    
-                            wetSample3 = chnl1delay.popSample(channel, delayInSamples3, true);
-                            wetSample3 = (wetSample3 * ((depthFloat/(8.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/3.0f)))));
-                    
-                            wetSample4 = chnl1delay.popSample(channel, delayInSamples4, true);
-                            wetSample4 = (wetSample4 * ((depthFloat/2.0f) * lfoValue + (1.0f - (depthFloat/2.0f))));
-                    
-                            wetSample5 = chnl1delay.popSample(channel, delayInSamples5, true);
-                            wetSample5 = (wetSample5 * ((depthFloat/1.6f) * lfoValue + (1.0f - (depthFloat/1.6f))));
-                    
-                            wetSample6 = chnl1delay.popSample(channel, delayInSamples6, true);
-                            wetSample6 = (wetSample6 * ((depthFloat/(4.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(4.0f/3.0f)))));
-                    
-                            wetSample7 = chnl1delay.popSample(channel, delayInSamples7, true);
-                            wetSample7 = (wetSample7 * ((depthFloat/(8.0f/7.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/7.0f)))));
-                    
-                            wetSample8 = chnl1delay.popSample(channel, delayInSamples8, true);
-                            wetSample8 = (wetSample8 * ((depthFloat) * lfoValue + (1.0f - (depthFloat))));
-                    
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/4.5f) + (wetSample2 * mixFloat/(36.0f/7.0f)) + (wetSample3 * mixFloat/6.0f) + (wetSample4 * mixFloat/7.2f) + (wetSample5 * mixFloat/9.0f) + (wetSample6 * mixFloat/12.0f) + (wetSample7 * mixFloat/18.0f) + (wetSample8 * mixFloat/36.0f); // Mix dry and wet samples
-                            // Uncomment the line below and comment out the line above for a different mixing ratio
-                            //channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/8.0f) + (wetSample2 * mixFloat/8.0f) + (wetSample3 * mixFloat/8.0f) + (wetSample4 * mixFloat/8.0f) + (wetSample5 * mixFloat/8.0f) + (wetSample6 * mixFloat/8.0f) + (wetSample7 * mixFloat/8.0f) + (wetSample8 * mixFloat/8.0f);
-                    
-                            channelData[sample] *= gainFloat; // Gain
-                        }
-                    }
-                    else
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            chnl2delay.pushSample(channel, channelData[sample]);
-                    
-                            lfoValue = chnl2sawLFO.processSample(0.0f);
-                    
-                            delayInSamples1 = (lfoValue * delayFloat/7.0f + delayFloat/7.0f) * sampleRate;
-                            delayInSamples2 = (lfoValue * delayFloat/3.5f + delayFloat/3.5f) * sampleRate;
-                            delayInSamples3 = (lfoValue * delayFloat/(7.0f/3.0f) + delayFloat/(7.0f/3.0f)) * sampleRate;
-                            delayInSamples4 = (lfoValue * delayFloat/1.75f + delayFloat/1.75f) * sampleRate;
-                            delayInSamples5 = (lfoValue * delayFloat/1.4f + delayFloat/1.4f) * sampleRate;
-                            delayInSamples6 = (lfoValue * delayFloat/(7.0f/6.0f) + delayFloat/(7.0f/6.0f)) * sampleRate;
-                            delayInSamples7 = (lfoValue * delayFloat + delayFloat) * sampleRate;
-                    
-                            drySample = channelData[sample];
-                    
-                            wetSample1 = chnl2delay.popSample(channel, delayInSamples1, true);
-                            wetSample1 = (wetSample1 * ((depthFloat/8.0f) * lfoValue + (1.0f - (depthFloat/8.0f))));
-                    
-                            wetSample2 = chnl2delay.popSample(channel, delayInSamples2, true);
-                            wetSample2 = (wetSample2 * ((depthFloat/4.0f) * lfoValue + (1.0f - (depthFloat/4.0f))));
-                    
-                            wetSample3 = chnl2delay.popSample(channel, delayInSamples3, true);
-                            wetSample3 = (wetSample3 * ((depthFloat/(8.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/3.0f)))));
-                    
-                            wetSample4 = chnl2delay.popSample(channel, delayInSamples4, true);
-                            wetSample4 = (wetSample4 * ((depthFloat/2.0f) * lfoValue + (1.0f - (depthFloat/2.0f))));
-                    
-                            wetSample5 = chnl2delay.popSample(channel, delayInSamples5, true);
-                            wetSample5 = (wetSample5 * ((depthFloat/1.6f) * lfoValue + (1.0f - (depthFloat/1.6f))));
-                    
-                            wetSample6 = chnl2delay.popSample(channel, delayInSamples6, true);
-                            wetSample6 = (wetSample6 * ((depthFloat/(4.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(4.0f/3.0f)))));
-                    
-                            wetSample7 = chnl2delay.popSample(channel, delayInSamples7, true);
-                            wetSample7 = (wetSample7 * ((depthFloat/(8.0f/7.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/7.0f)))));
-                    
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/4.0f) + (wetSample2 * mixFloat/(14.0f/3.0f)) + (wetSample3 * mixFloat/5.6f) + (wetSample4 * mixFloat/7.0f) + (wetSample5 * mixFloat/(28.0f/3.0f)) + (wetSample6 * mixFloat/14.0f) + (wetSample7 * mixFloat/28.0f);
-                            // Uncomment the line below and comment out the line above for a different mixing ratio
-                            //channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/7.0f) + (wetSample2 * mixFloat/7.0f) + (wetSample3 * mixFloat/7.0f) + (wetSample4 * mixFloat/7.0f) + (wetSample5 * mixFloat/7.0f) + (wetSample6 * mixFloat/7.0f) + (wetSample7 * mixFloat/7.0f);
-                    
-                            channelData[sample] *= gainFloat;
-                        }
-                    }
-                    break;
-                    
-                case 3: // Square Wave LFO
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            chnl1delay.pushSample(channel, channelData[sample]);
-                    
-                            lfoValue = chnl1squareLFO.processSample(0.0f);
-                    
-                            delayInSamples1 = (lfoValue * delayFloat/8.0f + delayFloat/8.0f) * sampleRate;
-                            delayInSamples2 = (lfoValue * delayFloat/4.0f + delayFloat/4.0f) * sampleRate;
-                            delayInSamples3 = (lfoValue * delayFloat/(8.0f/3.0f) + delayFloat/(8.0f/3.0f)) * sampleRate;
-                            delayInSamples4 = (lfoValue * delayFloat/2.0f + delayFloat/2.0f) * sampleRate;
-                            delayInSamples5 = (lfoValue * delayFloat/1.6f + delayFloat/1.6f) * sampleRate;
-                            delayInSamples6 = (lfoValue * delayFloat/(4.0f/3.0f) + delayFloat/(4.0f/3.0f)) * sampleRate;
-                            delayInSamples7 = (lfoValue * delayFloat/(8.0f/7.0f) + delayFloat/(8.0f/7.0f)) * sampleRate;
-                            delayInSamples8 = (lfoValue * delayFloat + delayFloat) * sampleRate; // Delay parameter controls the average delay of the most delayed sample
-                    
-                            drySample = channelData[sample];
-                    
-                            wetSample1 = chnl1delay.popSample(channel, delayInSamples1, true);
-                            wetSample1 = (wetSample1 * ((depthFloat/8.0f) * lfoValue + (1.0f - (depthFloat/8.0f)))); // AM
-                    
-                            wetSample2 = chnl1delay.popSample(channel, delayInSamples2, true);
-                            wetSample2 = (wetSample2 * ((depthFloat/4.0f) * lfoValue + (1.0f - (depthFloat/4.0f))));
-                    
-                            wetSample3 = chnl1delay.popSample(channel, delayInSamples3, true);
-                            wetSample3 = (wetSample3 * ((depthFloat/(8.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/3.0f)))));
-                    
-                            wetSample4 = chnl1delay.popSample(channel, delayInSamples4, true);
-                            wetSample4 = (wetSample4 * ((depthFloat/2.0f) * lfoValue + (1.0f - (depthFloat/2.0f))));
-                    
-                            wetSample5 = chnl1delay.popSample(channel, delayInSamples5, true);
-                            wetSample5 = (wetSample5 * ((depthFloat/1.6f) * lfoValue + (1.0f - (depthFloat/1.6f))));
-                    
-                            wetSample6 = chnl1delay.popSample(channel, delayInSamples6, true);
-                            wetSample6 = (wetSample6 * ((depthFloat/(4.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(4.0f/3.0f)))));
-                    
-                            wetSample7 = chnl1delay.popSample(channel, delayInSamples7, true);
-                            wetSample7 = (wetSample7 * ((depthFloat/(8.0f/7.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/7.0f)))));
-                    
-                            wetSample8 = chnl1delay.popSample(channel, delayInSamples8, true);
-                            wetSample8 = (wetSample8 * ((depthFloat) * lfoValue + (1.0f - (depthFloat))));
-                    
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/4.5f) + (wetSample2 * mixFloat/(36.0f/7.0f)) + (wetSample3 * mixFloat/6.0f) + (wetSample4 * mixFloat/7.2f) + (wetSample5 * mixFloat/9.0f) + (wetSample6 * mixFloat/12.0f) + (wetSample7 * mixFloat/18.0f) + (wetSample8 * mixFloat/36.0f); // Mix dry and wet samples
-                            // Uncomment the line below and comment out the line above for a different mixing ratio
-                            //channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/8.0f) + (wetSample2 * mixFloat/8.0f) + (wetSample3 * mixFloat/8.0f) + (wetSample4 * mixFloat/8.0f) + (wetSample5 * mixFloat/8.0f) + (wetSample6 * mixFloat/8.0f) + (wetSample7 * mixFloat/8.0f) + (wetSample8 * mixFloat/8.0f);
-                    
-                            channelData[sample] *= gainFloat; // Gain
-                        }
-                    }
-                    else
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            chnl2delay.pushSample(channel, channelData[sample]);
-                    
-                            lfoValue = chnl2squareLFO.processSample(0.0f);
-                    
-                            delayInSamples1 = (lfoValue * delayFloat/7.0f + delayFloat/7.0f) * sampleRate;
-                            delayInSamples2 = (lfoValue * delayFloat/3.5f + delayFloat/3.5f) * sampleRate;
-                            delayInSamples3 = (lfoValue * delayFloat/(7.0f/3.0f) + delayFloat/(7.0f/3.0f)) * sampleRate;
-                            delayInSamples4 = (lfoValue * delayFloat/1.75f + delayFloat/1.75f) * sampleRate;
-                            delayInSamples5 = (lfoValue * delayFloat/1.4f + delayFloat/1.4f) * sampleRate;
-                            delayInSamples6 = (lfoValue * delayFloat/(7.0f/6.0f) + delayFloat/(7.0f/6.0f)) * sampleRate;
-                            delayInSamples7 = (lfoValue * delayFloat + delayFloat) * sampleRate;
-                    
-                            drySample = channelData[sample];
-                    
-                            wetSample1 = chnl2delay.popSample(channel, delayInSamples1, true);
-                            wetSample1 = (wetSample1 * ((depthFloat/8.0f) * lfoValue + (1.0f - (depthFloat/8.0f))));
-                    
-                            wetSample2 = chnl2delay.popSample(channel, delayInSamples2, true);
-                            wetSample2 = (wetSample2 * ((depthFloat/4.0f) * lfoValue + (1.0f - (depthFloat/4.0f))));
-                    
-                            wetSample3 = chnl2delay.popSample(channel, delayInSamples3, true);
-                            wetSample3 = (wetSample3 * ((depthFloat/(8.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/3.0f)))));
-                    
-                            wetSample4 = chnl2delay.popSample(channel, delayInSamples4, true);
-                            wetSample4 = (wetSample4 * ((depthFloat/2.0f) * lfoValue + (1.0f - (depthFloat/2.0f))));
-                    
-                            wetSample5 = chnl2delay.popSample(channel, delayInSamples5, true);
-                            wetSample5 = (wetSample5 * ((depthFloat/1.6f) * lfoValue + (1.0f - (depthFloat/1.6f))));
-                    
-                            wetSample6 = chnl2delay.popSample(channel, delayInSamples6, true);
-                            wetSample6 = (wetSample6 * ((depthFloat/(4.0f/3.0f)) * lfoValue + (1.0f - (depthFloat/(4.0f/3.0f)))));
-                    
-                            wetSample7 = chnl2delay.popSample(channel, delayInSamples7, true);
-                            wetSample7 = (wetSample7 * ((depthFloat/(8.0f/7.0f)) * lfoValue + (1.0f - (depthFloat/(8.0f/7.0f)))));
-                    
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/4.0f) + (wetSample2 * mixFloat/(14.0f/3.0f)) + (wetSample3 * mixFloat/5.6f) + (wetSample4 * mixFloat/7.0f) + (wetSample5 * mixFloat/(28.0f/3.0f)) + (wetSample6 * mixFloat/14.0f) + (wetSample7 * mixFloat/28.0f);
-                            // Uncomment the line below and comment out the line above for a different mixing ratio
-                            //channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat/7.0f) + (wetSample2 * mixFloat/7.0f) + (wetSample3 * mixFloat/7.0f) + (wetSample4 * mixFloat/7.0f) + (wetSample5 * mixFloat/7.0f) + (wetSample6 * mixFloat/7.0f) + (wetSample7 * mixFloat/7.0f);
-                    
-                            channelData[sample] *= gainFloat;
-                        }
-                    }
-                    break;
-                    
-                default: // Pass-Through
-                    break;
-            }       
-        }
+        // The waveform is resolved once per block, the kernel then runs without branching
+        kernel = selectKernel (waveformInt);
+        
+        if (kernel == nullptr) // Pass-Through
+            return false;
+        
+        // The second channel runs one voice fewer than the first for stereo width, but keeps the first channel's AM spacing
+        chorus.setVoices (0, voicesInt, voicesInt);
+        if (totalNumInputChannels > 1)
+            chorus.setVoices (1, juce::jmax (1, voicesInt - 1), voicesInt);
+        
+        for (auto& lfo : channelLFO)
+            lfo.setFrequency (rateFloat);
+        
+        return true;
+    }
+    
+    void processChannel (int channel, float* channelData, int numSamples) override
+    {
+        if (channel < juce::jmin (totalNumInputChannels, (int) channelLFO.size()))
+            (this->*kernel) (channel, channelData, numSamples);
     }
 
     //==============================================================================
@@ -474,22 +182,12 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-        juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeFloat (*rate);
-        juce::MemoryOutputStream (destData, true).writeFloat (*depth);
-        juce::MemoryOutputStream (destData, true).writeFloat (*delay);
-        juce::MemoryOutputStream (destData, true).writeFloat (*mix);
-        juce::MemoryOutputStream (destData, true).writeInt (*waveform);
+        PluginState::save (*this, destData);
     }
 
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        rate->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        depth->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        delay->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        mix->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        waveform->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readInt());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -502,6 +200,41 @@ public:
     }
 
 private:
+    //==============================================================================
+    using Kernel = void (ChorusProcessor::*) (int, float*, int);
+    
+    // Chorus for one channel, with the LFO shape fixed at compile time
+    template <typename Shape>
+    void chorusKernel (int channel, float* channelData, int numSamples)
+    {
+        // Sine AM is rectified, saw and square AM follow the LFO directly
+        constexpr bool rectifyAM = std::is_same_v<Shape, LFOShape::Sine>;
+        
+        // Blocks larger than the prepared size are handled in prepared-size chunks
+        auto& lfoBuffer = lfoBuffers[(size_t) channel];
+        
+        for (int start = 0; start < numSamples; start += (int) lfoBuffer.size())
+        {
+            const int chunk = juce::jmin ((int) lfoBuffer.size(), numSamples - start);
+            auto* lfoValues = lfoBuffer.data();
+            
+            channelLFO[(size_t) channel].render<Shape> (lfoValues, chunk);
+            chorus.process<rectifyAM> (channel, channelData + start, lfoValues, chunk,
+                                       smoothedDelay, smoothedDepth, smoothedMix, smoothedGain, start);
+        }
+    }
+    
+    // Returns the kernel for the waveform parameter, or nullptr for Pass-Through
+    static Kernel selectKernel (int waveformIndex)
+    {
+        static constexpr Kernel kernels[] = { nullptr,                                           // Pass-Through
+                                              &ChorusProcessor::chorusKernel<LFOShape::Sine>,    // Sinusoidal LFO
+                                              &ChorusProcessor::chorusKernel<LFOShape::Saw>,     // Saw Wave LFO
+                                              &ChorusProcessor::chorusKernel<LFOShape::Square> }; // Square Wave LFO
+        
+        return kernels[juce::jlimit (0, 3, waveformIndex)];
+    }
+    
     //==============================================================================
     juce::AudioParameterFloat* gain;
     juce::AudioParameterFloat* rate;
@@ -509,47 +242,25 @@ private:
     juce::AudioParameterFloat* delay;
     juce::AudioParameterFloat* mix;
     juce::AudioParameterInt* waveform;
+    juce::AudioParameterInt* voices;
     
-    float gainFloat;
     float rateFloat;
-    float depthFloat;
-    float delayFloat;
-    float mixFloat;
     int waveformInt;
+    Kernel kernel = nullptr; // Chosen by beginBlock() for the block
+    int voicesInt;
     
-    float lfoValue;
-    float drySample;
     double sampleRate;
     int totalNumInputChannels;
     
-    float wetSample1;
-    float wetSample2;
-    float wetSample3;
-    float wetSample4;
-    float wetSample5;
-    float wetSample6;
-    float wetSample7;
-    float wetSample8;
-    
-    int delayInSamples1;
-    int delayInSamples2;
-    int delayInSamples3;
-    int delayInSamples4;
-    int delayInSamples5;
-    int delayInSamples6;
-    int delayInSamples7;
-    int delayInSamples8;
+    ChorusEngine chorus;
+    std::array<std::vector<float>, 2> lfoBuffers; // One per channel
     
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Thiran> chnl1delay;
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Thiran> chnl2delay;
+    std::array<LFOPhase, 2> channelLFO; // One LFO per channel, shared by every waveform
     
-    // The last argument for the following lines is the number of points in the lookup table
-    juce::dsp::Oscillator<float> chnl1sineLFO { [](float x) { return std::sin (x); }, 500 }; // Sine Wave
-    juce::dsp::Oscillator<float> chnl1sawLFO { [](float x) { return x / juce::MathConstants<float>::pi; }, 10000 }; // Saw Wave
-    juce::dsp::Oscillator<float> chnl1squareLFO { [](float x) { return x < 0.0f ? -1.0f : 1.0f; }, 10000 }; // Square Wave
-    juce::dsp::Oscillator<float> chnl2sineLFO { [](float x) { return std::sin (x); }, 500 }; // Sine Wave
-    juce::dsp::Oscillator<float> chnl2sawLFO { [](float x) { return x / juce::MathConstants<float>::pi; }, 10000 }; // Saw Wave
-    juce::dsp::Oscillator<float> chnl2squareLFO { [](float x) { return x < 0.0f ? -1.0f : 1.0f; }, 10000 }; // Square Wave
+    SmoothedParameter smoothedDelay;
+    SmoothedParameter smoothedDepth;
+    SmoothedParameter smoothedMix;
+    SmoothedParameter smoothedGain;
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ChorusProcessor)
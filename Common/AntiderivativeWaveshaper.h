@@ -0,0 +1,237 @@
+/*******************************************************************************
+
+ name:             AntiderivativeWaveshaper
+ description:      antiderivative anti-aliasing (ADAA) for the clipping curves
+                   of the distortion plugins.
+
+ Instead of evaluating the curve f at each sample, first-order ADAA outputs
+ the average of f over the straight line between the previous input and this
+ one, (F1(x[n]) - F1(x[n-1])) / (x[n] - x[n-1]), where F1 is f's
+ antiderivative. That is f convolved with a one-sample box, which attenuates
+ the harmonics that would alias at the cost of half a sample of delay and a
+ gentle treble roll-off. Second order does the same with a triangle over
+ three samples and the second antiderivative F2, for stronger suppression and
+ one sample of delay. Neither needs oversampling, though both can also run
+ on the oversampled signal of OversampledWaveshaper.
+
+ Each curve is a struct with static value(), antiderivative() and
+ secondAntiderivative() functions of the input and one curve parameter (the
+ threshold or the cubic factor), so the kernel is templated on the curve and
+ gets it inlined. When consecutive inputs are too close for the differences
+ to be accurate, the kernel falls back to the curve at the midpoint. The
+ antiderivatives are evaluated in double, since the differences of large,
+ nearly equal values lose too much precision in float. value() is in float,
+ so with ADAA off the loop can be vectorized, and FastArctangent swaps
+ std::atan for FastMath::atan there.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "FastMath.h"
+
+
+//==============================================================================
+namespace ClippingCurve
+{
+    // x / (|x| + 1), the reciprocal clipper of DistortionPlugin
+    struct Reciprocal
+    {
+        static float value (float x, float) noexcept                    { return x / (std::abs (x) + 1.0f); }
+        static double antiderivative (double x, double) noexcept        { return std::abs (x) - std::log1p (std::abs (x)); }
+
+        static double secondAntiderivative (double x, double) noexcept
+        {
+            const auto a = std::abs (x);
+            return std::copysign (0.5 * a * a + a - (a + 1.0) * std::log1p (a), x);
+        }
+    };
+
+    // 2 / pi * atan (x), the soft clipper of SaturationPlugin's mode 1
+    struct Arctangent
+    {
+        static float value (float x, float) noexcept
+        {
+            return 2.0f / juce::MathConstants<float>::pi * std::atan (x);
+        }
+
+        static double antiderivative (double x, double) noexcept
+        {
+            return 2.0 / juce::MathConstants<double>::pi * (x * std::atan (x) - 0.5 * std::log1p (x * x));
+        }
+
+        static double secondAntiderivative (double x, double) noexcept
+        {
+            return 1.0 / juce::MathConstants<double>::pi * ((x * x - 1.0) * std::atan (x) + x - x * std::log1p (x * x));
+        }
+    };
+
+    // The same curve through FastMath::atan, for when the exact value is not worth a libm call per sample
+    struct FastArctangent : Arctangent
+    {
+        static float value (float x, float) noexcept
+        {
+            return 2.0f / juce::MathConstants<float>::pi * FastMath::atan (x);
+        }
+    };
+
+    // x - a * x^3, the cubic soft clipper of SaturationPlugin's mode 2
+    struct Cubic
+    {
+        static float value (float x, float a) noexcept                  { return x - a * x * x * x; }
+        static double antiderivative (double x, double a) noexcept      { return x * x * (0.5 - 0.25 * a * x * x); }
+        static double secondAntiderivative (double x, double a) noexcept { return x * x * x * (1.0 / 6.0 - 0.05 * a * x * x); }
+    };
+
+    // Clips at +-t, FuzzPlugin's hard clipper
+    struct HardClip
+    {
+        static float value (float x, float t) noexcept                  { return std::min (std::max (x, -t), t); }
+
+        static double antiderivative (double x, double t) noexcept
+        {
+            return std::abs (x) <= t ? 0.5 * x * x : t * std::abs (x) - 0.5 * t * t;
+        }
+
+        static double secondAntiderivative (double x, double t) noexcept
+        {
+            if (std::abs (x) <= t)
+                return x * x * x / 6.0;
+
+            return std::copysign (0.5 * t * x * x + t * t * t / 6.0, x) - 0.5 * t * t * x;
+        }
+    };
+}
+
+//==============================================================================
+class AntiderivativeWaveshaper
+{
+public:
+    // Values of the plugins' antialiasing parameter
+    enum Order
+    {
+        off         = 0,
+        firstOrder  = 1,
+        secondOrder = 2
+    };
+
+    //==============================================================================
+    // Allocates the per-channel history. Must be called from prepareToPlay.
+    void prepare (int numChannels)
+    {
+        states.assign ((size_t) juce::jmax (1, numChannels), {});
+    }
+
+    // Clears the history of every channel. Every curve passes through zero, so zero is a consistent history.
+    void reset() noexcept
+    {
+        std::fill (states.begin(), states.end(), State());
+    }
+
+    // Called once per block. The history is cleared when the order changes, since it means something else in each order.
+    void setOrder (int newOrder) noexcept
+    {
+        const auto order = (Order) juce::jlimit ((int) off, (int) secondOrder, newOrder);
+
+        if (order != orderInUse)
+        {
+            orderInUse = order;
+            reset();
+        }
+    }
+
+    Order getOrder() const noexcept                             { return orderInUse; }
+
+    // Delay added by the averaging, in samples at the rate the shaper runs at
+    float getLatencyInSamples() const noexcept                  { return 0.5f * (float) orderInUse; }
+
+    //==============================================================================
+    // Shapes numSamples samples of one channel in place. parameterAt (int i) returns the curve's parameter at sample i.
+    template <typename Curve, typename ParameterFunction>
+    void process (int channel, float* channelData, int numSamples, ParameterFunction&& parameterAt)
+    {
+        auto& state = states[(size_t) channel];
+
+        switch (orderInUse)
+        {
+            case firstOrder:
+                for (int sample = 0; sample < numSamples; ++sample)
+                    channelData[sample] = (float) processFirstOrder<Curve> (state, channelData[sample], parameterAt (sample));
+                break;
+
+            case secondOrder:
+                for (int sample = 0; sample < numSamples; ++sample)
+                    channelData[sample] = (float) processSecondOrder<Curve> (state, channelData[sample], parameterAt (sample));
+                break;
+
+            case off:
+            default:
+                for (int sample = 0; sample < numSamples; ++sample)
+                    channelData[sample] = Curve::value (channelData[sample], (float) parameterAt (sample));
+                break;
+        }
+    }
+
+private:
+    //==============================================================================
+    struct State
+    {
+        double x1 = 0.0;            // Previous input
+        double x2 = 0.0;            // Input before that, second order only
+        double integral1 = 0.0;     // Antiderivative of x1 of the order in use
+        double difference1 = 0.0;   // First divided difference of F2 between x2 and x1, second order only
+    };
+
+    // Below this distance between inputs the divided differences are replaced by the midpoint value
+    static constexpr double tolerance = 1.0e-5;
+
+    template <typename Curve>
+    static double processFirstOrder (State& state, double x, double parameter) noexcept
+    {
+        const auto integral = Curve::antiderivative (x, parameter);
+        const auto dx = x - state.x1;
+
+        const auto y = std::abs (dx) < tolerance ? Curve::value ((float) (0.5 * (x + state.x1)), (float) parameter)
+                                                 : (integral - state.integral1) / dx;
+
+        state.x1 = x;
+        state.integral1 = integral;
+        return y;
+    }
+
+    template <typename Curve>
+    static double processSecondOrder (State& state, double x, double parameter) noexcept
+    {
+        const auto integral = Curve::secondAntiderivative (x, parameter);
+        const auto dx = x - state.x1;
+
+        const auto difference = std::abs (dx) < tolerance ? Curve::antiderivative (0.5 * (x + state.x1), parameter)
+                                                          : (integral - state.integral1) / dx;
+        double y;
+
+        if (std::abs (x - state.x2) < tolerance)
+        {
+            // x and x2 nearly coincide, so the triangle is integrated around their midpoint instead
+            const auto midpoint = 0.5 * (x + state.x2);
+            const auto delta = midpoint - state.x1;
+
+            y = std::abs (delta) < tolerance ? Curve::value ((float) (0.5 * (midpoint + state.x1)), (float) parameter)
+                                             : 2.0 / delta * (Curve::antiderivative (midpoint, parameter)
+                                                              + (state.integral1 - Curve::secondAntiderivative (midpoint, parameter)) / delta);
+        }
+        else
+        {
+            y = 2.0 * (difference - state.difference1) / (x - state.x2);
+        }
+
+        state.x2 = state.x1;
+        state.x1 = x;
+        state.integral1 = integral;
+        state.difference1 = difference;
+        return y;
+    }
+
+    //==============================================================================
+    std::vector<State> states;
+    Order orderInUse = off;
+};
@@ -0,0 +1,193 @@
+/*******************************************************************************
+
+ name:             ChorusEngine
+ description:      multi-voice chorus kernel with structure-of-arrays voice state.
+
+ Every voice is a tap on one shared ring buffer per channel. Voice delays, AM
+ depths and mix weights are stored as arrays and processed a SIMD register at a
+ time (4 voices per register on SSE and NEON), so 8 voices cost two register
+ passes per sample instead of eight scalar popSample calls.
+
+ Taps are read with linear interpolation, which keeps the LFO sweep smooth
+ without the recursive state a Thiran all-pass needs per read.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "SmoothedParameter.h"
+
+
+//==============================================================================
+class ChorusEngine
+{
+public:
+    using Lanes = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int numLanes = (int) Lanes::SIMDNumElements;
+    static constexpr int maxVoices = 8;
+    static constexpr int maxGroups = (maxVoices + numLanes - 1) / numLanes;
+
+    //==============================================================================
+    // Allocates the ring buffers. Must be called from prepareToPlay, never from the audio thread.
+    void prepare (int numChannels, int maximumDelayInSamples)
+    {
+        // Power-of-two ring so that wrapping is a mask, plus room for the second interpolation point
+        ringSize = juce::nextPowerOfTwo (juce::jmax (4, maximumDelayInSamples + 2));
+        ringMask = ringSize - 1;
+        maxDelay = (float) (ringSize - 2);
+
+        rings.assign ((size_t) juce::jmax (1, numChannels), std::vector<float> ((size_t) ringSize, 0.0f));
+        writePos.assign (rings.size(), 0);
+        voices.resize (rings.size());
+
+        reset();
+    }
+
+    // Clears the delay history of every channel
+    void reset()
+    {
+        for (auto& ring : rings)
+            std::fill (ring.begin(), ring.end(), 0.0f);
+
+        std::fill (writePos.begin(), writePos.end(), 0);
+    }
+
+    //==============================================================================
+    // Lays out the voices of one channel. Voice i of numVoices (counting from 1) gets
+    //   delay  = i / numVoices of the delay parameter
+    //   AM     = i / amVoices of the depth parameter
+    //   weight = (numVoices + 1 - i) / (1 + 2 + ... + numVoices), so the weights sum to 1
+    void setVoices (int channel, int numVoices, int amVoices)
+    {
+        auto& state = voices[(size_t) channel];
+        state.numVoices = juce::jlimit (1, maxVoices, numVoices);
+        state.numGroups = (state.numVoices + numLanes - 1) / numLanes;
+
+        const float weightSum = (float) (state.numVoices * (state.numVoices + 1)) / 2.0f;
+
+        for (int voice = 0; voice < maxGroups * numLanes; ++voice)
+        {
+            const bool active = voice < state.numVoices;
+            const float position = (float) (voice + 1);
+
+            // Inactive lanes read the newest sample with zero weight so they never contribute
+            state.delayFraction[(size_t) voice] = active ? position / (float) state.numVoices : 0.0f;
+            state.amFraction[(size_t) voice] = active ? position / (float) juce::jmax (1, amVoices) : 0.0f;
+            state.weight[(size_t) voice] = active ? ((float) state.numVoices + 1.0f - position) / weightSum : 0.0f;
+        }
+    }
+
+    //==============================================================================
+    // Processes one channel in place. lfo holds one LFO value per sample in [-1, 1].
+    // When rectifyAM is true the AM signal is 0.5 * |lfo| + 0.5, otherwise the raw LFO value.
+    // The parameters must have been updated for this block; firstSample is the position of
+    // channelData within the block, for callers that process a block in chunks.
+    template <bool rectifyAM>
+    void process (int channel, float* channelData, const float* lfo, int numSamples,
+                  const SmoothedParameter& delayInSamples, const SmoothedParameter& depth,
+                  const SmoothedParameter& mix, const SmoothedParameter& gain, int firstSample = 0)
+    {
+        if (delayInSamples.isSmoothing() || depth.isSmoothing() || mix.isSmoothing() || gain.isSmoothing())
+            processVoices<rectifyAM, true> (channel, channelData, lfo, numSamples, delayInSamples, depth, mix, gain, firstSample);
+        else
+            processVoices<rectifyAM, false> (channel, channelData, lfo, numSamples, delayInSamples, depth, mix, gain, firstSample);
+    }
+
+private:
+    //==============================================================================
+    // While no parameter ramps the per-voice scales are computed once for the block,
+    // otherwise they are recomputed from the parameter values of every sample
+    template <bool rectifyAM, bool isRamping>
+    void processVoices (int channel, float* channelData, const float* lfo, int numSamples,
+                        const SmoothedParameter& delayInSamples, const SmoothedParameter& depth,
+                        const SmoothedParameter& mix, const SmoothedParameter& gain, int firstSample)
+    {
+        const auto& state = voices[(size_t) channel];
+        auto* history = rings[(size_t) channel].data();
+        auto& pos = writePos[(size_t) channel];
+
+        // Per-block constants, one register per group of voices
+        Lanes delayScale[maxGroups], amScale[maxGroups], wetWeight[maxGroups];
+        float dryWeight = 0.0f;
+
+        auto computeScales = [&] (int sample)
+        {
+            const float mixValue = mix.get<isRamping> (sample);
+            const float gainValue = gain.get<isRamping> (sample);
+
+            for (int group = 0; group < state.numGroups; ++group)
+            {
+                const auto offset = (size_t) (group * numLanes);
+                delayScale[group] = Lanes::fromRawArray (state.delayFraction.data() + offset) * delayInSamples.get<isRamping> (sample);
+                amScale[group] = Lanes::fromRawArray (state.amFraction.data() + offset) * depth.get<isRamping> (sample);
+                wetWeight[group] = Lanes::fromRawArray (state.weight.data() + offset) * (mixValue * gainValue);
+            }
+
+            dryWeight = (1.0f - mixValue) * gainValue;
+        };
+
+        if constexpr (! isRamping)
+            computeScales (firstSample);
+
+        alignas (16) float delays[numLanes];
+        alignas (16) float taps[numLanes];
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            if constexpr (isRamping)
+                computeScales (firstSample + sample);
+
+            const float drySample = channelData[sample];
+            history[pos] = drySample;
+
+            const float sweep = lfo[sample] + 1.0f;
+            const float amValue = rectifyAM ? 0.5f * std::abs (lfo[sample]) + 0.5f : lfo[sample];
+
+            auto wet = Lanes::expand (0.0f);
+
+            for (int group = 0; group < state.numGroups; ++group)
+            {
+                // Voice delays for this sample, clamped to the ring
+                Lanes::min (delayScale[group] * sweep, Lanes::expand (maxDelay)).copyToRawArray (delays);
+
+                // The ring is read at a different position per lane, so the gather itself stays scalar
+                for (int lane = 0; lane < numLanes; ++lane)
+                {
+                    const int whole = (int) delays[lane];
+                    const float fraction = delays[lane] - (float) whole;
+                    const float newer = history[(pos - whole) & ringMask];
+                    const float older = history[(pos - whole - 1) & ringMask];
+                    taps[lane] = newer + fraction * (older - newer);
+                }
+
+                // AM: depth * fraction * am + (1 - depth * fraction)
+                const auto amGain = amScale[group] * (amValue - 1.0f) + 1.0f;
+                wet += Lanes::fromRawArray (taps) * amGain * wetWeight[group];
+            }
+
+            channelData[sample] = drySample * dryWeight + wet.sum(); // Mix dry and wet samples, then gain
+
+            pos = (pos + 1) & ringMask;
+        }
+    }
+
+    //==============================================================================
+    struct VoiceState
+    {
+        alignas (16) std::array<float, maxGroups * numLanes> delayFraction {};
+        alignas (16) std::array<float, maxGroups * numLanes> amFraction {};
+        alignas (16) std::array<float, maxGroups * numLanes> weight {};
+        int numVoices = 1;
+        int numGroups = 1;
+    };
+
+    // One history per audio channel, with nothing shared between them, so channels can be processed on different threads
+    std::vector<std::vector<float>> rings;
+    std::vector<int> writePos;      // Index of the newest sample, per channel
+    std::vector<VoiceState> voices; // Voice layout, per channel
+
+    int ringSize = 4;
+    int ringMask = 3;
+    float maxDelay = 2.0f;
+};
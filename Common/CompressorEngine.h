@@ -0,0 +1,98 @@
+/*******************************************************************************
+
+ name:             CompressorEngine
+ description:      feed-forward compressor with a per-sample threshold and a
+                   vectorized log-domain gain computer.
+
+ juce::dsp::Compressor takes one threshold per block and computes its gain
+ with a pow() per sample. Here a block is processed in two passes. The first
+ runs the recursive peak follower (an EnvelopeFollower) and writes the
+ envelope to a scratch buffer. The second is the gain computer, which has no
+ state, so it runs as a plain vectorized loop:
+
+   gain = exp (max (ln envelope - ln threshold, 0) * (1 / ratio - 1))
+
+ That is the usual dB-domain static curve, in natural log units. The
+ threshold can be a constant or one value per sample in dB, so a modulated
+ threshold costs one array read per sample and not a coefficient update per
+ block. ln and exp are the FastMath approximations. Their few ulps of error
+ are far below anything audible in a gain.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "EnvelopeFollower.h"
+#include "FastMath.h"
+
+
+//==============================================================================
+class CompressorEngine
+{
+public:
+    //==============================================================================
+    // Allocates the envelope state and scratch buffer. Must be called from prepareToPlay.
+    void prepare (int numChannels, double sampleRate, int maximumBlockSize)
+    {
+        follower.prepare (numChannels, sampleRate);
+        envelope.assign ((size_t) juce::jmax (1, maximumBlockSize), 0.0f);
+    }
+
+    void reset() noexcept                                       { follower.reset(); }
+
+    //==============================================================================
+    // Times in milliseconds, for the envelope to cover 99% of a step. The coefficients only change with the times.
+    void setTimes (float attackMs, float releaseMs) noexcept    { follower.setTimes (attackMs, releaseMs); }
+
+    // Ratio of 1 or more, 1 leaves the signal untouched
+    void setRatio (float newRatio) noexcept                     { slope = 1.0f / juce::jmax (1.0f, newRatio) - 1.0f; }
+
+    //==============================================================================
+    // Compresses numSamples samples of one channel in place with the same threshold, in dB, for every sample
+    void process (int channel, float* channelData, int numSamples, float thresholdDb) noexcept
+    {
+        const float logThreshold = thresholdDb * dBToLog;
+        processChunks (channel, channelData, numSamples, [logThreshold] (int) { return logThreshold; });
+    }
+
+    // Compresses numSamples samples of one channel in place with one threshold in dB per sample
+    void process (int channel, float* channelData, int numSamples, const float* thresholdDb) noexcept
+    {
+        processChunks (channel, channelData, numSamples, [thresholdDb] (int sample) { return thresholdDb[sample] * dBToLog; });
+    }
+
+private:
+    //==============================================================================
+    // ln (10) / 20, converts dB to natural log units
+    static constexpr float dBToLog = 0.115129255f;
+
+    // The scratch buffer is sized for the prepared block size, so longer blocks are compressed in pieces
+    template <typename LogThresholdFunction>
+    void processChunks (int channel, float* channelData, int numSamples, LogThresholdFunction&& logThresholdAt) noexcept
+    {
+        const int chunkSize = (int) envelope.size();
+        float* levels = envelope.data();
+        const float gainSlope = slope;     // Copies, since the compiler has to assume channelData could overwrite the members
+
+        for (int start = 0; start < numSamples; start += chunkSize)
+        {
+            const int length = juce::jmin (chunkSize, numSamples - start);
+            auto* data = channelData + start;
+
+            follower.process (channel, data, levels, length);
+
+            for (int sample = 0; sample < length; ++sample)
+            {
+                // max (difference, 0) without a float comparison, which would keep the loop scalar under trapping math
+                const float difference = FastMath::log (levels[sample]) - logThresholdAt (start + sample);
+                const float overshoot = 0.5f * (difference + std::abs (difference));
+                data[sample] *= FastMath::exp (overshoot * gainSlope);
+            }
+        }
+    }
+
+    //==============================================================================
+    EnvelopeFollower follower;          // Peak detector, one envelope per channel
+    std::vector<float> envelope;        // Envelope of the chunk being compressed
+    float slope = 0.0f;                 // 1 / ratio - 1, the gain per unit of overshoot in the log domain
+};
@@ -0,0 +1,286 @@
+/*******************************************************************************
+
+ name:             DelayMemory
+ description:      delay history for every channel of a plugin in one
+                   allocation, stored as float, 16-bit or bfloat16.
+
+ juce::dsp::DelayLine allocates spec.numChannels channels, so a plugin that
+ keeps one DelayLine per channel allocates every channel twice over. Here a
+ plugin gets exactly one ring per channel it uses, all in one block, each
+ ring starting on its own cache line and only as long as the longest delay
+ plus the two samples interpolation needs.
+
+ History can be stored in three formats:
+   float32   4 bytes per sample, lossless
+   int16     2 bytes per sample, fixed point over +-4 (12 dB of headroom above
+             full scale, clipped beyond it), rounding noise 89 dB RMS below 1.0
+   bfloat16  2 bytes per sample, the top half of a float (8 bits of mantissa),
+             so the noise follows the level at about 56 dB RMS below it
+ The 16-bit formats halve the footprint of long delays, at the cost of a
+ noise floor in the repeats. Short modulation delays gain nothing from them.
+
+ Samples are converted as they are written and read, in plain loops over
+ spans that the compiler vectorizes. withChannel() switches on the format
+ once and hands the caller a Channel typed for it, so the per-sample code
+ is compiled once per format without a branch inside it.
+
+ Every DelayMemory adds its size to a process-wide total, so a host can tell
+ how much delay memory a whole board holds.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+class DelayMemory
+{
+public:
+    // Values of the plugins' history parameter
+    enum Format
+    {
+        float32  = 0,
+        int16    = 1,
+        bfloat16 = 2
+    };
+
+    DelayMemory() = default;
+
+    ~DelayMemory()
+    {
+        getTotalCounter() -= sizeInBytes;
+    }
+
+    //==============================================================================
+    // Allocates and clears the rings. Must be called from prepareToPlay, never from the audio thread.
+    void prepare (int numChannels, int maximumDelayInSamples, Format newFormat = float32)
+    {
+        format = (Format) juce::jlimit ((int) float32, (int) bfloat16, (int) newFormat);
+        channels = juce::jmax (1, numChannels);
+
+        // One extra sample so the longest delay never reads the write position, and one for the second interpolation point
+        ringSize = juce::jmax (2, maximumDelayInSamples + 2);
+
+        const auto bytesPerSample = (size_t) (format == float32 ? sizeof (float) : sizeof (juce::uint16));
+        channelStride = ((size_t) ringSize * bytesPerSample + cacheLine - 1) / cacheLine * cacheLine;
+
+        getTotalCounter() -= sizeInBytes;
+        sizeInBytes = channelStride * (size_t) channels + cacheLine;
+        getTotalCounter() += sizeInBytes;
+
+        memory.allocate (sizeInBytes, true);
+        writePos.assign ((size_t) channels, 0);
+
+        // The rings start on a cache line whatever alignment the allocator gives
+        const auto address = reinterpret_cast<juce::pointer_sized_uint> (memory.get());
+        firstRing = memory.get() + ((cacheLine - address % cacheLine) % cacheLine);
+    }
+
+    // Clears the history of every channel. Zero is zero in every format.
+    void reset() noexcept
+    {
+        if (sizeInBytes > 0)
+            std::fill (memory.get(), memory.get() + sizeInBytes, (char) 0);
+
+        std::fill (writePos.begin(), writePos.end(), 0);
+    }
+
+    Format getFormat() const noexcept                           { return format; }
+    int getNumChannels() const noexcept                         { return channels; }
+    int getMaximumDelayInSamples() const noexcept               { return ringSize - 2; }
+
+    // Bytes allocated by this instance, and by every instance in the process
+    size_t getSizeInBytes() const noexcept                      { return sizeInBytes; }
+    static size_t getTotalSizeInBytes() noexcept                { return getTotalCounter().load(); }
+
+    //==============================================================================
+    struct Float32
+    {
+        using Stored = float;
+        static float decode (float stored) noexcept             { return stored; }
+        static float encode (float sample) noexcept             { return sample; }
+    };
+
+    struct Int16
+    {
+        using Stored = juce::int16;
+        static constexpr float range = 4.0f;
+
+        static float decode (juce::int16 stored) noexcept       { return (float) stored * (range / 32767.0f); }
+
+        // Clamped and rounded without float comparisons, which would keep the loops scalar under trapping math
+        static juce::int16 encode (float sample) noexcept
+        {
+            const auto clamped = 0.5f * (std::abs (sample + range) - std::abs (sample - range));
+            const auto scaled = clamped * (32767.0f / range);
+            return (juce::int16) (int) (scaled + std::copysign (0.5f, scaled));
+        }
+    };
+
+    struct BFloat16
+    {
+        using Stored = juce::uint16;
+
+        static float decode (juce::uint16 stored) noexcept
+        {
+            const auto bits = (juce::uint32) stored << 16;
+            float sample;
+            std::memcpy (&sample, &bits, sizeof (sample));
+            return sample;
+        }
+
+        // Rounds to nearest even, the top half of the float after rounding
+        static juce::uint16 encode (float sample) noexcept
+        {
+            juce::uint32 bits;
+            std::memcpy (&bits, &sample, sizeof (bits));
+            return (juce::uint16) ((bits + 0x7fffu + ((bits >> 16) & 1u)) >> 16);
+        }
+    };
+
+    //==============================================================================
+    // One channel's ring, typed for the storage format. Delays are in whole samples, 1 being the latest sample written.
+    template <typename Codec>
+    class Channel
+    {
+    public:
+        using Stored = typename Codec::Stored;
+
+        Channel (Stored* ringToUse, int sizeOfRing, int& writePosition) noexcept
+            : ring (ringToUse), size (sizeOfRing), pos (writePosition)
+        {
+        }
+
+        int getMaximumDelay() const noexcept                    { return size - 1; }
+
+        float read (int delayInSamples) const noexcept
+        {
+            auto index = pos - delayInSamples;
+            return Codec::decode (ring[index < 0 ? index + size : index]);
+        }
+
+        void push (float sample) noexcept
+        {
+            ring[pos] = Codec::encode (sample);
+            pos = pos + 1 == size ? 0 : pos + 1;
+        }
+
+        // Writes the numSamples samples that start delayInSamples ago into dest, or adds them if accumulate is true,
+        // times weight. numSamples must not exceed delayInSamples, so nothing is read that is not written yet.
+        void readSpan (int delayInSamples, float* dest, int numSamples, float weight, bool accumulate) const noexcept
+        {
+            jassert (numSamples <= delayInSamples);
+
+            auto start = pos - delayInSamples;
+            forEachSpan (start < 0 ? start + size : start, numSamples, [&] (int index, int offset, int length)
+            {
+                const auto* source = ring + index;
+                auto* target = dest + offset;
+
+                if (accumulate)
+                    for (int i = 0; i < length; ++i)
+                        target[i] += Codec::decode (source[i]) * weight;
+                else
+                    for (int i = 0; i < length; ++i)
+                        target[i] = Codec::decode (source[i]) * weight;
+            });
+        }
+
+        // Pushes a * gainA + b * gainB for numSamples samples
+        void writeMix (const float* a, float gainA, const float* b, float gainB, int numSamples) noexcept
+        {
+            forEachSpan (pos, numSamples, [&] (int index, int offset, int length)
+            {
+                auto* target = ring + index;
+
+                for (int i = 0; i < length; ++i)
+                    target[i] = Codec::encode (a[offset + i] * gainA + b[offset + i] * gainB);
+            });
+
+            advance (numSamples);
+        }
+
+        // Pushes numSamples samples unchanged
+        void write (const float* source, int numSamples) noexcept
+        {
+            forEachSpan (pos, numSamples, [&] (int index, int offset, int length)
+            {
+                auto* target = ring + index;
+
+                for (int i = 0; i < length; ++i)
+                    target[i] = Codec::encode (source[offset + i]);
+            });
+
+            advance (numSamples);
+        }
+
+    private:
+        // Splits [startIndex, startIndex + numSamples) of the ring into at most two contiguous spans
+        template <typename SpanFunction>
+        void forEachSpan (int startIndex, int numSamples, SpanFunction&& function) const
+        {
+            const int firstLength = juce::jmin (numSamples, size - startIndex);
+            function (startIndex, 0, firstLength);
+
+            if (firstLength < numSamples)
+                function (0, firstLength, numSamples - firstLength);
+        }
+
+        void advance (int numSamples) noexcept
+        {
+            pos += numSamples;
+
+            if (pos >= size)
+                pos -= size;
+        }
+
+        Stored* ring;
+        int size;
+        int& pos;
+    };
+
+    // Calls function with a Channel of the given channel, typed for the storage format
+    template <typename Function>
+    void withChannel (int channel, Function&& function)
+    {
+        switch (format)
+        {
+            case int16:     function (getChannel<Int16> (channel)); break;
+            case bfloat16:  function (getChannel<BFloat16> (channel)); break;
+            case float32:
+            default:        function (getChannel<Float32> (channel)); break;
+        }
+    }
+
+    template <typename Codec>
+    Channel<Codec> getChannel (int channel) noexcept
+    {
+        jassert (juce::isPositiveAndBelow (channel, channels));
+        auto* ring = reinterpret_cast<typename Codec::Stored*> (firstRing + channelStride * (size_t) channel);
+        return { ring, ringSize, writePos[(size_t) channel] };
+    }
+
+private:
+    //==============================================================================
+    static constexpr size_t cacheLine = 64;
+
+    static std::atomic<size_t>& getTotalCounter() noexcept
+    {
+        static std::atomic<size_t> total { 0 };
+        return total;
+    }
+
+    //==============================================================================
+    juce::HeapBlock<char> memory;
+    char* firstRing = nullptr;
+    size_t channelStride = 0;           // Bytes from one ring to the next, a whole number of cache lines
+    size_t sizeInBytes = 0;
+
+    std::vector<int> writePos;          // Next sample to write, per channel
+    Format format = float32;
+    int channels = 1;
+    int ringSize = 2;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayMemory)
+};
@@ -0,0 +1,231 @@
+/*******************************************************************************
+
+ name:             EnvelopeFollower
+ description:      per-channel envelope follower with peak, RMS and loudness
+                   detectors, usable as a sidechain source.
+
+ The envelope rises towards the detector's level with the attack coefficient
+ and falls back with the release coefficient. A time is how long the envelope
+ takes to cover 99% of a step. The coefficients are recomputed only when
+ setTimes() gets different times or prepare() a new sample rate. The pow()
+ calls they need would otherwise cost more than a small block of the follower
+ itself.
+
+ Every channel keeps its own envelope (and filter state) across blocks, so a
+ block boundary is inaudible and channels never leak into each other. The
+ detectors are:
+   peak      |x|, the classic analogue follower
+   rms       x^2 smoothed, then square-rooted, so it follows average power
+   loudness  like rms, but on a K-weighted signal (the ITU-R BS.1770 pre-filter
+             used for LUFS), so it follows perceived level. It is a running
+             measurement with the attack and release times, not a gated LUFS
+             reading.
+ All three return linear amplitude, so switching detectors keeps a sine of
+ the same level at about the same envelope.
+
+ process() writes the envelope of a channel, and the output may be the input
+ itself. Other pedals can feed it their input (or any other signal) and read
+ the envelope as a modulation source, either a sample at a time through
+ processSample() or a block at a time through getEnvelope().
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+class EnvelopeFollower
+{
+public:
+    // Values of the plugins' detector parameter
+    enum Detector
+    {
+        peak     = 0,
+        rms      = 1,
+        loudness = 2
+    };
+
+    //==============================================================================
+    // Allocates the per-channel state. Must be called from prepareToPlay.
+    void prepare (int numChannels, double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        states.assign ((size_t) juce::jmax (1, numChannels), {});
+
+        // The times stay, but their coefficients depend on the rate
+        attackCoefficient = getCoefficient (attackTime);
+        releaseCoefficient = getCoefficient (releaseTime);
+
+        prepareKWeighting();
+    }
+
+    // Clears the envelope and filter state of every channel
+    void reset() noexcept
+    {
+        std::fill (states.begin(), states.end(), ChannelState());
+    }
+
+    //==============================================================================
+    // Attack and release times in milliseconds. Cheap to call every block, the coefficients only change with the times.
+    void setTimes (float attackMs, float releaseMs) noexcept
+    {
+        if (attackMs != attackTime)
+        {
+            attackTime = attackMs;
+            attackCoefficient = getCoefficient (attackMs);
+        }
+
+        if (releaseMs != releaseTime)
+        {
+            releaseTime = releaseMs;
+            releaseCoefficient = getCoefficient (releaseMs);
+        }
+    }
+
+    // Called once per block. The envelope is kept, so switching detectors does not restart the follower.
+    void setDetector (int newDetector) noexcept
+    {
+        detector = (Detector) juce::jlimit ((int) peak, (int) loudness, newDetector);
+    }
+
+    Detector getDetector() const noexcept                       { return detector; }
+
+    // Latest envelope value of a channel, for callers that only need one value per block
+    float getEnvelope (int channel) const noexcept
+    {
+        const auto& state = states[(size_t) channel];
+        return detector == peak ? state.envelope : std::sqrt (state.envelope);
+    }
+
+    //==============================================================================
+    // Follows one sample of a channel and returns the envelope after it
+    float processSample (int channel, float input) noexcept
+    {
+        auto& state = states[(size_t) channel];
+
+        switch (detector)
+        {
+            case rms:       return std::sqrt (follow (state, square (input)));
+            case loudness:  return std::sqrt (follow (state, square (kWeight (state, input))));
+            case peak:
+            default:        return follow (state, std::abs (input));
+        }
+    }
+
+    // Writes the envelope of numSamples samples of a channel to output, which may be input itself
+    void process (int channel, const float* input, float* output, int numSamples) noexcept
+    {
+        switch (detector)
+        {
+            case rms:       processDetector<rms> (channel, input, output, numSamples); break;
+            case loudness:  processDetector<loudness> (channel, input, output, numSamples); break;
+            case peak:
+            default:        processDetector<peak> (channel, input, output, numSamples); break;
+        }
+    }
+
+private:
+    //==============================================================================
+    struct ChannelState
+    {
+        float envelope = 0.0f;                      // Peak level, or mean square for rms and loudness
+        double shelf1 = 0.0, shelf2 = 0.0;          // K-weighting filter state, transposed direct form II
+        double highPass1 = 0.0, highPass2 = 0.0;
+    };
+
+    struct Biquad
+    {
+        double b0 = 1.0, b1 = 0.0, b2 = 0.0, a1 = 0.0, a2 = 0.0;
+    };
+
+    // The detectors only differ in what they feed the one-pole follower, so the switch is taken once per block
+    template <Detector detectorType>
+    void processDetector (int channel, const float* input, float* output, int numSamples) noexcept
+    {
+        // A local copy, since output could alias the stored state and force a reload after every write
+        auto state = states[(size_t) channel];
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            if constexpr (detectorType == peak)
+                output[sample] = follow (state, std::abs (input[sample]));
+            else if constexpr (detectorType == rms)
+                output[sample] = std::sqrt (follow (state, square (input[sample])));
+            else
+                output[sample] = std::sqrt (follow (state, square (kWeight (state, input[sample]))));
+        }
+
+        // The envelope and filters decay exponentially, so they would otherwise end up denormal in silence
+        JUCE_SNAP_TO_ZERO (state.envelope);
+        JUCE_SNAP_TO_ZERO (state.shelf1);
+        JUCE_SNAP_TO_ZERO (state.shelf2);
+        JUCE_SNAP_TO_ZERO (state.highPass1);
+        JUCE_SNAP_TO_ZERO (state.highPass2);
+
+        states[(size_t) channel] = state;
+    }
+
+    float follow (ChannelState& state, float level) const noexcept
+    {
+        const auto coefficient = level > state.envelope ? attackCoefficient : releaseCoefficient;
+        state.envelope = coefficient * state.envelope + (1.0f - coefficient) * level;
+        return state.envelope;
+    }
+
+    float kWeight (ChannelState& state, float input) const noexcept
+    {
+        const auto shelved = runBiquad (shelf, state.shelf1, state.shelf2, (double) input);
+        return (float) runBiquad (highPass, state.highPass1, state.highPass2, shelved);
+    }
+
+    static double runBiquad (const Biquad& f, double& z1, double& z2, double x) noexcept
+    {
+        const auto y = f.b0 * x + z1;
+        z1 = f.b1 * x - f.a1 * y + z2;
+        z2 = f.b2 * x - f.a2 * y;
+        return y;
+    }
+
+    static float square (float x) noexcept                      { return x * x; }
+
+    // The original plugin's 0.01^(1 / samples): after that many samples 1% of a step is left. Zero times follow instantly.
+    float getCoefficient (float milliseconds) const noexcept
+    {
+        const auto samples = (double) milliseconds * 0.001 * sampleRate;
+        return samples > 0.0 ? (float) std::pow (0.01, 1.0 / samples) : 0.0f;
+    }
+
+    // The two stages of the BS.1770 K-weighting filter, a +4 dB high shelf and a 38 Hz high-pass, designed for
+    // the current rate with the analogue prototype's constants (the standard only tabulates 48 kHz coefficients)
+    void prepareKWeighting() noexcept
+    {
+        {
+            const auto k = std::tan (juce::MathConstants<double>::pi * 1681.974450955533 / sampleRate);
+            const auto q = 0.7071752369554196;
+            const auto vh = std::pow (10.0, 3.999843853973347 / 20.0);
+            const auto vb = std::pow (vh, 0.4996667741545416);
+            const auto a0 = 1.0 + k / q + k * k;
+
+            shelf = { (vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                      2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+        }
+
+        {
+            const auto k = std::tan (juce::MathConstants<double>::pi * 38.13547087602444 / sampleRate);
+            const auto q = 0.5003270373238773;
+            const auto a0 = 1.0 + k / q + k * k;
+
+            highPass = { 1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0 };
+        }
+    }
+
+    //==============================================================================
+    std::vector<ChannelState> states;
+    double sampleRate = 44100.0;
+    Detector detector = peak;
+
+    float attackTime = 0.0f, releaseTime = 0.0f;        // In milliseconds, the times the coefficients were computed for
+    float attackCoefficient = 0.0f, releaseCoefficient = 0.0f;
+
+    Biquad shelf, highPass;
+};
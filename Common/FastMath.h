@@ -0,0 +1,121 @@
+/*******************************************************************************
+
+ name:             FastMath
+ description:      branchless float approximations of atan, tanh, exp and log
+                   for per-sample loops.
+
+ The libm functions are opaque calls, so a loop that calls one per sample
+ cannot be vectorized. These are short polynomials with their range
+ reduction done through selects and integer bit manipulation instead of
+ branches or tables. Once inlined, a loop of them compiles to SSE or NEON like
+ any other arithmetic.
+
+ Errors measured against the double precision libm functions:
+   atan   absolute error below 2e-7 everywhere (A&S 4.4.49 polynomial, 2e-8 before rounding)
+   tanh   absolute error below 2e-7 everywhere
+   exp    relative error below 3e-7 for x in [-87.3, 88.3]. Below that the result
+          underflows to 0, above it saturates at FLT_MAX.
+   log    relative error below 2e-7 and absolute error below 2e-7 in [0.25, 4], for
+          positive normal arguments. Zero, negative and denormal arguments return
+          log (FLT_MIN), about -87.3.
+
+ That is a few float ulps, far below anything audible in a waveshaper, but
+ not bit-exact with libm, so plugins choose between the two with a parameter.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+namespace FastMath
+{
+    namespace detail
+    {
+        inline float fromBits (juce::int32 bits) noexcept              { float x; std::memcpy (&x, &bits, sizeof (x)); return x; }
+        inline juce::int32 toBits (float x) noexcept                   { juce::int32 bits; std::memcpy (&bits, &x, sizeof (bits)); return bits; }
+
+        // condition ? a : b as a bit mask. Conditions come from integer comparisons, since float comparisons can trap
+        // and the compiler will not vectorize a select on them unless trapping math is switched off.
+        inline float select (bool condition, float a, float b) noexcept
+        {
+            const juce::int32 mask = -(juce::int32) condition;
+            return fromBits ((toBits (a) & mask) | (toBits (b) & ~mask));
+        }
+
+        inline float copySign (float magnitude, juce::int32 signBits) noexcept
+        {
+            return fromBits ((toBits (magnitude) & 0x7fffffff) | (signBits & (juce::int32) 0x80000000));
+        }
+
+        constexpr juce::int32 oneBits = 0x3f800000;                     // 1.0f
+        constexpr juce::int32 minNormalBits = 0x00800000;               // FLT_MIN
+    }
+
+    //==============================================================================
+    inline float atan (float x) noexcept
+    {
+        // atan(x) = pi/2 - atan(1/x) folds every argument into [0, 1]
+        const juce::int32 bits = detail::toBits (x);
+        const juce::int32 absBits = bits & 0x7fffffff;
+        const bool inverted = absBits > detail::oneBits;
+
+        const float a = detail::fromBits (absBits);
+        const float z = detail::select (inverted, 1.0f / a, a);
+        const float z2 = z * z;
+
+        const float p = z * (1.0f + z2 * (-0.3333314528f + z2 * (0.1999355085f + z2 * (-0.1420889944f + z2 * (0.1065626393f
+                          + z2 * (-0.0752896400f + z2 * (0.0429096138f + z2 * (-0.0161657367f + z2 * 0.0028662257f))))))));
+
+        return detail::copySign (detail::select (inverted, juce::MathConstants<float>::halfPi - p, p), bits);
+    }
+
+    //==============================================================================
+    inline float exp (float x) noexcept
+    {
+        // e^x = 2^n * e^f with n the nearest integer to x / ln 2, so |f| <= ln 2 / 2. The bias keeps the
+        // truncating conversion rounding down over the whole usable range.
+        const int n = (int) (x * 1.44269504f + 126.5f) - 126;
+        const bool underflow = n < -126;
+        const bool overflow = n > 127;
+        const int clampedN = juce::jlimit (-126, 127, n);
+
+        // ln 2 in two parts, so n * ln2Hi is exact and f keeps its precision for large x
+        const float f = (x - (float) clampedN * 0.693359375f) + (float) clampedN * 2.12194440e-4f;
+
+        // Taylor series of e^f
+        const float p = 1.0f + f * (1.0f + f * (0.5f + f * (1.0f / 6.0f + f * (1.0f / 24.0f + f * (1.0f / 120.0f + f * (1.0f / 720.0f))))));
+        const float result = p * detail::fromBits ((clampedN + 127) << 23);
+
+        return detail::select (underflow, 0.0f, detail::select (overflow, std::numeric_limits<float>::max(), result));
+    }
+
+    //==============================================================================
+    inline float log (float x) noexcept
+    {
+        // Zero, negative and denormal arguments are treated as FLT_MIN. Negative floats have negative bits, so one
+        // integer comparison catches all of them.
+        const juce::int32 rawBits = detail::toBits (x);
+        const juce::int32 bits = rawBits < detail::minNormalBits ? detail::minNormalBits : rawBits;
+
+        // x = m * 2^e with m in [sqrt(1/2), sqrt(2)), so s = (m - 1) / (m + 1) stays within +-0.172
+        const juce::int32 e = (bits - 0x3f3504f3) >> 23;                // 0x3f3504f3 is sqrt(1/2)
+        const float m = detail::fromBits (bits - (e << 23));
+
+        const float s = (m - 1.0f) / (m + 1.0f);
+        const float s2 = s * s;
+        const float logM = 2.0f * s * (1.0f + s2 * (1.0f / 3.0f + s2 * (1.0f / 5.0f + s2 * (1.0f / 7.0f + s2 * (1.0f / 9.0f)))));
+
+        return (float) e * 0.693147181f + logM;
+    }
+
+    //==============================================================================
+    inline float tanh (float x) noexcept
+    {
+        // tanh(|x|) = (1 - e^-2|x|) / (1 + e^-2|x|), where the exponential only ever underflows
+        const juce::int32 bits = detail::toBits (x);
+        const float e = FastMath::exp (-2.0f * detail::fromBits (bits & 0x7fffffff));
+
+        return detail::copySign ((1.0f - e) / (1.0f + e), bits);
+    }
+}
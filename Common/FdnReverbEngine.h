@@ -0,0 +1,488 @@
+/*******************************************************************************
+
+ name:             FdnReverbEngine
+ description:      feedback delay network reverb with 4, 8 or 16 modulated,
+                   damped lines mixed by a Hadamard matrix.
+
+ Every line's output is damped, mixed with every other line's through a
+ Hadamard matrix and written back with the input. The matrix is orthogonal,
+ so the network neither grows nor loses energy by itself, and each of its
+ entries is +-1/sqrt(lines), so every line feeds every other one equally. The
+ echo density of the tail grows by the number of lines on every pass, where
+ a comb of Freeverb only ever feeds itself.
+
+ Each line has its own damping low-pass, set from its length so that high
+ frequencies die away at the same rate in every line. Its length is a
+ prime number of samples, and it is modulated by a quarter of a millisecond
+ at its own slow rate, which keeps resonances from building up in the tail.
+ Reads are linearly interpolated, which also darkens the tail a little,
+ like a touch of extra damping.
+
+ The shortest line is longer than a chunk of up to maxChunk samples, so
+ nothing a chunk writes is read back within it. The network therefore runs
+ in passes over the whole chunk, each line's samples in a row of their own:
+   read    each line's row from its ring, at a delay that moves in a
+           straight line to where the modulation is at the chunk's end
+   damp    the low-passes, all lines interleaved sample by sample
+   mix     a fast Walsh-Hadamard transform, log2(lines) rounds of sums and
+           differences between whole rows
+   write   each row back into its ring with the input
+ Apart from the damping, every pass is a plain loop over contiguous memory
+ that compiles to SIMD.
+
+ setParameters() and setQuality() follow FreeverbEngine: cheap to call every
+ block, and the decay only recomputed when they change. The quality picks 4,
+ 8 or 16 lines.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "SmoothedParameter.h"
+
+
+//==============================================================================
+class FdnReverbEngine
+{
+public:
+    // Values of the plugins' quality parameter
+    enum Quality
+    {
+        low    = 0,
+        medium = 1,
+        high   = 2
+    };
+
+    using Parameters = juce::Reverb::Parameters;
+
+    static constexpr int maxLines = 16;
+    static constexpr int maxChunk = 256;    // Shorter than the shortest line from 22.05 kHz up, less the modulation
+
+    //==============================================================================
+    // Allocates the lines for the sample rate and clears them, and jumps to the parameters last set.
+    // Must be called from prepareToPlay, never from the audio thread.
+    void prepare (double newSampleRate, int maximumBlockSize)
+    {
+        sampleRate = newSampleRate;
+
+        for (int q = low; q <= high; ++q)
+            prepareLayout (layouts[(size_t) q], getNumLines (q));
+
+        depth = (float) (modulationSeconds * sampleRate);
+
+        // Reads within a chunk must never reach the samples the chunk writes, which only limits very low rates further
+        const auto shortestRead = (int) ((float) layouts[low].length[0] - depth) - 2;
+        chunkSize = juce::jlimit (1, juce::jmin (maxChunk, shortestRead), maximumBlockSize);
+
+        // The lengths were rounded up to primes, so the longest line can be a few samples past maxLengthSeconds
+        int longest = 0;
+
+        for (int q = low; q <= high; ++q)
+            longest = juce::jmax (longest, layouts[(size_t) q].length[(size_t) getNumLines (q) - 1]);
+
+        ringSize = juce::nextPowerOfTwo (longest + (int) std::ceil (depth) + 2);
+        ringMask = ringSize - 1;
+
+        // Rings a power of two apart would all map to the same cache sets, since every line writes at the same index
+        lineStride = ringSize + 16;        // Also leaves room for each ring's guard sample
+        lines.assign ((size_t) (lineStride * maxLines), 0.0f);
+
+        chunkLines.assign ((size_t) (chunkSize * maxLines), 0.0f);
+        wetLeft.assign ((size_t) chunkSize, 0.0f);
+        wetRight.assign ((size_t) chunkSize, 0.0f);
+
+        dryGain.prepare (sampleRate, chunkSize, dryTarget, smoothingSeconds);
+        wetGain1.prepare (sampleRate, chunkSize, wet1Target, smoothingSeconds);
+        wetGain2.prepare (sampleRate, chunkSize, wet2Target, smoothingSeconds);
+
+        reset();
+        updateDecay();
+    }
+
+    // Clears the tail and restarts the modulation
+    void reset() noexcept
+    {
+        std::fill (lines.begin(), lines.end(), 0.0f);
+        writePos = 0;
+
+        const auto& layout = layouts[(size_t) quality];
+
+        for (int line = 0; line < maxLines; ++line)
+        {
+            modulationPhase[(size_t) line] = juce::MathConstants<float>::twoPi * (float) line / (float) maxLines;
+            delay[(size_t) line] = (float) layout.length[(size_t) line] + depth * std::sin (modulationPhase[(size_t) line]);
+            lowpass[(size_t) line] = 0.0f;
+        }
+    }
+
+    //==============================================================================
+    // Cheap to call every block: the decay is only recomputed when a parameter differs from the last call
+    void setParameters (const Parameters& newParameters) noexcept
+    {
+        if (newParameters.roomSize == parameters.roomSize && newParameters.damping == parameters.damping
+             && newParameters.wetLevel == parameters.wetLevel && newParameters.dryLevel == parameters.dryLevel
+             && newParameters.width == parameters.width && newParameters.freezeMode == parameters.freezeMode)
+            return;
+
+        parameters = newParameters;
+
+        // The same output gains as juce::Reverb, so switching algorithms keeps the mix
+        const auto wetLevel = parameters.wetLevel * 3.0f;
+        dryTarget = parameters.dryLevel * 2.0f;
+        wet1Target = 0.5f * wetLevel * (1.0f + parameters.width);
+        wet2Target = 0.5f * wetLevel * (1.0f - parameters.width);
+
+        frozen = parameters.freezeMode >= 0.5f;
+        updateDecay();
+    }
+
+    const Parameters& getParameters() const noexcept            { return parameters; }
+
+    // Takes effect at the next block. The line lengths change with the count, so the tail starts again from silence.
+    void setQuality (int newQuality) noexcept
+    {
+        newQuality = juce::jlimit ((int) low, (int) high, newQuality);
+
+        if (newQuality == quality)
+            return;
+
+        quality = newQuality;
+        reset();
+        updateDecay();
+    }
+
+    int getQuality() const noexcept                             { return quality; }
+    int getNumLines() const noexcept                            { return getNumLines (quality); }
+
+    //==============================================================================
+    void processMono (float* samples, int numSamples) noexcept
+    {
+        process (samples, nullptr, numSamples);
+    }
+
+    void processStereo (float* left, float* right, int numSamples) noexcept
+    {
+        process (left, right, numSamples);
+    }
+
+private:
+    //==============================================================================
+    // Line lengths in samples and modulation rates for one line count
+    struct Layout
+    {
+        std::array<int, maxLines> length {};
+        std::array<float, maxLines> modulationStep {};          // Radians per sample
+    };
+
+    static int getNumLines (int qualityToUse) noexcept          { return 4 << qualityToUse; }
+
+    static bool isPrime (int number) noexcept
+    {
+        for (int divisor = 2; divisor * divisor <= number; ++divisor)
+            if (number % divisor == 0)
+                return false;
+
+        return number > 1;
+    }
+
+    // Spreads the lengths geometrically between the shortest and longest, each rounded up to a prime
+    void prepareLayout (Layout& layout, int numLines) const
+    {
+        for (int line = 0; line < numLines; ++line)
+        {
+            const auto position = (double) line / (double) (numLines - 1);
+            auto length = juce::roundToInt (minLengthSeconds * std::pow (maxLengthSeconds / minLengthSeconds, position) * sampleRate);
+
+            while (! isPrime (length))
+                ++length;
+
+            const auto rate = minModulationHz * std::pow (maxModulationHz / minModulationHz, position);
+
+            layout.length[(size_t) line] = length;
+            layout.modulationStep[(size_t) line] = (float) (juce::MathConstants<double>::twoPi * rate / sampleRate);
+        }
+    }
+
+    // Sets each line's gain for a 60 dB decay over the reverb time, and its low-pass so that the highest
+    // frequencies decay over a shorter time set by the damping. Frozen, the lines keep everything.
+    void updateDecay() noexcept
+    {
+        const auto numLines = getNumLines (quality);
+        const auto& layout = layouts[(size_t) quality];
+
+        // Room size maps to 0.5 s to 10 s, about the range of juce::Reverb's feedback
+        const auto decaySeconds = 0.5 * std::pow (20.0, (double) parameters.roomSize);
+        const auto highDecaySeconds = decaySeconds * (1.0 - 0.9 * (double) parameters.damping);
+
+        for (int line = 0; line < maxLines; ++line)
+        {
+            if (frozen || line >= numLines)
+            {
+                feedback[(size_t) line] = line < numLines ? 1.0f : 0.0f;
+                damping[(size_t) line] = 0.0f;
+                continue;
+            }
+
+            const auto seconds = (double) layout.length[(size_t) line] / sampleRate;
+            const auto gain = std::pow (10.0, -3.0 * seconds / decaySeconds);
+            const auto highGain = std::pow (10.0, -3.0 * seconds / highDecaySeconds);
+
+            // A one-pole low-pass y = (1 - a) x + a y passes 1 at DC and (1 - a) / (1 + a) at Nyquist
+            const auto ratio = highGain / gain;
+            const auto coefficient = (1.0 - ratio) / (1.0 + ratio);
+
+            feedback[(size_t) line] = (float) (gain * (1.0 - coefficient));
+            damping[(size_t) line] = (float) coefficient;
+        }
+
+        // Each output sums half the lines, which are about uncorrelated
+        outputGain = outputLevel / std::sqrt ((float) numLines * 0.5f);
+        inputGain = frozen ? 0.0f : inputLevel;
+    }
+
+    //==============================================================================
+    void process (float* left, float* right, int numSamples) noexcept
+    {
+        for (int start = 0; start < numSamples; start += chunkSize)
+        {
+            const auto length = juce::jmin (chunkSize, numSamples - start);
+
+            dryGain.update (dryTarget, length);
+            wetGain1.update (wet1Target, length);
+            wetGain2.update (wet2Target, length);
+
+            auto* chunkRight = right != nullptr ? right + start : nullptr;
+
+            switch (quality)
+            {
+                case low:       processChunk<4>  (left + start, chunkRight, length); break;
+                case medium:    processChunk<8>  (left + start, chunkRight, length); break;
+                case high:
+                default:        processChunk<16> (left + start, chunkRight, length); break;
+            }
+        }
+    }
+
+    template <int numLines>
+    void processChunk (float* left, float* right, int numSamples) noexcept
+    {
+        static_assert (numLines <= maxLines && (numLines & (numLines - 1)) == 0, "The Hadamard transform needs a power of two");
+
+        auto* const chunk = chunkLines.data();      // A row of chunkSize samples per line
+
+        for (int line = 0; line < numLines; ++line)
+            readLine (line, chunk + line * chunkSize, numSamples);
+
+        // Damps and decays every line. Each low-pass waits on its last sample, so the lines are interleaved to keep the core busy.
+        {
+            float gain[numLines], coefficient[numLines], state[numLines];
+
+            for (int line = 0; line < numLines; ++line)
+            {
+                gain[line] = feedback[(size_t) line];
+                coefficient[line] = damping[(size_t) line];
+                state[line] = lowpass[(size_t) line];
+            }
+
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                for (int line = 0; line < numLines; ++line)
+                {
+                    auto& value = chunk[line * chunkSize + sample];
+                    state[line] = gain[line] * value + coefficient[line] * state[line];
+                    value = state[line];
+                }
+            }
+
+            for (int line = 0; line < numLines; ++line)
+                lowpass[(size_t) line] = state[line];
+        }
+
+        // Taps the outputs. Even lines are heard on the left and odd lines on the right.
+        std::fill (wetLeft.begin(), wetLeft.begin() + numSamples, 0.0f);
+        std::fill (wetRight.begin(), wetRight.begin() + numSamples, 0.0f);
+
+        for (int line = 0; line < numLines; ++line)
+        {
+            const auto* row = chunk + line * chunkSize;
+            auto* wet = (line & 1) == 0 ? wetLeft.data() : wetRight.data();
+            const auto tap = outputSigns[(size_t) line] * outputGain;
+
+            for (int sample = 0; sample < numSamples; ++sample)
+                wet[sample] += row[sample] * tap;
+        }
+
+        hadamard<numLines> (chunk, numSamples);
+
+        // Writes the lines back with the input, the left input into the even lines and the right input into the odd ones
+        const auto normalise = 1.0f / std::sqrt ((float) numLines);
+
+        for (int line = 0; line < numLines; ++line)
+        {
+            const auto* row = chunk + line * chunkSize;
+            const auto* input = (line & 1) != 0 && right != nullptr ? right : left;
+            const auto inputScale = inputGain * inputSigns[(size_t) line];
+            auto* lineRing = getRing (line);
+
+            forEachSpan (writePos, numSamples, [&] (int index, int offset, int length)
+            {
+                for (int i = 0; i < length; ++i)
+                    lineRing[index + i] = row[offset + i] * normalise + input[offset + i] * inputScale;
+            });
+
+            lineRing[-1] = lineRing[ringMask];
+        }
+
+        writePos = (writePos + numSamples) & ringMask;
+
+        if (right == nullptr)
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+                left[sample] = wetLeft[(size_t) sample] * wetGain1.getValue (sample) + left[sample] * dryGain.getValue (sample);
+
+            return;
+        }
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const auto dry = dryGain.getValue (sample);
+            const auto wet1 = wetGain1.getValue (sample);
+            const auto wet2 = wetGain2.getValue (sample);
+
+            left[sample] = wetLeft[(size_t) sample] * wet1 + wetRight[(size_t) sample] * wet2 + left[sample] * dry;
+            right[sample] = wetRight[(size_t) sample] * wet1 + wetLeft[(size_t) sample] * wet2 + right[sample] * dry;
+        }
+    }
+
+    // Reads numSamples samples of a line into row. The modulated delay is evaluated at the chunk's end and ramped
+    // to linearly, which a sine of about 1 Hz cannot tell apart from the sine over a few milliseconds. The ramp is so
+    // slow that the whole samples of the delay change at most once or twice in a chunk, so the chunk is read in spans
+    // of one whole delay, each a contiguous run of the ring.
+    void readLine (int line, float* row, int numSamples) noexcept
+    {
+        const auto& layout = layouts[(size_t) quality];
+        const auto* lineRing = getRing (line);
+
+        auto& phase = modulationPhase[(size_t) line];
+        phase += layout.modulationStep[(size_t) line] * (float) numSamples;
+
+        if (phase >= juce::MathConstants<float>::twoPi)
+            phase -= juce::MathConstants<float>::twoPi;
+
+        const auto startDelay = delay[(size_t) line];
+        const auto endDelay = (float) layout.length[(size_t) line] + depth * std::sin (phase);
+        const auto slope = (endDelay - startDelay) / (float) numSamples;
+
+        for (int sample = 0; sample < numSamples;)
+        {
+            const auto whole = (int) (startDelay + slope * (float) (sample + 1));
+
+            // The first sample whose delay has another whole part. Rounding may put it a sample out, which only
+            // stretches the interpolation a hair past its two points.
+            auto end = numSamples;
+
+            if (slope != 0.0f)
+            {
+                const auto crossing = ((float) (slope > 0.0f ? whole + 1 : whole) - startDelay) / slope - 1.0f;
+                end = (int) juce::jlimit ((float) sample + 1.0f, (float) numSamples, std::ceil (crossing));
+            }
+
+            const auto offsetDelay = startDelay - (float) whole;
+
+            forEachSpan ((writePos + sample - whole) & ringMask, end - sample, [&] (int index, int offset, int length)
+            {
+                const auto* source = lineRing + index;
+                const auto first = sample + offset;
+
+                // source[-1] is the guard sample before the ring when the span starts at its beginning
+                for (int i = 0; i < length; ++i)
+                {
+                    const auto fraction = offsetDelay + slope * (float) (first + i + 1);
+                    row[first + i] = source[i] + fraction * (source[i - 1] - source[i]);
+                }
+            });
+
+            sample = end;
+        }
+
+        delay[(size_t) line] = endDelay;
+    }
+
+    // A line's ring. The sample before it is a copy of its last sample, so a read of two neighbours never wraps.
+    float* getRing (int line) noexcept                          { return lines.data() + line * lineStride + 1; }
+
+    // Splits [startIndex, startIndex + numSamples) of a ring into at most two contiguous spans
+    template <typename SpanFunction>
+    void forEachSpan (int startIndex, int numSamples, SpanFunction&& function) const
+    {
+        const int firstLength = juce::jmin (numSamples, ringSize - startIndex);
+        function (startIndex, 0, firstLength);
+
+        if (firstLength < numSamples)
+            function (0, firstLength, numSamples - firstLength);
+    }
+
+    // Unnormalised fast Walsh-Hadamard transform of every sample's lines, in place. The rows of two lines are
+    // combined sample by sample, so every round is a run of SIMD sums and differences over contiguous memory.
+    template <int size, int half = 1>
+    void hadamard (float* chunk, int numSamples) noexcept
+    {
+        if constexpr (half < size)
+        {
+            for (int start = 0; start < size; start += half * 2)
+            {
+                for (int line = start; line < start + half; ++line)
+                {
+                    auto* a = chunk + line * chunkSize;
+                    auto* b = chunk + (line + half) * chunkSize;
+
+                    for (int sample = 0; sample < numSamples; ++sample)
+                    {
+                        const auto sum = a[sample] + b[sample];
+                        b[sample] = a[sample] - b[sample];
+                        a[sample] = sum;
+                    }
+                }
+            }
+
+            hadamard<size, half * 2> (chunk, numSamples);
+        }
+    }
+
+    //==============================================================================
+    static constexpr double minLengthSeconds = 0.019;
+    static constexpr double maxLengthSeconds = 0.057;
+    static constexpr double modulationSeconds = 0.00025;
+    static constexpr double minModulationHz = 0.3;
+    static constexpr double maxModulationHz = 1.1;
+    static constexpr double smoothingSeconds = 0.01;
+
+    // About the level of juce::Reverb for the same wet level
+    static constexpr float inputLevel = 0.165f;
+    static constexpr float outputLevel = 1.0f;
+
+    static constexpr std::array<float, maxLines> inputSigns  { 1, 1, -1, 1, 1, -1, -1, -1, 1, -1, 1, 1, -1, 1, -1, -1 };
+    static constexpr std::array<float, maxLines> outputSigns { 1, -1, 1, 1, -1, 1, 1, -1, -1, -1, 1, -1, 1, 1, -1, 1 };
+
+    double sampleRate = 44100.0;
+    std::array<Layout, 3> layouts;
+    float depth = 0.0f;                     // Modulation depth in samples
+
+    std::vector<float> lines;               // Every line's ring after its guard sample, lineStride samples apart
+    int ringSize = 0, ringMask = 0, lineStride = 0;
+    int writePos = 0;                       // Shared by every line
+
+    std::vector<float> chunkLines;          // The lines of the current chunk, a row of chunkSize samples per line
+    std::vector<float> wetLeft, wetRight;   // Reverb output of the current chunk
+    int chunkSize = 1;
+
+    std::array<float, maxLines> feedback {}, damping {}, lowpass {};
+    std::array<float, maxLines> modulationPhase {}, delay {};
+
+    Parameters parameters { -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f };    // Differs from any real parameters, so the first call applies them
+    SmoothedParameter dryGain, wetGain1, wetGain2;
+    float dryTarget = 0.0f, wet1Target = 0.0f, wet2Target = 0.0f;
+    float inputGain = 0.0f, outputGain = 0.0f;
+    bool frozen = false;
+    int quality = high;
+};
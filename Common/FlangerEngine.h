@@ -0,0 +1,397 @@
+/*******************************************************************************
+
+ name:             FlangerEngine
+ description:      flanger with a choice of fractional delay interpolation and
+                   a through-zero mode, read positions computed per block.
+
+ The wet tap sweeps delay * (1 + depth * lfo) around the delay parameter.
+ Additive and subtractive flanging mix it with the dry input. Through-zero
+ mixes it with a compensating tap fixed at the delay parameter instead, so
+ the swept tap passes through zero delay relative to it, and the notches
+ sweep all the way down. Every tap sits minimumDelay samples further back,
+ so even a sweep to zero never reads a sample that has not been written.
+
+ Each block runs in two passes. The first computes the read position of
+ every sample from the LFO and the smoothed delay and depth, and splits it
+ into a whole delay and a fraction. Nothing in it depends on the previous
+ sample, so it vectorizes. The second pass reads the ring, interpolates,
+ and writes the feedback sample. It stays serial, because with delays of a
+ few samples a read can depend on a sample written earlier in the block.
+
+ Interpolation is chosen per block:
+   linear     2 taps, cheapest, dulls the highs slightly at half-sample delays
+   lagrange3  4 taps, third-order Lagrange, flat to a few kHz higher
+   thiran     2 taps and a first-order all-pass, a flat magnitude response,
+              but recursive, so it rings briefly when the read position
+              jumps (the square LFO)
+ The dry tap of through-zero mode goes through the same interpolator, so
+ both taps have the same response and cancel exactly where they cross. It
+ reads a second ring that holds only the input, so with feedback the swept
+ tap is still compared against the plain delayed input. Every mode writes
+ that ring, so switching to through-zero never reads stale input.
+
+ beginBlock() updates what the channels share, then processChannel() runs
+ one channel. A channel has its own history, LFO and positions, so the
+ chain host can run the two channels of a stereo flanger on two threads.
+ process() does both for a whole buffer on the calling thread.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "DelayMemory.h"
+#include "LFOShapes.h"
+#include "SmoothedParameter.h"
+
+
+//==============================================================================
+class FlangerEngine
+{
+public:
+    // Values of the plugins' waveform parameter
+    enum Waveform
+    {
+        waveformOff = 0,
+        sine        = 1,
+        saw         = 2,
+        square      = 3
+    };
+
+    // Values of the plugins' mode parameter
+    enum Mode
+    {
+        modeOff     = 0,
+        additive    = 1,
+        subtractive = 2,
+        throughZero = 3
+    };
+
+    // Values of the plugins' interpolation parameter
+    enum Interpolation
+    {
+        linear    = 0,
+        lagrange3 = 1,
+        thiran    = 2
+    };
+
+    // Samples added to every tap, so the Lagrange taps either side of a zero delay are already written
+    static constexpr int minimumDelay = 2;
+
+    struct Parameters
+    {
+        float rate = 0.2f;      // LFO rate in Hz
+        float depth = 0.9f;     // 0 to 1, as a fraction of the delay
+        float delay = 0.003f;   // Seconds
+        float feedback = 0.1f;  // 0 to 1
+        float mix = 0.3f;       // 0 is dry, 1 is wet
+        int waveform = sine;
+        int mode = additive;
+        int interpolation = linear;
+    };
+
+    //==============================================================================
+    // Allocates the history and the per-block positions, and jumps to the parameters last set.
+    // Must be called from prepareToPlay, never from the audio thread.
+    void prepare (double newSampleRate, int maximumBlockSize, int numChannels, double maximumDelaySeconds)
+    {
+        sampleRate = newSampleRate;
+        maxDelaySeconds = (float) maximumDelaySeconds;
+        channels = juce::jlimit (1, (int) lfos.size(), numChannels);
+
+        // Depth 1 doubles the delay, and the Lagrange taps reach two samples past the position
+        history.prepare (channels, (int) std::ceil (2.0 * maximumDelaySeconds * sampleRate) + minimumDelay + 2);
+
+        // The through-zero dry tap stays at the delay parameter
+        inputHistory.prepare (channels, (int) std::ceil (maximumDelaySeconds * sampleRate) + minimumDelay + 2);
+
+        // Every channel has its own positions, so channels can be processed on different threads
+        blockCapacity = juce::jmax (1, maximumBlockSize);
+        const auto numPositions = (size_t) (channels * blockCapacity);
+        wetWhole.assign (numPositions, 0);
+        dryWhole.assign (numPositions, 0);
+        wetFraction.assign (numPositions, 0.0f);
+        dryFraction.assign (numPositions, 0.0f);
+
+        for (auto& lfo : lfos)
+            lfo.prepare (sampleRate);
+
+        depth.prepare (sampleRate, blockCapacity, parameters.depth);
+        delay.prepare (sampleRate, blockCapacity, getDelay());
+        feedback.prepare (sampleRate, blockCapacity, parameters.feedback);
+        mix.prepare (sampleRate, blockCapacity, parameters.mix);
+
+        reset();
+    }
+
+    // Clears the history and the all-pass states and restarts the LFOs
+    void reset() noexcept
+    {
+        history.reset();
+        inputHistory.reset();
+
+        for (auto& lfo : lfos)
+            lfo.reset();
+
+        wetStates.fill (0.0f);
+        dryStates.fill (0.0f);
+    }
+
+    //==============================================================================
+    // Takes effect from the next block. Depth, delay, feedback and mix glide to their new values.
+    void setParameters (const Parameters& newParameters) noexcept
+    {
+        parameters = newParameters;
+    }
+
+    const Parameters& getParameters() const noexcept            { return parameters; }
+
+    // True when the waveform or mode is off, and process() leaves the signal untouched
+    bool isPassThrough() const noexcept
+    {
+        return selectPositionKernel (parameters.waveform) == nullptr || selectReadKernel (parameters.mode, parameters.interpolation) == nullptr;
+    }
+
+    int getMaximumBlockSize() const noexcept                    { return blockCapacity; }
+
+    //==============================================================================
+    // Updates the smoothers and the LFO rate for a block of at most getMaximumBlockSize() samples and picks its kernels.
+    // Returns false if the block passes through, in which case processChannel() must not be called.
+    bool beginBlock (int numSamples) noexcept
+    {
+        jassert (numSamples <= blockCapacity);
+
+        positionKernel = selectPositionKernel (parameters.waveform);
+        readKernel = selectReadKernel (parameters.mode, parameters.interpolation);
+
+        if (positionKernel == nullptr || readKernel == nullptr) // Pass-Through
+            return false;
+
+        for (auto& lfo : lfos)
+            lfo.setFrequency (parameters.rate);
+
+        depth.update (parameters.depth, numSamples);
+        delay.update (getDelay(), numSamples);
+        feedback.update (parameters.feedback, numSamples);
+        mix.update (parameters.mix, numSamples);
+        return true;
+    }
+
+    // Processes one channel of the block begun last, in place. A channel only touches its own history, LFO and
+    // positions, so different channels can run on different threads at the same time. Channels beyond the prepared count are left dry.
+    void processChannel (int channel, float* samples, int numSamples) noexcept
+    {
+        if (channel >= channels)
+            return;
+
+        (this->*positionKernel) (channel, numSamples);
+        (this->*readKernel) (channel, samples, numSamples);
+    }
+
+    // Processes the first numChannels channels in place, in chunks of at most getMaximumBlockSize() samples
+    void process (float* const* channelData, int numChannels, int numSamples) noexcept
+    {
+        for (int done = 0; done < numSamples;)
+        {
+            const int length = juce::jmin (numSamples - done, blockCapacity);
+
+            if (! beginBlock (length))
+                return;
+
+            for (int channel = 0; channel < numChannels; ++channel)
+                processChannel (channel, channelData[channel] + done, length);
+
+            done += length;
+        }
+    }
+
+private:
+    //==============================================================================
+    struct Additive     { static constexpr float wetSign = 1.0f;  static constexpr bool throughZero = false; };
+    struct Subtractive  { static constexpr float wetSign = -1.0f; static constexpr bool throughZero = false; };
+    struct ThroughZero  { static constexpr float wetSign = 1.0f;  static constexpr bool throughZero = true;  };
+
+    // Each interpolator reads the sample delay + fraction samples ago, where delay 1 is the latest sample written.
+    // previous is the tap's last output: Thiran's state, kept up to date by the others so switching to it does not jump.
+    struct Linear
+    {
+        template <typename Ring>
+        static float read (const Ring& ring, int delay, float fraction, float& previous) noexcept
+        {
+            const auto newer = ring.read (delay);
+            return previous = newer + fraction * (ring.read (delay + 1) - newer);
+        }
+    };
+
+    struct Lagrange3
+    {
+        template <typename Ring>
+        static float read (const Ring& ring, int delay, float fraction, float& previous) noexcept
+        {
+            // The polynomial through the taps at delay - 1 to delay + 2, in Horner form, which takes fewer operations than the four weights
+            const auto xm1 = ring.read (delay - 1), x0 = ring.read (delay), x1 = ring.read (delay + 1), x2 = ring.read (delay + 2);
+            const auto c1 = x1 - xm1 * (1.0f / 3.0f) - x0 * 0.5f - x2 * (1.0f / 6.0f);
+            const auto c2 = 0.5f * (xm1 + x1) - x0;
+            const auto c3 = (x2 - xm1) * (1.0f / 6.0f) + 0.5f * (x0 - x1);
+
+            return previous = ((c3 * fraction + c2) * fraction + c1) * fraction + x0;
+        }
+    };
+
+    struct Thiran
+    {
+        template <typename Ring>
+        static float read (const Ring& ring, int delay, float fraction, float& previous) noexcept
+        {
+            // Fractions below 0.618 are taken a sample further back, so the coefficient stays away from 1
+            // where the all-pass would ring for a long time (the same rule as juce::dsp::DelayLine)
+            if (fraction < 0.618f)
+            {
+                fraction += 1.0f;
+                --delay;
+            }
+
+            const auto alpha = (1.0f - fraction) / (1.0f + fraction);
+            return previous = ring.read (delay + 1) + alpha * (ring.read (delay) - previous);
+        }
+    };
+
+    using PositionKernel = void (FlangerEngine::*) (int, int);
+    using ReadKernel = void (FlangerEngine::*) (int, float*, int);
+
+    //==============================================================================
+    float getDelay() const noexcept                             { return juce::jlimit (0.0f, maxDelaySeconds, parameters.delay); }
+
+    // First pass: the wet and dry read positions of every sample of the chunk, with the LFO shape fixed at compile time
+    template <typename Shape>
+    void computePositions (int channel, int numSamples) noexcept
+    {
+        if (depth.isSmoothing() || delay.isSmoothing())
+            computePositions<Shape, true> (channel, numSamples);
+        else
+            computePositions<Shape, false> (channel, numSamples);
+    }
+
+    template <typename Shape, bool isRamping>
+    void computePositions (int channel, int numSamples) noexcept
+    {
+        auto& lfo = lfos[(size_t) channel];
+        const auto samplesPerSecond = (float) sampleRate;
+        const auto offset = (size_t) (channel * blockCapacity);
+        auto* wetWholes = wetWhole.data() + offset;
+        auto* wetFractions = wetFraction.data() + offset;
+        auto* dryWholes = dryWhole.data() + offset;
+        auto* dryFractions = dryFraction.data() + offset;
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const auto centre = delay.get<isRamping> (sample) * samplesPerSecond;
+            const auto wet = (float) minimumDelay + centre + centre * depth.get<isRamping> (sample) * Shape::value (lfo.phaseAt (sample));
+            const auto dry = (float) minimumDelay + centre;
+
+            // Positions are never negative, so truncation is the floor
+            wetWholes[sample] = (int) wet;
+            wetFractions[sample] = wet - (float) (int) wet;
+            dryWholes[sample] = (int) dry;
+            dryFractions[sample] = dry - (float) (int) dry;
+        }
+
+        lfo.advance (numSamples);
+    }
+
+    // Second pass: reads the taps, writes the feedback and mixes, with polarity and interpolation fixed at compile time
+    template <typename Polarity, typename Interpolator>
+    void readTaps (int channel, float* samples, int numSamples) noexcept
+    {
+        if (feedback.isSmoothing() || mix.isSmoothing())
+            readTaps<Polarity, Interpolator, true> (channel, samples, numSamples);
+        else
+            readTaps<Polarity, Interpolator, false> (channel, samples, numSamples);
+    }
+
+    template <typename Polarity, typename Interpolator, bool isRamping>
+    void readTaps (int channel, float* samples, int numSamples) noexcept
+    {
+        auto ring = history.getChannel<DelayMemory::Float32> (channel);
+        auto inputRing = inputHistory.getChannel<DelayMemory::Float32> (channel);
+        auto& wetState = wetStates[(size_t) channel];
+        auto& dryState = dryStates[(size_t) channel];
+        const auto offset = (size_t) (channel * blockCapacity);
+        const auto* wetWholes = wetWhole.data() + offset;
+        const auto* wetFractions = wetFraction.data() + offset;
+        const auto* dryWholes = dryWhole.data() + offset;
+        const auto* dryFractions = dryFraction.data() + offset;
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const auto feedbackValue = feedback.get<isRamping> (sample);
+            const auto mixValue = mix.get<isRamping> (sample);
+            const auto input = samples[sample];
+
+            const auto wet = Interpolator::read (ring, wetWholes[sample], wetFractions[sample], wetState);
+            const auto dry = Polarity::throughZero ? Interpolator::read (inputRing, dryWholes[sample], dryFractions[sample], dryState)
+                                                   : input;
+
+            ring.push (input * (1.0f - feedbackValue) + wet * feedbackValue);
+            inputRing.push (input);
+            samples[sample] = dry * (1.0f - mixValue) + Polarity::wetSign * (wet * mixValue);
+        }
+    }
+
+    // Returns the position kernel for the waveform parameter, or nullptr for Pass-Through
+    static PositionKernel selectPositionKernel (int waveformIndex) noexcept
+    {
+        static constexpr PositionKernel kernels[4] =
+        {
+            nullptr,
+            &FlangerEngine::computePositions<LFOShape::Sine>,
+            &FlangerEngine::computePositions<LFOShape::Saw>,
+            &FlangerEngine::computePositions<LFOShape::Square>
+        };
+
+        return kernels[juce::jlimit (0, 3, waveformIndex)];
+    }
+
+    // Returns the read kernel for the mode and interpolation parameters, or nullptr for Pass-Through
+    static ReadKernel selectReadKernel (int modeIndex, int interpolationIndex) noexcept
+    {
+        static constexpr ReadKernel kernels[4][3] =
+        {
+            { nullptr, nullptr, nullptr }, // Pass-Through
+            { &FlangerEngine::readTaps<Additive, Linear>,
+              &FlangerEngine::readTaps<Additive, Lagrange3>,
+              &FlangerEngine::readTaps<Additive, Thiran> },
+            { &FlangerEngine::readTaps<Subtractive, Linear>,
+              &FlangerEngine::readTaps<Subtractive, Lagrange3>,
+              &FlangerEngine::readTaps<Subtractive, Thiran> },
+            { &FlangerEngine::readTaps<ThroughZero, Linear>,
+              &FlangerEngine::readTaps<ThroughZero, Lagrange3>,
+              &FlangerEngine::readTaps<ThroughZero, Thiran> }
+        };
+
+        return kernels[juce::jlimit (0, 3, modeIndex)][juce::jlimit (0, 2, interpolationIndex)];
+    }
+
+    //==============================================================================
+    Parameters parameters;
+    double sampleRate = 44100.0;
+    float maxDelaySeconds = 0.01f;
+    int channels = 1;
+
+    DelayMemory history;                                // Input and feedback, read by the swept tap
+    DelayMemory inputHistory;                           // Input only, read by the through-zero dry tap
+    std::array<LFOPhase, 2> lfos;                       // One LFO per channel
+    std::array<float, 2> wetStates {}, dryStates {};    // Last output of each tap, per channel
+
+    // Read positions of the current block, split into whole samples and a fraction, blockCapacity per channel
+    std::vector<int> wetWhole, dryWhole;
+    std::vector<float> wetFraction, dryFraction;
+    int blockCapacity = 1;
+
+    PositionKernel positionKernel = nullptr;            // Chosen by beginBlock() for the block
+    ReadKernel readKernel = nullptr;
+
+    SmoothedParameter depth, delay, feedback, mix;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FlangerEngine)
+};
@@ -0,0 +1,377 @@
+/*******************************************************************************
+
+ name:             FreeverbEngine
+ description:      the comb and all-pass reverb of juce::Reverb, with parameter
+                   updates that cost nothing while the knobs stand still and a
+                   quality setting that trades density for CPU.
+
+ A plugin that sets juce::Reverb's parameters once in prepareToPlay ignores
+ its knobs until it is prepared again. setParameters() here is meant to be
+ called every block: it compares the new parameters with the ones it has and
+ returns at once if nothing changed. Changes glide to their new values over
+ 10 ms as in juce::Reverb, but once the glide has finished the block loops
+ use them as constants instead of stepping five smoothers on every sample.
+
+ The tunings, gains and filters are those of juce::Reverb, so at high quality
+ the output is the same. The quality setting picks how many filters run:
+   low     4 combs and 2 all-passes per channel, about half the CPU
+   medium  6 combs and 3 all-passes
+   high    8 combs and 4 all-passes, as juce::Reverb
+ The input gain makes up for the filters left out, so the tail keeps its
+ level, and glides to its new value like the other gains. Fewer combs give
+ a sparser, more metallic tail.
+
+ The combs of a channel run over the whole block four at a time. A comb has
+ to wait for its own last sample, so four independent ones keep the core busy
+ while each waits, and every sample they touch is read and written in order.
+ The all-passes then run over the summed block one after the other.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "SmoothedParameter.h"
+
+
+//==============================================================================
+class FreeverbEngine
+{
+public:
+    // Values of the plugins' quality parameter
+    enum Quality
+    {
+        low    = 0,
+        medium = 1,
+        high   = 2
+    };
+
+    using Parameters = juce::Reverb::Parameters;
+
+    static constexpr int numCombs = 8;
+    static constexpr int numAllPasses = 4;
+
+    //==============================================================================
+    // Sizes the filters for the sample rate and clears them, and jumps to the parameters last set.
+    // Must be called from prepareToPlay, never from the audio thread.
+    void prepare (double sampleRate, int maximumBlockSize)
+    {
+        static constexpr int combTunings[numCombs] = { 1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617 }; // At 44.1 kHz
+        static constexpr int allPassTunings[numAllPasses] = { 556, 441, 341, 225 };
+        static constexpr int stereoSpread = 23;
+
+        const auto intSampleRate = (int) sampleRate;
+
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            const auto spread = channel * stereoSpread;
+
+            for (int i = 0; i < numCombs; ++i)
+                combs[(size_t) channel][(size_t) i].setSize (intSampleRate * (combTunings[i] + spread) / 44100);
+
+            for (int i = 0; i < numAllPasses; ++i)
+                allPasses[(size_t) channel][(size_t) i].setSize (intSampleRate * (allPassTunings[i] + spread) / 44100);
+        }
+
+        const auto chunkSize = juce::jmax (1, maximumBlockSize);
+        input.assign ((size_t) chunkSize, 0.0f);
+        wet[0].assign ((size_t) chunkSize, 0.0f);
+        wet[1].assign ((size_t) chunkSize, 0.0f);
+
+        damping.prepare (sampleRate, chunkSize, dampingTarget, smoothingSeconds);
+        feedback.prepare (sampleRate, chunkSize, feedbackTarget, smoothingSeconds);
+        dryGain.prepare (sampleRate, chunkSize, dryTarget, smoothingSeconds);
+        wetGain1.prepare (sampleRate, chunkSize, wet1Target, smoothingSeconds);
+        wetGain2.prepare (sampleRate, chunkSize, wet2Target, smoothingSeconds);
+        inputGain.prepare (sampleRate, chunkSize, inputTarget, smoothingSeconds);
+    }
+
+    // Clears the tail
+    void reset() noexcept
+    {
+        for (auto& channel : combs)
+            for (auto& comb : channel)
+                comb.clear();
+
+        for (auto& channel : allPasses)
+            for (auto& allPass : channel)
+                allPass.clear();
+    }
+
+    //==============================================================================
+    // Cheap to call every block: the gains are only recomputed when a parameter differs from the last call
+    void setParameters (const Parameters& newParameters) noexcept
+    {
+        if (newParameters.roomSize == parameters.roomSize && newParameters.damping == parameters.damping
+             && newParameters.wetLevel == parameters.wetLevel && newParameters.dryLevel == parameters.dryLevel
+             && newParameters.width == parameters.width && newParameters.freezeMode == parameters.freezeMode)
+            return;
+
+        parameters = newParameters;
+
+        const auto wetLevel = parameters.wetLevel * 3.0f;
+        dryTarget = parameters.dryLevel * 2.0f;
+        wet1Target = 0.5f * wetLevel * (1.0f + parameters.width);
+        wet2Target = 0.5f * wetLevel * (1.0f - parameters.width);
+
+        // Frozen, the combs keep what they hold forever and take no more input
+        frozen = parameters.freezeMode >= 0.5f;
+        dampingTarget = frozen ? 0.0f : parameters.damping * 0.4f;
+        feedbackTarget = frozen ? 1.0f : parameters.roomSize * 0.28f + 0.7f;
+
+        updateInputGain();
+    }
+
+    const Parameters& getParameters() const noexcept            { return parameters; }
+
+    // Takes effect at the next block. Filters that come back into use start from silence.
+    void setQuality (int newQuality) noexcept
+    {
+        newQuality = juce::jlimit ((int) low, (int) high, newQuality);
+
+        if (newQuality == quality)
+            return;
+
+        const auto returningCombs = getCombMask (newQuality) & ~getCombMask (quality);
+
+        for (int index = 0; index < numCombs; ++index)
+            if ((returningCombs >> index) & 1)
+                for (auto& channel : combs)
+                    channel[(size_t) index].clear();
+
+        for (int index = getNumAllPasses (quality); index < getNumAllPasses (newQuality); ++index)
+            for (auto& channel : allPasses)
+                channel[(size_t) index].clear();
+
+        quality = newQuality;
+        updateInputGain();
+    }
+
+    int getQuality() const noexcept                             { return quality; }
+
+    //==============================================================================
+    void processMono (float* samples, int numSamples) noexcept
+    {
+        process (samples, nullptr, numSamples);
+    }
+
+    void processStereo (float* left, float* right, int numSamples) noexcept
+    {
+        process (left, right, numSamples);
+    }
+
+private:
+    //==============================================================================
+    struct CombFilter
+    {
+        void setSize (int size)
+        {
+            buffer.assign ((size_t) juce::jmax (1, size), 0.0f);
+            clear();
+        }
+
+        void clear() noexcept
+        {
+            std::fill (buffer.begin(), buffer.end(), 0.0f);
+            index = 0;
+            last = 0.0f;
+        }
+
+        std::vector<float> buffer;
+        int index = 0;
+        float last = 0.0f;      // State of the damping low-pass
+    };
+
+    struct AllPassFilter
+    {
+        void setSize (int size)
+        {
+            buffer.assign ((size_t) juce::jmax (1, size), 0.0f);
+            clear();
+        }
+
+        void clear() noexcept
+        {
+            std::fill (buffer.begin(), buffer.end(), 0.0f);
+            index = 0;
+        }
+
+        // Runs the all-pass over a block in place
+        void process (float* samples, int numSamples) noexcept
+        {
+            const auto size = (int) buffer.size();
+            auto* data = buffer.data();
+
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                const auto buffered = data[index];
+
+                data[index] = samples[sample] + (buffered * 0.5f);
+                index = index + 1 == size ? 0 : index + 1;
+
+                samples[sample] = buffered - samples[sample];
+            }
+        }
+
+        std::vector<float> buffer;
+        int index = 0;
+    };
+
+    //==============================================================================
+    // Bit i is set if comb i runs at the quality. Low uses every other comb, so the delays stay spread out.
+    static int getCombMask (int qualityToUse) noexcept
+    {
+        return qualityToUse == low ? 0x55 : (qualityToUse == medium ? 0x77 : 0xff);
+    }
+
+    static int getNumCombs (int qualityToUse) noexcept          { return qualityToUse * 2 + 4; }
+    static int getNumAllPasses (int qualityToUse) noexcept      { return qualityToUse + 2; }
+
+    void updateInputGain() noexcept
+    {
+        // Freeverb's all-passes are not quite all-pass: each one raises white noise by sqrt (7 / 3), so the ones left out are made up for too
+        const auto allPassGain = std::pow (std::sqrt (7.0f / 3.0f), (float) (numAllPasses - getNumAllPasses (quality)));
+        inputTarget = frozen ? 0.0f : 0.015f * std::sqrt ((float) numCombs / (float) getNumCombs (quality)) * allPassGain;
+    }
+
+    //==============================================================================
+    // Runs numInGroup combs side by side over a block and adds their outputs to out, in comb order. Each comb is a
+    // recursion that has to wait for its last sample, so running several at once keeps the core busy while it waits.
+    template <int numInGroup, bool isRamping>
+    void processCombs (CombFilter* const* group, const float* in, float* out, int numSamples) noexcept
+    {
+        float* data[numInGroup];
+        int size[numInGroup], index[numInGroup];
+        float last[numInGroup];
+
+        for (int c = 0; c < numInGroup; ++c)
+        {
+            data[c] = group[c]->buffer.data();
+            size[c] = (int) group[c]->buffer.size();
+            index[c] = group[c]->index;
+            last[c] = group[c]->last;
+        }
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const auto damp = damping.get<isRamping> (sample);
+            const auto feedbackLevel = feedback.get<isRamping> (sample);
+            auto sum = out[sample];
+
+            for (int c = 0; c < numInGroup; ++c)
+            {
+                const auto output = data[c][index[c]];
+
+                last[c] = (output * (1.0f - damp)) + (last[c] * damp);
+                data[c][index[c]] = in[sample] + (last[c] * feedbackLevel);
+                index[c] = index[c] + 1 == size[c] ? 0 : index[c] + 1;
+
+                sum += output;
+            }
+
+            out[sample] = sum;
+        }
+
+        for (int c = 0; c < numInGroup; ++c)
+        {
+            group[c]->index = index[c];
+            group[c]->last = last[c];
+        }
+    }
+
+    //==============================================================================
+    void process (float* left, float* right, int numSamples) noexcept
+    {
+        const auto chunkSize = (int) input.size();
+
+        for (int start = 0; start < numSamples; start += chunkSize)
+        {
+            const auto length = juce::jmin (chunkSize, numSamples - start);
+
+            damping.update (dampingTarget, length);
+            feedback.update (feedbackTarget, length);
+            dryGain.update (dryTarget, length);
+            wetGain1.update (wet1Target, length);
+            wetGain2.update (wet2Target, length);
+            inputGain.update (inputTarget, length);
+
+            if (damping.isSmoothing() || feedback.isSmoothing())
+                processChunk<true> (left + start, right != nullptr ? right + start : nullptr, length);
+            else
+                processChunk<false> (left + start, right != nullptr ? right + start : nullptr, length);
+        }
+    }
+
+    template <bool isRamping>
+    void processChunk (float* left, float* right, int numSamples) noexcept
+    {
+        const auto numChannels = right != nullptr ? 2 : 1;
+
+        // Both channels' combs are fed the sum of the inputs
+        for (int sample = 0; sample < numSamples; ++sample)
+            input[(size_t) sample] = right != nullptr ? left[sample] + right[sample] : left[sample];
+
+        inputGain.applyGain (input.data(), numSamples);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            auto* out = wet[(size_t) channel].data();
+            std::fill (out, out + numSamples, 0.0f);
+
+            CombFilter* active[numCombs];
+            int numActive = 0;
+
+            for (int index = 0; index < numCombs; ++index)
+                if ((getCombMask (quality) >> index) & 1)
+                    active[numActive++] = &combs[(size_t) channel][(size_t) index];
+
+            // Four at a time, then the two medium quality has left
+            for (int first = 0; first < numActive; first += 4)
+            {
+                if (numActive - first >= 4)
+                    processCombs<4, isRamping> (active + first, input.data(), out, numSamples);
+                else
+                    processCombs<2, isRamping> (active + first, input.data(), out, numSamples);
+            }
+
+            for (int index = 0; index < getNumAllPasses (quality); ++index)
+                allPasses[(size_t) channel][(size_t) index].process (out, numSamples);
+        }
+
+        const auto* wetLeft = wet[0].data();
+
+        if (right == nullptr)
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+                left[sample] = wetLeft[sample] * wetGain1.getValue (sample) + left[sample] * dryGain.getValue (sample);
+
+            return;
+        }
+
+        const auto* wetRight = wet[1].data();
+
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const auto dry = dryGain.getValue (sample);
+            const auto wet1 = wetGain1.getValue (sample);
+            const auto wet2 = wetGain2.getValue (sample);
+
+            left[sample] = wetLeft[sample] * wet1 + wetRight[sample] * wet2 + left[sample] * dry;
+            right[sample] = wetRight[sample] * wet1 + wetLeft[sample] * wet2 + right[sample] * dry;
+        }
+    }
+
+    //==============================================================================
+    static constexpr double smoothingSeconds = 0.01;
+
+    std::array<std::array<CombFilter, numCombs>, 2> combs;
+    std::array<std::array<AllPassFilter, numAllPasses>, 2> allPasses;
+
+    std::vector<float> input;                   // Comb input of the current chunk
+    std::array<std::vector<float>, 2> wet;      // Reverb output of each channel for the current chunk
+
+    Parameters parameters { -1.0f, -1.0f, -1.0f, -1.0f, -1.0f, -1.0f };    // Differs from any real parameters, so the first call applies them
+    SmoothedParameter damping, feedback, dryGain, wetGain1, wetGain2, inputGain;
+    float dampingTarget = 0.0f, feedbackTarget = 0.0f, dryTarget = 0.0f, wet1Target = 0.0f, wet2Target = 0.0f, inputTarget = 0.0f;
+    bool frozen = false;
+    int quality = high;
+};
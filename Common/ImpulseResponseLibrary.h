@@ -0,0 +1,154 @@
+/*******************************************************************************
+
+ name:             ImpulseResponseLibrary
+ description:      the impulse responses a convolution plugin can choose
+                   from: a built-in cab and the WAV files of a folder.
+
+ Index 0 is a built-in cab response, 200 ms long, so the plugin does
+ something before any file is installed. Indices 1 to maxFiles are the .wav
+ files in ~/IRs, sorted by name and listed once, when the library is created.
+ The list always has maxFiles + 1 names, so the plugin's choice parameter has
+ the same range on every machine, and an index without a file loads the
+ built-in response.
+
+ Files are opened with a memory-mapped reader. Loading one maps it and
+ converts only the samples and channels used, instead of reading the whole
+ file through a stream. A file at another sample rate is resampled with
+ Lagrange interpolation. Every response is scaled to unit energy, so
+ switching between them keeps the level about the same.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+class ImpulseResponseLibrary
+{
+public:
+    static constexpr int maxFiles = 16;
+    static constexpr double builtInSeconds = 0.2;
+
+    explicit ImpulseResponseLibrary (const juce::File& folder = getDefaultFolder())
+    {
+        if (folder.isDirectory())
+        {
+            files = folder.findChildFiles (juce::File::findFiles, false, "*.wav;*.WAV");
+            files.sort();
+            files.removeRange (maxFiles, files.size());
+        }
+    }
+
+    static juce::File getDefaultFolder()
+    {
+        return juce::File::getSpecialLocation (juce::File::userHomeDirectory).getChildFile ("IRs");
+    }
+
+    // "Built-in", then the name of the file at each index, or a placeholder where there is none
+    juce::StringArray getNames() const
+    {
+        juce::StringArray names { "Built-in" };
+
+        for (int index = 1; index <= maxFiles; ++index)
+            names.add (index <= files.size() ? files[index - 1].getFileNameWithoutExtension() : "IR " + juce::String (index));
+
+        return names;
+    }
+
+    //==============================================================================
+    // Fills destination with response number index at sampleRate, at most maxSeconds long.
+    // Falls back to the built-in response if there is no such file or it cannot be read. Allocates.
+    void load (int index, double sampleRate, juce::AudioBuffer<float>& destination, double maxSeconds) const
+    {
+        const bool hasFile = index > 0 && index <= files.size();
+
+        if (! (hasFile && loadFile (files[index - 1], sampleRate, destination, maxSeconds)))
+            makeBuiltIn (sampleRate, destination);
+
+        normalise (destination);
+    }
+
+private:
+    //==============================================================================
+    static bool loadFile (const juce::File& file, double sampleRate, juce::AudioBuffer<float>& destination, double maxSeconds)
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::MemoryMappedAudioFormatReader> reader (wav.createMemoryMappedReader (file));
+
+        if (reader == nullptr || reader->sampleRate <= 0 || reader->lengthInSamples <= 0 || ! reader->mapEntireFile())
+            return false;
+
+        // Only the samples that end up within maxSeconds are converted, plus a few for the interpolator
+        const auto ratio = reader->sampleRate / sampleRate;
+        const auto sourceLength = (int) juce::jmin (reader->lengthInSamples, (juce::int64) (maxSeconds * reader->sampleRate) + 4);
+        const auto numChannels = juce::jmin (2, (int) reader->numChannels);
+
+        juce::AudioBuffer<float> source (numChannels, sourceLength);
+
+        if (! reader->read (&source, 0, sourceLength, 0, true, true))
+            return false;
+
+        if (ratio == 1.0)
+        {
+            destination.makeCopyOf (source);
+            return true;
+        }
+
+        const auto length = juce::jmax (1, juce::jmin ((int) (maxSeconds * sampleRate), (int) std::ceil (sourceLength / ratio)));
+        destination.setSize (numChannels, length);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            juce::LagrangeInterpolator interpolator;
+            interpolator.process (ratio, source.getReadPointer (channel), destination.getWritePointer (channel), length, sourceLength, 0);
+        }
+
+        return true;
+    }
+
+    // Decaying noise through a cab-like band-pass, with a faint room that dies away over the last of the 200 ms
+    static void makeBuiltIn (double sampleRate, juce::AudioBuffer<float>& destination)
+    {
+        const auto length = juce::jmax (1, (int) (sampleRate * builtInSeconds));
+        destination.setSize (1, length);
+
+        auto* samples = destination.getWritePointer (0);
+        juce::Random random (0x0cab);
+
+        for (int i = 0; i < length; ++i)
+        {
+            const auto time = (float) (i / sampleRate);
+            const auto envelope = std::exp (-time / 0.003f) + 0.05f * std::exp (-time / 0.029f);
+            samples[i] = (random.nextFloat() * 2.0f - 1.0f) * envelope;
+        }
+
+        juce::IIRFilter filters[4];
+        filters[0].setCoefficients (juce::IIRCoefficients::makeHighPass (sampleRate, 80.0));
+        filters[1].setCoefficients (juce::IIRCoefficients::makePeakFilter (sampleRate, 2500.0, 1.0, 2.0f));
+        filters[2].setCoefficients (juce::IIRCoefficients::makeLowPass (sampleRate, 4500.0));
+        filters[3].setCoefficients (juce::IIRCoefficients::makeLowPass (sampleRate, 4500.0));
+
+        for (auto& filter : filters)
+            filter.processSamples (samples, length);
+    }
+
+    static void normalise (juce::AudioBuffer<float>& response)
+    {
+        double energy = 0.0;
+
+        for (int channel = 0; channel < response.getNumChannels(); ++channel)
+            for (int i = 0; i < response.getNumSamples(); ++i)
+                energy += juce::square ((double) response.getSample (channel, i));
+
+        energy /= juce::jmax (1, response.getNumChannels());
+
+        if (energy > 0.0)
+            response.applyGain ((float) (1.0 / std::sqrt (energy)));
+    }
+
+    //==============================================================================
+    juce::Array<juce::File> files;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ImpulseResponseLibrary)
+};
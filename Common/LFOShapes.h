@@ -0,0 +1,109 @@
+/*******************************************************************************
+
+ name:             LFOShapes
+ description:      inlinable LFO waveforms and a per-channel phase accumulator.
+
+ juce::dsp::Oscillator calls its waveform through a std::function for every
+ sample, which keeps the compiler from inlining or vectorizing the loop around
+ it. Here each waveform is a struct with a static value() function, so a
+ processing kernel templated on the shape gets the waveform inlined, and the
+ phase of sample i is computed directly instead of being carried from sample
+ to sample.
+
+ The phase convention matches juce::dsp::Oscillator: value() receives a phase
+ in [-pi, pi) and a freshly reset LFO starts at -pi.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+namespace LFOShape
+{
+    struct Sine
+    {
+        static float value (float phase) noexcept    { return juce::dsp::FastMathApproximations::sin (phase); }
+    };
+
+    struct Saw
+    {
+        static float value (float phase) noexcept    { return phase * (1.0f / juce::MathConstants<float>::pi); }
+    };
+
+    struct Square
+    {
+        static float value (float phase) noexcept    { return phase < 0.0f ? -1.0f : 1.0f; }
+    };
+}
+
+//==============================================================================
+class LFOPhase
+{
+public:
+    void prepare (double newSampleRate)
+    {
+        sampleRate = newSampleRate;
+        reset();
+    }
+
+    void reset() noexcept                                       { phase = 0.0f; }
+
+    // Rate in Hz. The phase stays continuous when the rate changes.
+    void setFrequency (float newFrequency) noexcept
+    {
+        increment = (float) (juce::MathConstants<double>::twoPi * juce::jmax (0.0f, newFrequency) / sampleRate);
+    }
+
+    // Phase of sample i of the current block, in [-pi, pi). Does not depend on earlier samples,
+    // so loops calling it can be vectorized.
+    float phaseAt (int sample) const noexcept                   { return wrap (phase + increment * (float) sample) - juce::MathConstants<float>::pi; }
+
+    // Moves the phase on by a whole block once it has been processed
+    void advance (int numSamples) noexcept                      { phase = wrap (phase + increment * (float) numSamples); }
+
+    // Writes numSamples values of the given shape into dest and advances the phase
+    template <typename Shape>
+    void render (float* dest, int numSamples) noexcept
+    {
+        for (int sample = 0; sample < numSamples; ++sample)
+            dest[sample] = Shape::value (phaseAt (sample));
+
+        advance (numSamples);
+    }
+
+    // Like render(), but evaluates the shape only every interval samples and interpolates linearly in between.
+    // Only for smooth shapes at slow rates, where the straight segments cannot be told from the curve.
+    template <typename Shape>
+    void renderInterpolated (float* dest, int numSamples, int interval) noexcept
+    {
+        const float step = 1.0f / (float) interval;
+        float start = Shape::value (phaseAt (0));
+
+        for (int segment = 0; segment < numSamples; segment += interval)
+        {
+            const float end = Shape::value (phaseAt (segment + interval));
+            const float slope = (end - start) * step;
+            const int length = juce::jmin (interval, numSamples - segment);
+
+            for (int sample = 0; sample < length; ++sample)
+                dest[segment + sample] = start + slope * (float) sample;
+
+            start = end;
+        }
+
+        advance (numSamples);
+    }
+
+private:
+    // Rates are never negative, so the phase is never negative and truncation is a floor that vectorizes on plain SSE2
+    static float wrap (float x) noexcept
+    {
+        constexpr auto twoPi = juce::MathConstants<float>::twoPi;
+        return x - twoPi * (float) (int) (x * (1.0f / twoPi));
+    }
+
+    double sampleRate = 44100.0;
+    float phase = 0.0f;      // In [0, 2pi), at the first sample of the next block
+    float increment = 0.0f;  // Per sample
+};
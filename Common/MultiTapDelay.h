@@ -0,0 +1,158 @@
+/*******************************************************************************
+
+ name:             MultiTapDelay
+ description:      block-based multi-tap delay engine shared by the delay plugins.
+
+ Every channel owns one ring buffer inside a single DelayMemory allocation,
+ stored in the format the plugin asks for. All taps are read as whole spans
+ per block instead of one popSample call per tap per sample, so the inner
+ loops are plain conversion and multiply-add loops that the compiler
+ vectorizes.
+
+ Because the feedback signal written into the ring depends on the taps read in
+ the same block, a block is split into chunks no longer than the shortest tap
+ delay. Within one chunk nothing that is read has been written yet.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "DelayMemory.h"
+#include "SmoothedParameter.h"
+
+
+//==============================================================================
+class MultiTapDelay
+{
+public:
+    // Upper bound on the number of taps so that tap state lives in fixed arrays
+    static constexpr int maxTaps = 16;
+
+    //==============================================================================
+    // Allocates the ring buffers. Must be called from prepareToPlay, never from the audio thread.
+    void prepare (int numChannels, int maximumDelayInSamples, int maximumBlockSize, DelayMemory::Format format = DelayMemory::float32)
+    {
+        maxDelay = juce::jmax (1, maximumDelayInSamples);
+        history.prepare (numChannels, maxDelay, format);
+        scratch.setSize (2, juce::jmax (1, maximumBlockSize));
+    }
+
+    // Clears the delay history of every channel
+    void reset()
+    {
+        history.reset();
+    }
+
+    //==============================================================================
+    // Sets the delay (in whole samples) and mix weight of every tap. Called once per block.
+    void setTaps (const int* delaysInSamples, const float* tapWeights, int numTapsToUse)
+    {
+        numTaps = juce::jlimit (0, maxTaps, numTapsToUse);
+        minDelay = maxDelay;
+
+        for (int tap = 0; tap < numTaps; ++tap)
+        {
+            // A tap needs at least one sample of delay, otherwise it would read the sample being written
+            tapDelay[(size_t) tap] = juce::jlimit (1, maxDelay, delaysInSamples[tap]);
+            tapWeight[(size_t) tap] = tapWeights[tap];
+            minDelay = juce::jmin (minDelay, tapDelay[(size_t) tap]);
+        }
+    }
+
+    int getNumTaps() const                                      { return numTaps; }
+    int getMaximumDelayInSamples() const                        { return maxDelay; }
+    size_t getSizeInBytes() const                               { return history.getSizeInBytes(); }
+
+    //==============================================================================
+    // Echo-style processing of one channel in place:
+    //   wet   = sum of every tap times its weight
+    //   ring <- dry * (1 - feedback) + wet * feedback
+    //   out   = (dry * (1 - mix) + wet * mix) * gain
+    // Feedback, mix and gain must have been updated for this block. While none of them is
+    // ramping, the feedback write and the output mix are whole-span vector operations.
+    void process (int channel, float* channelData, int numSamples,
+                  const SmoothedParameter& feedback, const SmoothedParameter& mix, const SmoothedParameter& gain)
+    {
+        if (numTaps == 0)
+            return;
+
+        const bool smoothing = feedback.isSmoothing() || mix.isSmoothing() || gain.isSmoothing();
+        auto* wet = scratch.getWritePointer (0);
+        auto* feedbackMix = scratch.getWritePointer (1);
+        const int maxChunk = juce::jmin (minDelay, scratch.getNumSamples());
+
+        for (int start = 0; start < numSamples;)
+        {
+            const int chunk = juce::jmin (maxChunk, numSamples - start);
+            auto* dry = channelData + start;
+
+            readTaps (channel, wet, chunk);
+
+            if (! smoothing)
+            {
+                const float feedbackValue = feedback.getTargetValue();
+                const float mixValue = mix.getTargetValue();
+                const float gainValue = gain.getTargetValue();
+
+                writeMix (channel, dry, 1.0f - feedbackValue, wet, feedbackValue, chunk); // Feedback
+
+                juce::FloatVectorOperations::multiply (dry, (1.0f - mixValue) * gainValue, chunk); // Mix dry sample with wet sample and apply gain
+                juce::FloatVectorOperations::addWithMultiply (dry, wet, mixValue * gainValue, chunk);
+            }
+            else
+            {
+                for (int i = 0; i < chunk; ++i)
+                {
+                    const float feedbackValue = feedback.get<true> (start + i);
+                    const float mixValue = mix.get<true> (start + i);
+                    const float gainValue = gain.get<true> (start + i);
+
+                    feedbackMix[i] = dry[i] * (1.0f - feedbackValue) + wet[i] * feedbackValue; // Feedback
+                    dry[i] = (dry[i] * (1.0f - mixValue) + wet[i] * mixValue) * gainValue; // Mix dry sample with wet sample and apply gain
+                }
+
+                write (channel, feedbackMix, chunk);
+            }
+
+            start += chunk;
+        }
+    }
+
+    //==============================================================================
+    // Writes the weighted sum of all taps for the next numSamples samples into dest.
+    // numSamples must not exceed the shortest tap delay.
+    void readTaps (int channel, float* dest, int numSamples)
+    {
+        jassert (numSamples <= minDelay);
+
+        history.withChannel (channel, [&] (auto ring)
+        {
+            for (int tap = 0; tap < numTaps; ++tap)
+                ring.readSpan (tapDelay[(size_t) tap], dest, numSamples, tapWeight[(size_t) tap], tap > 0);
+        });
+    }
+
+    // Pushes a * gainA + b * gainB into the ring and advances the write position
+    void writeMix (int channel, const float* a, float gainA, const float* b, float gainB, int numSamples)
+    {
+        history.withChannel (channel, [&] (auto ring) { ring.writeMix (a, gainA, b, gainB, numSamples); });
+    }
+
+    // Pushes src into the ring unchanged and advances the write position
+    void write (int channel, const float* src, int numSamples)
+    {
+        history.withChannel (channel, [&] (auto ring) { ring.write (src, numSamples); });
+    }
+
+private:
+    //==============================================================================
+    DelayMemory history;                 // One ring per audio channel, allocated as a single block
+    juce::AudioBuffer<float> scratch;    // Weighted tap sum and, while ramping, the feedback signal of the chunk being processed
+
+    std::array<int, maxTaps> tapDelay {};
+    std::array<float, maxTaps> tapWeight {};
+
+    int maxDelay = 1;
+    int minDelay = 1;
+    int numTaps = 0;
+};
@@ -0,0 +1,162 @@
+/*******************************************************************************
+
+ name:             OversampledWaveshaper
+ description:      oversampled waveshaper stage shared by the distortion plugins.
+
+ A nonlinearity applied at the base rate creates harmonics above Nyquist that
+ fold back into the audible band, and the harder the clipping the more of
+ them there are. Here each block is upsampled 2x, 4x or 8x with cascaded
+ half-band filters, shaped at the higher rate, then filtered and decimated
+ back, so most of those harmonics are removed before they can alias.
+
+ The half-band filters come from juce::dsp::Oversampling, either polyphase
+ IIR (cheap, a few samples of latency, slightly non-linear phase) or
+ equiripple FIR (linear phase, more latency and CPU). One oversampler per
+ factor and filter type is built in prepare(), so the factor and filter can
+ be switched from the audio thread without allocating.
+
+ The shape function is called once per oversampled sample with the sample and
+ the index of the base-rate sample it belongs to, so per-sample parameters
+ from a SmoothedParameter can be read at the matching position. Shapers that
+ keep state from sample to sample (AntiderivativeWaveshaper) use
+ processChannels() instead, which hands over whole oversampled channel spans.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+class OversampledWaveshaper
+{
+public:
+    // Values of the plugins' filter parameter
+    enum FilterType
+    {
+        iir = 0,
+        fir = 1
+    };
+
+    // Oversampling factors go up to 2^maxFactorLog2 = 8x
+    static constexpr int maxFactorLog2 = 3;
+
+    //==============================================================================
+    // Builds every oversampler. Must be called from prepareToPlay, never from the audio thread.
+    void prepare (int numChannels, int maximumBlockSize)
+    {
+        maxBlockSize = juce::jmax (1, maximumBlockSize);
+
+        for (int factor = 1; factor <= maxFactorLog2; ++factor)
+        {
+            for (auto type : { iir, fir })
+            {
+                auto& oversampler = oversamplers[(size_t) factor - 1][(size_t) type];
+                oversampler = std::make_unique<juce::dsp::Oversampling<float>> ((size_t) juce::jmax (1, numChannels), (size_t) factor,
+                                                                                  type == iir ? juce::dsp::Oversampling<float>::filterHalfBandPolyphaseIIR
+                                                                                              : juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple);
+                oversampler->initProcessing ((size_t) maxBlockSize);
+            }
+        }
+
+        reset();
+    }
+
+    // Clears the filter history of every oversampler
+    void reset()
+    {
+        for (auto& factor : oversamplers)
+            for (auto& oversampler : factor)
+                if (oversampler != nullptr)
+                    oversampler->reset();
+    }
+
+    //==============================================================================
+    // Selects 2^factorLog2 times oversampling (0 shapes at the base rate) and the filter type. Called once per block.
+    void setOversampling (int factorLog2, int filterType) noexcept
+    {
+        const int newFactorLog2 = juce::jlimit (0, maxFactorLog2, factorLog2);
+        const auto newType = filterType == fir ? fir : iir;
+
+        if (newFactorLog2 == factorLog2InUse && newType == typeInUse)
+            return;
+
+        factorLog2InUse = newFactorLog2;
+        typeInUse = newType;
+
+        // The newly selected filters still hold whatever they last processed
+        if (auto* oversampler = getOversampler())
+            oversampler->reset();
+    }
+
+    int getFactor() const noexcept                              { return 1 << factorLog2InUse; }
+
+    // Base-rate sample that oversampled sample i of a span starting at base-rate sample firstSample belongs to
+    int getBaseSample (int firstSample, int i) const noexcept   { return firstSample + (i >> factorLog2InUse); }
+
+    // Latency of the current settings in whole base-rate samples, for the plugin to report. shaperLatency is the delay the
+    // shape function adds (an AntiderivativeWaveshaper's), counted in samples at the oversampled rate. The IIR filters'
+    // latency is fractional, so the total is rounded.
+    int getLatencyInSamples (float shaperLatency = 0.0f) const noexcept
+    {
+        const auto* oversampler = getOversampler();
+        const auto filterLatency = oversampler != nullptr ? oversampler->getLatencyInSamples() : 0.0f;
+
+        return juce::roundToInt (filterLatency + shaperLatency / (float) getFactor());
+    }
+
+    //==============================================================================
+    // Shapes every channel of the buffer in place. shape (float x, int sample) returns the shaped value of x,
+    // where sample is the base-rate index of x within the buffer.
+    template <typename ShapeFunction>
+    void process (juce::AudioBuffer<float>& buffer, ShapeFunction&& shape)
+    {
+        processChannels (buffer, [this, &shape] (int, float* channelData, int numSamples, int firstSample)
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+                channelData[sample] = shape (channelData[sample], getBaseSample (firstSample, sample));
+        });
+    }
+
+    // Shapes every channel of the buffer in place, one span at a time. shapeChannel (int channel, float* data,
+    // int numSamples, int firstSample) gets numSamples oversampled samples that start at base-rate sample firstSample.
+    template <typename ShapeChannelFunction>
+    void processChannels (juce::AudioBuffer<float>& buffer, ShapeChannelFunction&& shapeChannel)
+    {
+        auto* oversampler = getOversampler();
+
+        if (oversampler == nullptr)
+        {
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                shapeChannel (channel, buffer.getWritePointer (channel), buffer.getNumSamples(), 0);
+
+            return;
+        }
+
+        juce::dsp::AudioBlock<float> block (buffer);
+
+        // The oversamplers are sized for the prepared block size, so longer blocks are shaped in pieces
+        for (int start = 0; start < buffer.getNumSamples(); start += maxBlockSize)
+        {
+            auto chunk = block.getSubBlock ((size_t) start, (size_t) juce::jmin (maxBlockSize, buffer.getNumSamples() - start));
+            auto upsampled = oversampler->processSamplesUp (chunk);
+
+            for (size_t channel = 0; channel < upsampled.getNumChannels(); ++channel)
+                shapeChannel ((int) channel, upsampled.getChannelPointer (channel), (int) upsampled.getNumSamples(), start);
+
+            oversampler->processSamplesDown (chunk);
+        }
+    }
+
+private:
+    //==============================================================================
+    juce::dsp::Oversampling<float>* getOversampler() const noexcept
+    {
+        return factorLog2InUse > 0 ? oversamplers[(size_t) factorLog2InUse - 1][(size_t) typeInUse].get() : nullptr;
+    }
+
+    //==============================================================================
+    std::array<std::array<std::unique_ptr<juce::dsp::Oversampling<float>>, 2>, maxFactorLog2> oversamplers;
+    int maxBlockSize = 1;
+    int factorLog2InUse = 0;
+    FilterType typeInUse = iir;
+};
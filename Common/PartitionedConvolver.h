@@ -0,0 +1,587 @@
+/*******************************************************************************
+
+ name:             PartitionedConvolver
+ description:      FFT convolution with an impulse response, short partitions
+                   on the audio thread and long ones on a worker thread.
+
+ A 200 ms cab response at 96 kHz has 19200 taps. Convolved in 64-sample
+ partitions in the frequency domain (uniformly partitioned overlap-save), it
+ costs one small FFT per 64 samples, but every one of its 300 partitions is
+ multiplied in each time. Longer partitions need far fewer multiplies, at the
+ cost of latency and of one large FFT every few blocks.
+
+ So the response is split in two stages. The head, the first 2 * tailSize
+ samples, runs on the audio thread in 64-sample partitions, which is the
+ whole latency of the plugin. The rest runs in tailSize partitions (1024
+ samples, or twice the block size if that is longer) on a worker thread. A
+ tail block of input is handed to the worker as soon as it is complete, and
+ its output is only needed a whole tail block later, once the head has run
+ out. If the worker has not started a block by then, the audio thread runs it
+ itself, and if the worker is halfway through it waits, so the output is the
+ same however the threads are scheduled. With a single core, or when the
+ worker cannot get real-time scheduling, the tail always runs on the audio
+ thread, and the worker only loads responses. The worker sleeps while it has
+ nothing to do, and the audio thread only signals it when it is asleep.
+
+ Spectra are stored as an array of real parts followed by an array of
+ imaginary parts, so the multiply-adds over the partitions are plain loops
+ that vectorize.
+
+ Responses are loaded through the function the plugin passes in, on the
+ worker thread between tail blocks, into the slot the audio thread is not
+ using. The audio thread switches to the new one at the start of a tail
+ block, in the head and the tail together.
+
+*******************************************************************************/
+
+#pragma once
+
+#if JUCE_INTEL
+ #include <immintrin.h>
+#endif
+
+
+//==============================================================================
+class PartitionedConvolver
+{
+public:
+    static constexpr int headSize = 64;                 // Partition length of the head, and the latency
+    static constexpr int minTailSize = 1024;
+    static constexpr int maxChannels = 2;
+    static constexpr double maxImpulseSeconds = 1.0;    // Longer responses are cut
+
+    // Fills destination with impulse response number index at sampleRate. Called on the worker thread, or from prepare().
+    using Loader = std::function<void (int index, double sampleRate, juce::AudioBuffer<float>& destination)>;
+
+    explicit PartitionedConvolver (Loader loaderToUse)
+        : loader (std::move (loaderToUse)), worker (*this)
+    {
+    }
+
+    ~PartitionedConvolver()
+    {
+        release();
+    }
+
+    //==============================================================================
+    // Allocates and clears everything, loads impulse response number impulseIndex and starts the worker.
+    // Must be called from prepareToPlay, never from the audio thread.
+    void prepare (double newSampleRate, int maximumBlockSize, int impulseIndex)
+    {
+        release();
+
+        sampleRate = newSampleRate;
+        tailSize = juce::jmax (minTailSize, 2 * juce::nextPowerOfTwo (maximumBlockSize));
+        headLength = 2 * tailSize;
+        blocksPerTail = tailSize / headSize;
+        maxLength = juce::jmax (1, (int) (sampleRate * maxImpulseSeconds));
+
+        const int maxTailPartitions = juce::jmax (1, divideRoundingUp (maxLength - headLength, tailSize));
+
+        head.prepare (headSize, headLength / headSize);
+        tail.prepare (tailSize, maxTailPartitions);
+        headResponseTransform.prepare (headSize);
+        tailResponseTransform.prepare (tailSize);
+
+        headInput.assign ((size_t) (maxChannels * headSize), 0.0f);
+        headOutput.assign ((size_t) (maxChannels * headSize), 0.0f);
+        tailInput.assign ((size_t) (2 * maxChannels * tailSize), 0.0f);
+        tailOutput.assign ((size_t) (2 * maxChannels * tailSize), 0.0f);
+
+        headPosition = 0;
+        headBlock = 0;
+        tailBlock = 0;
+        submittedJobs = claimedJobs = completedJobs = 0;
+
+        loader (impulseIndex, sampleRate, impulse);
+        buildResponse (responses[0], impulse, [] {});
+        loadedIndex = impulseIndex;
+        requestedIndex = impulseIndex;
+        currentSlot = 0;
+        publishedSlot = audioSlot = 0;
+        switchJob = 0;
+
+        // On a single core the audio thread would spin on a worker it has preempted, so the worker only loads responses
+        workerRunsTail = juce::SystemStats::getNumCpus() > 1;
+
+        // Without real-time scheduling the audio thread could end up waiting on a worker the scheduler has put aside,
+        // so the worker then runs at normal priority and only loads responses
+        if (! worker.startRealtimeThread (juce::Thread::RealtimeOptions().withPriority (6)))
+        {
+            workerRunsTail = false;
+            worker.startThread();
+        }
+    }
+
+    // Stops the worker. prepare() starts it again.
+    void release()
+    {
+        worker.signalThreadShouldExit();
+        worker.notify();
+        worker.stopThread (1000);
+    }
+
+    int getLatencyInSamples() const noexcept                    { return headSize; }
+
+    // Asks for impulse response number index. The worker loads it and the audio thread switches to it once it is ready.
+    void setImpulseResponse (int index) noexcept
+    {
+        requestedIndex.store (index, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    void processMono (float* samples, int numSamples) noexcept
+    {
+        float* channels[] { samples };
+        process (channels, 1, numSamples);
+    }
+
+    void processStereo (float* left, float* right, int numSamples) noexcept
+    {
+        float* channels[] { left, right };
+        process (channels, 2, numSamples);
+    }
+
+private:
+    //==============================================================================
+    // Real FFT of twice the partition length, with the spectrum as binStride real parts followed by binStride imaginary parts
+    struct Transform
+    {
+        void prepare (int partitionSize)
+        {
+            size = partitionSize;
+            binStride = (size + 1 + 3) / 4 * 4;
+            fft = std::make_unique<juce::dsp::FFT> (juce::roundToInt (std::log2 (2 * size)));
+            buffer.assign ((size_t) (4 * size), 0.0f);
+        }
+
+        int getSpectrumSize() const noexcept                    { return 2 * binStride; }
+
+        // Spectrum of numSamples samples, zero padded to twice the partition length. The padding bins stay zero.
+        void forward (const float* samples, int numSamples, float* spectrum) noexcept
+        {
+            std::copy (samples, samples + numSamples, buffer.begin());
+            std::fill (buffer.begin() + numSamples, buffer.end(), 0.0f);
+            fft->performRealOnlyForwardTransform (buffer.data(), true);
+
+            for (int bin = 0; bin <= size; ++bin)
+            {
+                spectrum[bin] = buffer[(size_t) (2 * bin)];
+                spectrum[binStride + bin] = buffer[(size_t) (2 * bin + 1)];
+            }
+
+            std::fill (spectrum + size + 1, spectrum + binStride, 0.0f);
+            std::fill (spectrum + binStride + size + 1, spectrum + 2 * binStride, 0.0f);
+        }
+
+        // Writes the second half of the signal, the part of a circular convolution that is not wrapped around
+        void inverse (const float* spectrum, float* output) noexcept
+        {
+            for (int bin = 0; bin <= size; ++bin)
+            {
+                buffer[(size_t) (2 * bin)] = spectrum[bin];
+                buffer[(size_t) (2 * bin + 1)] = spectrum[binStride + bin];
+            }
+
+            std::fill (buffer.begin() + 2 * (size + 1), buffer.end(), 0.0f);
+            fft->performRealOnlyInverseTransform (buffer.data());
+            std::copy (buffer.begin() + size, buffer.begin() + 2 * size, output);
+        }
+
+        std::unique_ptr<juce::dsp::FFT> fft;
+        std::vector<float> buffer;
+        int size = 0;
+        int binStride = 0;
+    };
+
+    //==============================================================================
+    // Uniformly partitioned overlap-save convolution of every channel, one partition of input at a time
+    struct Stage
+    {
+        void prepare (int partitionSize, int maxPartitions)
+        {
+            transform.prepare (partitionSize);
+            size = partitionSize;
+            historyLength = maxPartitions;
+            history.assign ((size_t) (maxChannels * historyLength * transform.getSpectrumSize()), 0.0f);
+            frames.assign ((size_t) (maxChannels * 2 * size), 0.0f);
+            sums.assign ((size_t) transform.getSpectrumSize(), 0.0f);
+            position = 0;
+        }
+
+        // Convolves the next partition of a channel's input with numPartitions partitions of a response.
+        // Called for every channel, then advance() once.
+        void process (int channel, const float* input, float* output, const float* spectra, int numPartitions) noexcept
+        {
+            const int spectrumSize = transform.getSpectrumSize();
+            const int binStride = transform.binStride;
+            auto* frame = frames.data() + channel * 2 * size;
+
+            std::copy (input, input + size, frame + size);
+            transform.forward (frame, 2 * size, getHistory (channel, position));
+            std::copy (frame + size, frame + 2 * size, frame);
+
+            if (numPartitions == 0)
+            {
+                std::fill (output, output + size, 0.0f);
+                return;
+            }
+
+            auto* sumReal = sums.data();
+            auto* sumImag = sumReal + binStride;
+            std::fill (sums.begin(), sums.end(), 0.0f);
+
+            // Partition p of the response meets the input spectrum from p partitions ago
+            for (int partition = 0; partition < numPartitions; ++partition)
+            {
+                const auto* x = getHistory (channel, position >= partition ? position - partition : position - partition + historyLength);
+                const auto* h = spectra + partition * spectrumSize;
+
+                for (int bin = 0; bin < binStride; ++bin)
+                {
+                    const auto xr = x[bin], xi = x[binStride + bin];
+                    const auto hr = h[bin], hi = h[binStride + bin];
+                    sumReal[bin] += xr * hr - xi * hi;
+                    sumImag[bin] += xr * hi + xi * hr;
+                }
+            }
+
+            transform.inverse (sums.data(), output);
+        }
+
+        void advance() noexcept
+        {
+            position = position + 1 == historyLength ? 0 : position + 1;
+        }
+
+        float* getHistory (int channel, int slot) noexcept
+        {
+            return history.data() + (channel * historyLength + slot) * transform.getSpectrumSize();
+        }
+
+        Transform transform;
+        std::vector<float> history;     // Input spectra of the last historyLength partitions, per channel
+        std::vector<float> frames;      // The last two partitions of input, per channel
+        std::vector<float> sums;
+        int size = 0;
+        int historyLength = 1;
+        int position = 0;               // History slot of the latest partition
+    };
+
+    //==============================================================================
+    // Spectra of every partition of a response, channel after channel
+    struct Response
+    {
+        const float* getHead (int channel, int spectrumSize) const noexcept
+        {
+            return head.data() + juce::jmin (channel, numChannels - 1) * numHeadPartitions * spectrumSize;
+        }
+
+        const float* getTail (int channel, int spectrumSize) const noexcept
+        {
+            return tail.data() + juce::jmin (channel, numChannels - 1) * numTailPartitions * spectrumSize;
+        }
+
+        std::vector<float> head, tail;
+        int numChannels = 1;
+        int numHeadPartitions = 0;
+        int numTailPartitions = 0;
+    };
+
+    // Transforms the partitions of a response. betweenPartitions is called after each tail partition.
+    template <typename Callback>
+    void buildResponse (Response& response, const juce::AudioBuffer<float>& source, Callback&& betweenPartitions)
+    {
+        const int length = source.getNumChannels() > 0 ? juce::jmin (source.getNumSamples(), maxLength) : 0;
+        const int headSpectrumSize = headResponseTransform.getSpectrumSize();
+        const int tailSpectrumSize = tailResponseTransform.getSpectrumSize();
+
+        response.numChannels = juce::jlimit (1, maxChannels, source.getNumChannels());
+        response.numHeadPartitions = juce::jmin (headLength / headSize, divideRoundingUp (length, headSize));
+        response.numTailPartitions = divideRoundingUp (juce::jmax (0, length - headLength), tailSize);
+        response.head.resize ((size_t) (response.numChannels * response.numHeadPartitions * headSpectrumSize));
+        response.tail.resize ((size_t) (response.numChannels * response.numTailPartitions * tailSpectrumSize));
+
+        for (int channel = 0; channel < juce::jmin (response.numChannels, source.getNumChannels()); ++channel)
+        {
+            const auto* samples = source.getReadPointer (channel);
+            auto* headSpectra = response.head.data() + channel * response.numHeadPartitions * headSpectrumSize;
+            auto* tailSpectra = response.tail.data() + channel * response.numTailPartitions * tailSpectrumSize;
+
+            for (int partition = 0; partition < response.numHeadPartitions; ++partition)
+            {
+                const int start = partition * headSize;
+                headResponseTransform.forward (samples + start, juce::jmin (headSize, length - start), headSpectra + partition * headSpectrumSize);
+            }
+
+            for (int partition = 0; partition < response.numTailPartitions; ++partition)
+            {
+                const int start = headLength + partition * tailSize;
+                tailResponseTransform.forward (samples + start, juce::jmin (tailSize, length - start), tailSpectra + partition * tailSpectrumSize);
+                betweenPartitions();
+            }
+        }
+    }
+
+    //==============================================================================
+    void process (float* const* channels, int numChannels, int numSamples) noexcept
+    {
+        for (int done = 0; done < numSamples;)
+        {
+            const int length = juce::jmin (numSamples - done, headSize - headPosition);
+
+            // The input is copied out before the output is written, so the buffer can be processed in place
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                auto* samples = channels[channel] + done;
+                std::copy (samples, samples + length, headInput.data() + channel * headSize + headPosition);
+                std::copy (headOutput.data() + channel * headSize + headPosition, headOutput.data() + channel * headSize + headPosition + length, samples);
+            }
+
+            done += length;
+            headPosition += length;
+
+            if (headPosition == headSize)
+            {
+                processHeadBlock (numChannels);
+                headPosition = 0;
+            }
+        }
+    }
+
+    // Convolves the latest head partition of input and adds the part of the tail that plays next
+    void processHeadBlock (int numChannels) noexcept
+    {
+        if (headBlock == 0)
+        {
+            const auto published = publishedSlot.load (std::memory_order_acquire);
+
+            if (published != currentSlot)
+            {
+                currentSlot = published;
+                switchJob.store (tailBlock, std::memory_order_relaxed);
+                audioSlot.store (published, std::memory_order_release);
+            }
+
+            // The tail block handed over two tail blocks ago plays from here on
+            if (tailBlock >= 2)
+                finishTailJob (tailBlock - 2);
+        }
+
+        const auto& response = responses[currentSlot];
+        const int spectrumSize = head.transform.getSpectrumSize();
+        const int tailSlot = (int) (tailBlock % 2);
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const auto* input = headInput.data() + channel * headSize;
+            auto* output = headOutput.data() + channel * headSize;
+
+            head.process (channel, input, output, response.getHead (channel, spectrumSize), response.numHeadPartitions);
+
+            // Job n's output and job n + 2's input share a slot
+            const auto offset = (tailSlot * maxChannels + channel) * tailSize + headBlock * headSize;
+
+            if (tailBlock >= 2)
+                juce::FloatVectorOperations::add (output, tailOutput.data() + offset, headSize);
+
+            std::copy (input, input + headSize, tailInput.data() + offset);
+        }
+
+        head.advance();
+
+        // Handed over after the last read of the slot's output above
+        if (++headBlock == blocksPerTail)
+        {
+            submitTailJob (tailBlock, numChannels);
+            ++tailBlock;
+            headBlock = 0;
+        }
+    }
+
+    //==============================================================================
+    void submitTailJob (juce::int64 job, int numChannels) noexcept
+    {
+        jobSlots[job % 2] = currentSlot;
+        jobChannels[job % 2] = numChannels;
+        submittedJobs.store (job + 1, std::memory_order_seq_cst);
+
+        // Only a worker that is waiting is signalled, so the audio thread rarely goes through the event's lock.
+        // Also wakes a worker that only loads, to retry a response that was waiting for its slot.
+        if (worker.sleeping.load (std::memory_order_seq_cst))
+            worker.notify();
+    }
+
+    // Runs the job unless the worker has taken it, and waits until it is done
+    void finishTailJob (juce::int64 job) noexcept
+    {
+        if (completedJobs.load (std::memory_order_acquire) > job || tryRunTailJob (job))
+            return;
+
+        while (completedJobs.load (std::memory_order_acquire) <= job)
+            pause();
+    }
+
+    // Runs the job if it is the next one and nobody has taken it. Jobs run one at a time, in order, since they share the tail's history.
+    bool tryRunTailJob (juce::int64 job) noexcept
+    {
+        auto expected = job;
+
+        if (completedJobs.load (std::memory_order_acquire) != job
+             || ! claimedJobs.compare_exchange_strong (expected, job + 1, std::memory_order_acq_rel))
+            return false;
+
+        const auto& response = responses[jobSlots[job % 2]];
+        const int spectrumSize = tail.transform.getSpectrumSize();
+        const int slot = (int) (job % 2);
+
+        for (int channel = 0; channel < jobChannels[slot]; ++channel)
+        {
+            const auto offset = (slot * maxChannels + channel) * tailSize;
+            tail.process (channel, tailInput.data() + offset, tailOutput.data() + offset,
+                          response.getTail (channel, spectrumSize), response.numTailPartitions);
+        }
+
+        tail.advance();
+        completedJobs.store (job + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Runs every job handed over and not taken yet, on the worker thread. Returns false if there were none.
+    bool runPendingTailJobs() noexcept
+    {
+        if (! workerRunsTail)
+            return false;
+
+        bool ranAny = false;
+
+        for (;;)
+        {
+            const auto job = claimedJobs.load (std::memory_order_acquire);
+
+            if (job >= submittedJobs.load (std::memory_order_acquire))
+                return ranAny;
+
+            // Fails while the audio thread runs the job before it, or if it took this one
+            if (tryRunTailJob (job))
+                ranAny = true;
+            else
+                pause();
+        }
+    }
+
+    //==============================================================================
+    // Loads the requested response into the slot the audio thread is not using, on the worker thread.
+    // Returns false if there was nothing to load, or the slot is not free yet.
+    bool loadRequestedResponse()
+    {
+        const auto index = requestedIndex.load (std::memory_order_relaxed);
+
+        if (index == loadedIndex)
+            return false;
+
+        // The audio thread must have switched to the last response loaded, and every job that used the older one must be done
+        const auto slot = audioSlot.load (std::memory_order_acquire);
+
+        if (slot != publishedSlot.load (std::memory_order_relaxed)
+             || completedJobs.load (std::memory_order_acquire) < switchJob.load (std::memory_order_relaxed))
+            return false;
+
+        loader (index, sampleRate, impulse);
+        loadedIndex = index;
+
+        runPendingTailJobs();
+        buildResponse (responses[1 - slot], impulse, [this] { runPendingTailJobs(); });
+        publishedSlot.store (1 - slot, std::memory_order_release);
+        return true;
+    }
+
+    //==============================================================================
+    class Worker final : public juce::Thread
+    {
+    public:
+        explicit Worker (PartitionedConvolver& ownerToUse)
+            : juce::Thread ("Convolution Tail"), owner (ownerToUse)
+        {
+        }
+
+        void run() override
+        {
+            juce::ScopedNoDenormals noDenormals;
+
+            while (! threadShouldExit())
+            {
+                const auto seenJobs = owner.submittedJobs.load (std::memory_order_acquire);
+
+                if (owner.runPendingTailJobs() || owner.loadRequestedResponse())
+                    continue;
+
+                // submitTailJob() checks the flag after publishing a job, so one of the two always sees the other
+                sleeping.store (true, std::memory_order_seq_cst);
+
+                if (owner.submittedJobs.load (std::memory_order_seq_cst) == seenJobs && ! threadShouldExit())
+                    wait (-1);
+
+                sleeping.store (false, std::memory_order_relaxed);
+            }
+        }
+
+        std::atomic<bool> sleeping { false };
+
+    private:
+        PartitionedConvolver& owner;
+    };
+
+    //==============================================================================
+    static int divideRoundingUp (int numerator, int denominator) noexcept
+    {
+        return numerator > 0 ? (numerator + denominator - 1) / denominator : 0;
+    }
+
+    static void pause() noexcept
+    {
+       #if JUCE_INTEL
+        _mm_pause();
+       #elif JUCE_ARM && (JUCE_GCC || JUCE_CLANG)
+        __asm__ __volatile__ ("yield");
+       #endif
+    }
+
+    //==============================================================================
+    Loader loader;
+
+    double sampleRate = 44100.0;
+    int tailSize = minTailSize;
+    int headLength = 2 * minTailSize;   // Samples of the response the head covers, the tail starts after them
+    int blocksPerTail = minTailSize / headSize;
+    int maxLength = 1;
+
+    Stage head, tail;
+    Transform headResponseTransform, tailResponseTransform;    // Used while loading, so they can run beside the stages
+    Response responses[2];
+    juce::AudioBuffer<float> impulse;
+
+    std::vector<float> headInput, headOutput;   // One head partition per channel
+    std::vector<float> tailInput, tailOutput;   // One tail block per channel, for two jobs
+    int headPosition = 0;                       // Samples of the current head partition received
+    int headBlock = 0;                          // Head partitions of the current tail block done
+    juce::int64 tailBlock = 0;                  // Number of the tail block being received
+
+    // Jobs are tail blocks, numbered from 0 after prepare()
+    int jobSlots[2] {};
+    int jobChannels[2] {};
+    std::atomic<juce::int64> submittedJobs { 0 }, claimedJobs { 0 }, completedJobs { 0 };
+
+    // The audio thread plays currentSlot and switches to publishedSlot at the start of a tail block
+    int currentSlot = 0;
+    std::atomic<int> publishedSlot { 0 }, audioSlot { 0 };
+    std::atomic<juce::int64> switchJob { 0 };   // First job of the audio thread's current slot
+    std::atomic<int> requestedIndex { 0 };
+    int loadedIndex = 0;                        // Worker only
+
+    bool workerRunsTail = true;
+    Worker worker;
+
+    //==============================================================================
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PartitionedConvolver)
+};
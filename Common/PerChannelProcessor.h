@@ -0,0 +1,34 @@
+/*******************************************************************************
+
+ name:             PerChannelProcessor
+ description:      interface for plugins whose channels can be processed
+                   independently, on different threads at once.
+
+ A plugin whose left and right channels share nothing but their parameters
+ and LFO rate can split its processBlock in two: beginBlock() reads the
+ parameters and updates the smoothers for the block on the calling thread,
+ then processChannel() runs one channel. The chain host uses this to run the
+ channels of such a pedal on two cores. The plugin's own processBlock calls
+ the same two functions one after the other, so both paths sound the same.
+
+ processChannel() may run for different channels at the same time, so it
+ must only touch that channel's state and read what beginBlock() set up.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+class PerChannelProcessor
+{
+public:
+    virtual ~PerChannelProcessor() = default;
+
+    // Reads the parameters and updates what the channels share for a block of numSamples, at most the prepared block size.
+    // Returns false if the block passes through untouched, in which case processChannel() is not called.
+    virtual bool beginBlock (int numSamples) = 0;
+
+    // Processes one channel of the block begun last, in place. Channels beyond the ones the plugin processes are left alone.
+    virtual void processChannel (int channel, float* channelData, int numSamples) = 0;
+};
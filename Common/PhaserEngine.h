@@ -0,0 +1,278 @@
+/*******************************************************************************
+
+ name:             PhaserEngine
+ description:      all-pass cascade phaser with 2 to 12 stages, both channels
+                   in the lanes of one SIMD register.
+
+ Sounds like juce::dsp::Phaser at 6 stages: first-order all-passes that all
+ share one cutoff, swept by a sine LFO on a log scale from 20 Hz to 20 kHz
+ (depth 1 sweeps 1.5 decades either side of the centre), feedback from the
+ output of the cascade to its input, and a linear dry/wet mix.
+
+ juce::dsp::Phaser runs each channel through the cascade on its own and
+ recomputes every stage's coefficient (a tan()) every 4 samples, holding it
+ in between. Here the left and right samples sit in two lanes of a register
+ and go through the cascade together. The coefficient is computed exactly
+ every controlInterval samples and ramped linearly in between, which costs
+ one add per sample and sweeps without steps.
+
+ A stage is the TPT all-pass of juce::dsp::FirstOrderTPTFilter, rearranged
+ around a = 2G - 1:
+   y = a * x + (1 - a) * s
+   s = (1 + a) * x - a * s
+ The same output to rounding, but only one multiply-add per stage lies on
+ the path from the input of the cascade to its output, so many stages cost
+ little more than the latency of one each.
+
+ setParameters() is meant to be called every block and returns at once when
+ nothing has changed. Depth, centre, feedback and mix glide over 50 ms as in
+ juce::dsp::Phaser.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "SmoothedParameter.h"
+
+
+//==============================================================================
+class PhaserEngine
+{
+public:
+    using Lanes = juce::dsp::SIMDRegister<float>;
+
+    static constexpr int numLanes = (int) Lanes::SIMDNumElements;
+    static constexpr int minStages = 2;
+    static constexpr int maxStages = 12;
+    static constexpr int controlInterval = 16;     // Samples between exact coefficients
+    static constexpr double smoothingSeconds = 0.05;
+
+    struct Parameters
+    {
+        float rate = 0.5f;              // LFO rate in Hz
+        float depth = 0.5f;             // 0 to 1
+        float centreFrequency = 100.0f; // Hz
+        float feedback = 0.0f;          // -1 to 1, negative inverts the fed back signal
+        float mix = 0.5f;               // 0 is dry, 1 is wet
+        int numStages = 6;
+    };
+
+    //==============================================================================
+    // Allocates the lane buffer, clears the stages and jumps to the parameters last set.
+    // Must be called from prepareToPlay, never from the audio thread.
+    void prepare (double newSampleRate, int maximumBlockSize)
+    {
+        sampleRate = newSampleRate;
+        maxFrequency = juce::jmin (20000.0, 0.49 * sampleRate);
+
+        const auto blockSize = juce::jmax (1, maximumBlockSize);
+        frames.assign ((size_t) blockSize, Lanes::expand (0.0f));
+
+        updateTargets();
+        depth.prepare (sampleRate, blockSize, depthTarget, smoothingSeconds);
+        centre.prepare (sampleRate, blockSize, centreTarget, smoothingSeconds);
+        feedback.prepare (sampleRate, blockSize, feedbackTarget, smoothingSeconds);
+        mix.prepare (sampleRate, blockSize, mixTarget, smoothingSeconds);
+
+        reset();
+    }
+
+    // Clears the stages and restarts the LFO
+    void reset() noexcept
+    {
+        std::fill (std::begin (states), std::end (states), Lanes::expand (0.0f));
+        lastOutput = Lanes::expand (0.0f);
+        phase = 0.0;
+        countdown = 0;
+        coefficient = getCoefficient (0);
+    }
+
+    //==============================================================================
+    // Cheap to call every block: the targets are only recomputed when a parameter differs from the last call
+    void setParameters (const Parameters& newParameters) noexcept
+    {
+        if (newParameters.rate == parameters.rate && newParameters.depth == parameters.depth
+             && newParameters.centreFrequency == parameters.centreFrequency && newParameters.feedback == parameters.feedback
+             && newParameters.mix == parameters.mix && newParameters.numStages == parameters.numStages)
+            return;
+
+        const auto oldStages = parameters.numStages;
+        parameters = newParameters;
+        parameters.numStages = juce::jlimit (minStages, maxStages, parameters.numStages);
+
+        // Stages that come back into use start from silence
+        for (int stage = oldStages; stage < parameters.numStages; ++stage)
+            states[stage] = Lanes::expand (0.0f);
+
+        updateTargets();
+    }
+
+    const Parameters& getParameters() const noexcept            { return parameters; }
+
+    //==============================================================================
+    void processMono (float* samples, int numSamples) noexcept
+    {
+        process (samples, nullptr, numSamples);
+    }
+
+    void processStereo (float* left, float* right, int numSamples) noexcept
+    {
+        process (left, right, numSamples);
+    }
+
+private:
+    //==============================================================================
+    void updateTargets() noexcept
+    {
+        phaseIncrement = juce::MathConstants<double>::twoPi * parameters.rate * controlInterval / sampleRate;
+        depthTarget = parameters.depth * 0.5f;
+        centreTarget = (float) normaliseFrequency (parameters.centreFrequency);
+        feedbackTarget = parameters.feedback;
+        mixTarget = parameters.mix;
+    }
+
+    // Position of a frequency on the log scale the LFO sweeps, 0 at 20 Hz and 1 at maxFrequency
+    double normaliseFrequency (double frequency) const noexcept
+    {
+        return std::log (juce::jmax (frequency, minFrequency) / minFrequency) / std::log (maxFrequency / minFrequency);
+    }
+
+    // The all-pass coefficient a = 2G - 1 at the LFO's current phase, with depth and centre at a sample of the block
+    float getCoefficient (int sample) const noexcept
+    {
+        const auto position = juce::jlimit (0.0, 1.0, centre.getValue (sample) + std::sin (phase) * depth.getValue (sample));
+        const auto frequency = minFrequency * std::pow (maxFrequency / minFrequency, position);
+        const auto g = std::tan (juce::MathConstants<double>::pi * frequency / sampleRate);
+        return (float) ((g - 1.0) / (g + 1.0));
+    }
+
+    //==============================================================================
+    void process (float* left, float* right, int numSamples) noexcept
+    {
+        // Blocks larger than the prepared size are split, so the smoothers and the lane buffer always fit
+        for (int done = 0; done < numSamples;)
+        {
+            const int length = juce::jmin (numSamples - done, (int) frames.size());
+            processChunk (left + done, right != nullptr ? right + done : nullptr, length);
+            done += length;
+        }
+    }
+
+    void processChunk (float* left, float* right, int numSamples) noexcept
+    {
+        depth.update (depthTarget, numSamples);
+        centre.update (centreTarget, numSamples);
+        feedback.update (feedbackTarget, numSamples);
+        mix.update (mixTarget, numSamples);
+
+        // Left in lane 0 and right in lane 1, the other lanes carry zeros
+        auto* interleaved = reinterpret_cast<float*> (frames.data());
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            interleaved[i * numLanes] = left[i];
+            interleaved[i * numLanes + 1] = right != nullptr ? right[i] : 0.0f;
+        }
+
+        for (int done = 0; done < numSamples;)
+        {
+            if (countdown == 0)
+            {
+                phase = std::fmod (phase + phaseIncrement, juce::MathConstants<double>::twoPi);
+                coefficientStep = (getCoefficient (done) - coefficient) / (float) controlInterval;
+                countdown = controlInterval;
+            }
+
+            const int length = juce::jmin (numSamples - done, countdown);
+
+            if (feedback.isSmoothing())
+                runCascade<true> (done, length);
+            else
+                runCascade<false> (done, length);
+
+            done += length;
+            countdown -= length;
+        }
+
+        if (mix.isSmoothing())
+        {
+            mixOut<true> (left, 0, numSamples);
+
+            if (right != nullptr)
+                mixOut<true> (right, 1, numSamples);
+        }
+        else
+        {
+            mixOut<false> (left, 0, numSamples);
+
+            if (right != nullptr)
+                mixOut<false> (right, 1, numSamples);
+        }
+    }
+
+    // Runs numSamples frames through the cascade in place, starting at frame start of the chunk
+    template <bool isRamping>
+    void runCascade (int start, int numSamples) noexcept
+    {
+        const int numStages = parameters.numStages;
+        auto a = coefficient;
+        auto last = lastOutput;
+
+        for (int i = start; i < start + numSamples; ++i)
+        {
+            a += coefficientStep;
+
+            const auto gain = Lanes::expand (a);
+            const auto oneMinusGain = Lanes::expand (1.0f - a);
+            const auto onePlusGain = Lanes::expand (1.0f + a);
+
+            auto x = frames[(size_t) i] - last * feedback.get<isRamping> (i);
+
+            for (int stage = 0; stage < numStages; ++stage)
+            {
+                const auto s = states[stage];
+                states[stage] = x * onePlusGain - gain * s;
+                x = Lanes::multiplyAdd (s * oneMinusGain, gain, x);
+            }
+
+            frames[(size_t) i] = x;
+            last = x;
+        }
+
+        coefficient = a;
+        lastOutput = last;
+    }
+
+    // Writes dry * (1 - mix) + wet * mix to a channel, taking the wet signal from its lane
+    template <bool isRamping>
+    void mixOut (float* samples, int lane, int numSamples) noexcept
+    {
+        const auto* wet = reinterpret_cast<const float*> (frames.data()) + lane;
+
+        for (int i = 0; i < numSamples; ++i)
+        {
+            const auto wetGain = mix.get<isRamping> (i);
+            samples[i] = samples[i] * (1.0f - wetGain) + wet[i * numLanes] * wetGain;
+        }
+    }
+
+    //==============================================================================
+    static constexpr double minFrequency = 20.0;
+
+    Parameters parameters;
+    double sampleRate = 44100.0;
+    double maxFrequency = 20000.0;
+
+    std::vector<Lanes> frames;          // The chunk, one frame of both channels per register
+    Lanes states[maxStages];
+    Lanes lastOutput;
+
+    double phase = 0.0;                 // LFO phase at the last control point
+    double phaseIncrement = 0.0;        // Per control interval
+    int countdown = 0;                  // Samples left until the next control point
+    float coefficient = 0.0f;           // Current a, stepped every sample
+    float coefficientStep = 0.0f;
+
+    float depthTarget = 0.25f, centreTarget = 0.0f, feedbackTarget = 0.0f, mixTarget = 0.5f;
+    SmoothedParameter depth, centre, feedback, mix;
+};
@@ -0,0 +1,66 @@
+/*******************************************************************************
+
+ name:             PluginList
+ description:      every current plugin processor, by name.
+
+ Includes the latest version of each plugin header and maps a short name to a
+ factory, so tools that drive the processors directly (the benchmark and the
+ chain host) do not need to know the class names. When a plugin gets a new
+ version, point its include here at the new header.
+
+*******************************************************************************/
+
+#pragma once
+
+#include "../CabinetPlugin/CabinetPlugin.h"
+#include "../ChorusPlugin/ChorusV5/ChorusPlugin.h"
+#include "../CompressionPlugin/CompressionPlugin.h"
+#include "../DelayPlugin/DelayPluginV3/DelayPluginV3.h"
+#include "../DistortionPlugin/DistortionPlugin.h"
+#include "../EchoPlugin/EchoPlugin.h"
+#include "../EnvelopePlugin/EnvelopePlugin.h"
+#include "../FlangerPlugin/FlangerV3/FlangerPlugin.h"
+#include "../FunDistortionPlugin/FunDistortionPlugin.h"
+#include "../FuzzPlugin/FuzzPlugin.h"
+#include "../GainPlugin/GainPlugin.h"
+#include "../PassThru/PassThru.h"
+#include "../PhaserPlugin/PhaserPlugin.h"
+#include "../ReverbPlugin/ReverbPlugin.h"
+#include "../SaturationPlugin/SaturationPlugin.h"
+#include "../TremoloPlugin/TremoloPluginV6/TremoloPluginV6.h"
+
+
+//==============================================================================
+struct PluginInfo
+{
+    juce::String name;
+    juce::String directory; // Folder of the plugin in this repository, which board files use in their URIs
+    std::function<std::unique_ptr<juce::AudioProcessor>()> create;
+};
+
+template <typename ProcessorType>
+PluginInfo makePluginInfo (const juce::String& name, const juce::String& directory)
+{
+    return { name, directory, [] { return std::unique_ptr<juce::AudioProcessor> (new ProcessorType()); } };
+}
+
+// All plugins, in alphabetical order
+inline std::vector<PluginInfo> getAllPlugins()
+{
+    return { makePluginInfo<CabinetProcessor>       ("Cabinet",        "CabinetPlugin"),
+             makePluginInfo<ChorusProcessor>        ("Chorus",         "ChorusPlugin"),
+             makePluginInfo<CompressorProcessor>    ("Compression",    "CompressionPlugin"),
+             makePluginInfo<DelayProcessor>         ("Delay",          "DelayPlugin"),
+             makePluginInfo<DistortionProcessor>    ("Distortion",     "DistortionPlugin"),
+             makePluginInfo<EchoProcessor>          ("Echo",           "EchoPlugin"),
+             makePluginInfo<EnvelopeProcessor>      ("Envelope",       "EnvelopePlugin"),
+             makePluginInfo<FlangerProcessor>       ("Flanger",        "FlangerPlugin"),
+             makePluginInfo<FunDistortionProcessor> ("FunDistortion",  "FunDistortionPlugin"),
+             makePluginInfo<FuzzProcessor>          ("Fuzz",           "FuzzPlugin"),
+             makePluginInfo<GainProcessor>          ("Gain",           "GainPlugin"),
+             makePluginInfo<PassThruProcessor>      ("PassThru",       "PassThru"),
+             makePluginInfo<PhaserProcessor>        ("Phaser",         "PhaserPlugin"),
+             makePluginInfo<ReverbProcessor>        ("Reverb",         "ReverbPlugin"),
+             makePluginInfo<SaturationProcessor>    ("Saturation",     "SaturationPlugin"),
+             makePluginInfo<TremoloProcessor>       ("Tremolo",        "TremoloPlugin") };
+}
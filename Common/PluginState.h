@@ -0,0 +1,207 @@
+/*******************************************************************************
+
+ name:             PluginState
+ description:      versioned binary state shared by every plugin's
+                   getStateInformation and setStateInformation.
+
+ The plugins used to write each parameter through its own MemoryOutputStream
+ and read each one through a new MemoryInputStream at offset 0, so every
+ parameter was restored from the first field. Here the whole state is
+ written and read in one pass over the block, with a fixed little-endian
+ layout:
+
+   header    uint32 magic "PBST", uint16 version, uint16 number of entries
+   entries   uint32 parameter ID hash, float32 value in real units
+
+ Entries are matched to parameters by a 32-bit FNV-1a hash of the parameter
+ ID, not by position. Parameters added to a plugin later keep their default
+ when an older state is loaded, and entries of parameters that no longer
+ exist are skipped. Values are stored in real units (the range the
+ parameter was declared with), so a state survives a change of range as
+ well as it can.
+
+ Blobs without the magic number are the old format: one 4-byte field per
+ parameter in declaration order, writeInt() for AudioParameterInt and
+ writeFloat() for the others. Every plugin wrote them in that order, so they
+ are migrated by position.
+
+ Saving only allocates if destData has to grow, and loading never does, so
+ a preset can be recalled from a footswitch without touching the heap.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+namespace PluginState
+{
+    constexpr juce::uint32 magic = 0x54534250;          // "PBST" in little-endian byte order
+    constexpr juce::uint16 currentVersion = 1;
+
+    constexpr size_t headerSize = 8;
+    constexpr size_t entrySize = 8;
+
+    namespace detail
+    {
+        inline juce::uint32 readUInt32 (const char* source) noexcept
+        {
+            juce::uint32 value;
+            std::memcpy (&value, source, sizeof (value));
+            return juce::ByteOrder::swapIfBigEndian (value);
+        }
+
+        inline juce::uint16 readUInt16 (const char* source) noexcept
+        {
+            juce::uint16 value;
+            std::memcpy (&value, source, sizeof (value));
+            return juce::ByteOrder::swapIfBigEndian (value);
+        }
+
+        inline float readFloat (const char* source) noexcept
+        {
+            const auto bits = readUInt32 (source);
+            float value;
+            std::memcpy (&value, &bits, sizeof (value));
+            return value;
+        }
+
+        inline void writeUInt32 (char* dest, juce::uint32 value) noexcept
+        {
+            value = juce::ByteOrder::swapIfBigEndian (value);
+            std::memcpy (dest, &value, sizeof (value));
+        }
+
+        inline void writeUInt16 (char* dest, juce::uint16 value) noexcept
+        {
+            value = juce::ByteOrder::swapIfBigEndian (value);
+            std::memcpy (dest, &value, sizeof (value));
+        }
+
+        inline void writeFloat (char* dest, float value) noexcept
+        {
+            juce::uint32 bits;
+            std::memcpy (&bits, &value, sizeof (bits));
+            writeUInt32 (dest, bits);
+        }
+
+        // Sets a parameter from a value in real units
+        inline void setPlainValue (juce::AudioProcessorParameter& parameter, float value)
+        {
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (&parameter))
+                parameter.setValueNotifyingHost (juce::jlimit (0.0f, 1.0f, ranged->convertTo0to1 (value)));
+            else
+                parameter.setValueNotifyingHost (juce::jlimit (0.0f, 1.0f, value));
+        }
+
+        inline float getPlainValue (const juce::AudioProcessorParameter& parameter)
+        {
+            if (auto* ranged = dynamic_cast<const juce::RangedAudioParameter*> (&parameter))
+                return ranged->convertFrom0to1 (parameter.getValue());
+
+            return parameter.getValue();
+        }
+    }
+
+    //==============================================================================
+    // 32-bit FNV-1a of the parameter ID's UTF-8 bytes. Part of the format, so it must never change.
+    inline juce::uint32 hashParameterID (const juce::String& parameterID) noexcept
+    {
+        juce::uint32 hash = 2166136261u;
+
+        for (auto* c = parameterID.toRawUTF8(); *c != 0; ++c)
+        {
+            hash ^= (juce::uint8) *c;
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    inline juce::uint32 hashParameterID (const juce::AudioProcessorParameter& parameter)
+    {
+        if (auto* ranged = dynamic_cast<const juce::RangedAudioParameter*> (&parameter))
+            return hashParameterID (ranged->getParameterID());
+
+        // Parameters without an ID can only be told apart by position
+        return (juce::uint32) parameter.getParameterIndex();
+    }
+
+    //==============================================================================
+    // Writes every parameter of the processor to destData, replacing its contents
+    inline void save (const juce::AudioProcessor& processor, juce::MemoryBlock& destData)
+    {
+        const auto& parameters = processor.getParameters();
+        const auto numEntries = (juce::uint16) juce::jmin ((int) parameters.size(), 0xffff);
+
+        destData.setSize (headerSize + (size_t) numEntries * entrySize);
+        auto* dest = static_cast<char*> (destData.getData());
+
+        detail::writeUInt32 (dest, magic);
+        detail::writeUInt16 (dest + 4, currentVersion);
+        detail::writeUInt16 (dest + 6, numEntries);
+        dest += headerSize;
+
+        for (int i = 0; i < (int) numEntries; ++i, dest += entrySize)
+        {
+            detail::writeUInt32 (dest, hashParameterID (*parameters[i]));
+            detail::writeFloat (dest + 4, detail::getPlainValue (*parameters[i]));
+        }
+    }
+
+    //==============================================================================
+    // Restores the parameters from a block written by save() or by the old per-field streams.
+    // Returns false, leaving every parameter as it was, if the block is neither.
+    inline bool load (juce::AudioProcessor& processor, const void* data, int sizeInBytes)
+    {
+        const auto& parameters = processor.getParameters();
+        const auto* source = static_cast<const char*> (data);
+        const auto size = (size_t) juce::jmax (0, sizeInBytes);
+
+        if (source == nullptr)
+            return false;
+
+        if (size >= headerSize && detail::readUInt32 (source) == magic)
+        {
+            const auto version = detail::readUInt16 (source + 4);
+            const auto numEntries = (size_t) detail::readUInt16 (source + 6);
+
+            // A newer version may have changed the entry layout, and a short block was cut off
+            if (version == 0 || version > currentVersion || size < headerSize + numEntries * entrySize)
+                return false;
+
+            for (size_t entry = 0; entry < numEntries; ++entry)
+            {
+                const auto* field = source + headerSize + entry * entrySize;
+                const auto hash = detail::readUInt32 (field);
+
+                for (auto* parameter : parameters)
+                {
+                    if (hashParameterID (*parameter) == hash)
+                    {
+                        detail::setPlainValue (*parameter, detail::readFloat (field + 4));
+                        break;
+                    }
+                }
+            }
+
+            return true;
+        }
+
+        // The old format has no header, so all that can be checked is that the fields fit the parameters
+        if (size == 0 || size % 4 != 0 || size / 4 > (size_t) parameters.size())
+            return false;
+
+        for (int i = 0; i < (int) (size / 4); ++i)
+        {
+            const auto* field = source + (size_t) i * 4;
+
+            if (dynamic_cast<juce::AudioParameterInt*> (parameters[i]) != nullptr)
+                detail::setPlainValue (*parameters[i], (float) (juce::int32) detail::readUInt32 (field));
+            else
+                detail::setPlainValue (*parameters[i], detail::readFloat (field));
+        }
+
+        return true;
+    }
+}
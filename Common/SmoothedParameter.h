@@ -0,0 +1,112 @@
+/*******************************************************************************
+
+ name:             SmoothedParameter
+ description:      block-aware parameter smoother with a settled fast path.
+
+ Parameters are read once per block. Stepping straight to the new value causes
+ zipper noise, but smoothing every parameter on every sample costs CPU on every
+ pedal even when nothing is moving. update() is called once per block with the
+ parameter value: while a ramp is active it lays out one value per sample for
+ that block, and once the ramp has finished isSmoothing() returns false so the
+ caller can use getTargetValue() as a plain constant.
+
+ The values of a block are computed once and then shared by every channel, so
+ all channels see the same ramp.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+class SmoothedParameter
+{
+public:
+    //==============================================================================
+    // Allocates the per-sample buffer and jumps to initialValue. Must be called from prepareToPlay.
+    void prepare (double sampleRate, int maximumBlockSize, float initialValue, double rampLengthInSeconds = 0.05)
+    {
+        rampLength = juce::jmax (0, juce::roundToInt (sampleRate * rampLengthInSeconds));
+        values.assign ((size_t) juce::jmax (1, maximumBlockSize), initialValue);
+        setCurrentAndTargetValue (initialValue);
+    }
+
+    // Jumps to newValue without a ramp
+    void setCurrentAndTargetValue (float newValue) noexcept
+    {
+        current = target = newValue;
+        countdown = 0;
+        smoothing = false;
+    }
+
+    //==============================================================================
+    // Called once per block, before any channel is processed, with the parameter's current value
+    void update (float newTarget, int numSamples) noexcept
+    {
+        if (newTarget != target)
+        {
+            target = newTarget;
+            countdown = rampLength;
+            step = countdown > 0 ? (target - current) / (float) countdown : 0.0f;
+        }
+
+        // Blocks larger than the prepared size cannot be laid out, so they jump straight to the target
+        if (countdown == 0 || numSamples > (int) values.size())
+        {
+            setCurrentAndTargetValue (target);
+            return;
+        }
+
+        smoothing = true;
+
+        const int rampSamples = juce::jmin (countdown, numSamples);
+
+        for (int sample = 0; sample < rampSamples; ++sample)
+            values[(size_t) sample] = current + step * (float) (sample + 1);
+
+        std::fill (values.begin() + rampSamples, values.begin() + numSamples, target);
+
+        countdown -= rampSamples;
+        current = countdown == 0 ? target : current + step * (float) rampSamples;
+    }
+
+    //==============================================================================
+    // True if the value changes within the current block
+    bool isSmoothing() const noexcept                           { return smoothing; }
+
+    // The value every sample of the current block has when isSmoothing() is false
+    float getTargetValue() const noexcept                       { return target; }
+
+    // Value of one sample of the current block, for loops that do not vectorize anyway
+    float getValue (int sample) const noexcept                  { return smoothing ? values[(size_t) sample] : target; }
+
+    // Value of one sample of the current block, for kernels instantiated once for each path
+    template <bool isRamping>
+    float get (int sample) const noexcept
+    {
+        if constexpr (isRamping)
+            return values[(size_t) sample];
+        else
+            return target;
+    }
+
+    //==============================================================================
+    // Multiplies numSamples samples of data by the value, starting at sample firstSample of the block
+    void applyGain (float* data, int numSamples, int firstSample = 0) const noexcept
+    {
+        if (smoothing)
+            juce::FloatVectorOperations::multiply (data, values.data() + firstSample, numSamples);
+        else
+            juce::FloatVectorOperations::multiply (data, target, numSamples);
+    }
+
+private:
+    //==============================================================================
+    std::vector<float> values;  // Per-sample values of the current block, valid while smoothing
+    float current = 0.0f;       // Value reached at the end of the last block
+    float target = 0.0f;
+    float step = 0.0f;          // Change per sample while ramping
+    int countdown = 0;          // Samples left in the ramp
+    int rampLength = 0;
+    bool smoothing = false;
+};
@@ -20,6 +20,10 @@
 
 #pragma once
 
+#include "CompressorEngine.h"
+#include "LFOShapes.h"
+#include "PluginState.h"
+
 
 //==============================================================================
 class CompressorProcessor final : public juce::AudioProcessor
@@ -46,16 +50,14 @@ public:
     void prepareToPlay (double samplerate, int samplesPerBlock) override 
     {
 	    // initialize the processor and set initial parameter values
-        juce::dsp::ProcessSpec spec { samplerate, static_cast<uint32_t>(samplesPerBlock), static_cast<uint32_t>(getTotalNumOutputChannels()) };
-	    compressor.prepare(spec);
-	    compressor.setAttack(10.0f);
-	    compressor.setRelease(100.0f);
-	    compressor.setThreshold(-20.0f);
-	    compressor.setRatio(3.0f);
+	    compressor.prepare(getTotalNumOutputChannels(), samplerate, samplesPerBlock);
+	    compressor.setTimes(attack->get(), release->get());
+	    compressor.setRatio(ratio->get());
 	    
-	    lfo.initialise([](float x) { return std::sin(x); }, 256 );
-	    rate = thresModFreq->get();
-	    lfo.setFrequency(rate);
+	    // the modulated threshold is laid out one value per sample, so it never steps
+	    lfo.prepare(samplerate);
+	    lfo.setFrequency(thresModFreq->get());
+	    thresholds.resize((size_t) juce::jmax(1, samplesPerBlock));
     }
     
     // This function is usually called after the plugin stops taking in audio. It can deallocate any memory used and clean out buffers
@@ -64,33 +66,37 @@ public:
     // This is where all the audio processing happens. One block of audio input is handled at a time.
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
-        juce::dsp::AudioBlock<float> block (buffer);
-	    juce::dsp::ProcessContextReplacing<float> context (block);
-	
 	    // read the values of the parameters in from the GUI
-	    auto attackValue = attack->get();
-	    auto releaseValue = release->get();
 	    auto thresholdValue = threshold->get();
-	    auto ratioValue = ratio->get();
 	    auto thresModBool = thresMod->get();
-	    auto freq = thresModFreq->get();
 	    
-	    lfo.setFrequency(freq);
-	    float lfoDepth = 2.0f;
-	    float lfoVal = (lfo.processSample(0.0f)+1.0f)*lfoDepth;
-	    float modThres = juce::jmap(lfoVal, -1.0f, 1.0f, -50.0f, 5.0f)*lfoDepth;
-
-	    // update parameters and apply them to the audio block with process()
-	    compressor.setAttack(attackValue);
-	    compressor.setRelease(releaseValue);
-	    if(thresModBool) {
-	        compressor.setThreshold(modThres);
+	    // update parameters, the envelope coefficients are only recomputed when attack or release change
+	    compressor.setTimes(attack->get(), release->get());
+	    compressor.setRatio(ratio->get());
+	    lfo.setFrequency(thresModFreq->get());
+	    
+	    if(! thresModBool) {
+	        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+	            compressor.process(channel, buffer.getWritePointer(channel), buffer.getNumSamples(), thresholdValue);
+	        
+	        return;
 	    }
-	    else {
-	        compressor.setThreshold(thresholdValue);
+	    
+	    // the threshold follows the LFO between -50 and 5 dB, one value per sample shared by both channels. At 20 Hz at most,
+	    // the sine evaluated every lfoInterval samples and interpolated is within 0.01 dB of the exact curve
+	    const int chunkSize = (int) thresholds.size();
+	    
+	    for (int start = 0; start < buffer.getNumSamples(); start += chunkSize) {
+	        const int length = juce::jmin(chunkSize, buffer.getNumSamples() - start);
+	        
+	        lfo.renderInterpolated<LFOShape::Sine>(thresholds.data(), length, lfoInterval);
+	        
+	        for (int sample = 0; sample < length; ++sample)
+	            thresholds[(size_t) sample] = juce::jmap(thresholds[(size_t) sample], -1.0f, 1.0f, -50.0f, 5.0f);
+	        
+	        for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+	            compressor.process(channel, buffer.getWritePointer(channel) + start, length, thresholds.data());
 	    }
-	    compressor.setRatio(ratioValue);
-	    compressor.process(context);
     }
 
     //==============================================================================
@@ -122,23 +128,13 @@ public:
     // in the next session of running the pedal
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	    juce::MemoryOutputStream (destData, true).writeFloat (*attack);
-	    juce::MemoryOutputStream (destData, true).writeFloat (*release);
-	    juce::MemoryOutputStream (destData, true).writeFloat (*threshold);
-	    juce::MemoryOutputStream (destData, true).writeFloat (*ratio);
-	    juce::MemoryOutputStream (destData, true).writeInt (*thresMod);
-	    juce::MemoryOutputStream (destData, true).writeFloat (*thresModFreq);
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-	    attack->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	    release->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	    threshold->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	    ratio->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	    thresMod->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readInt());
-	    thresModFreq->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -153,8 +149,10 @@ public:
 
 private:
     //==============================================================================
-    juce::dsp::Compressor<float> compressor;
-    juce::dsp::Oscillator<float> lfo;
+    CompressorEngine compressor;
+    LFOPhase lfo;
+    std::vector<float> thresholds; // modulated threshold in dB, one value per sample of the current chunk
+    static constexpr int lfoInterval = 16;
     
     juce::AudioParameterFloat* attack; //the attack time in milliseconds of the compressor
     juce::AudioParameterFloat* release; //the release time in milliseconds of the compressor
@@ -162,9 +160,6 @@ private:
     juce::AudioParameterFloat* ratio; //the ratio of the compressor (must be higher or equal to 1)
     juce::AudioParameterInt* thresMod;
     juce::AudioParameterFloat* thresModFreq;
-    
-    juce::AudioParameterFloat* lfoRate;
-    float rate;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (CompressorProcessor)
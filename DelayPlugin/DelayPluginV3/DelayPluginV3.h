@@ -52,6 +52,10 @@
 
 #pragma once
 
+#include "DelayMemory.h"
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
 
 //==============================================================================
 class DelayProcessor final : public juce::AudioProcessor
@@ -67,78 +71,62 @@ public:
         addParameter (delay = new juce::AudioParameterFloat ({ "delay", 1 }, "Delay", 0.001f, 1.0f, 0.1f)); // Delay is in seconds
         addParameter (feedback = new juce::AudioParameterFloat ({ "feedback", 1 }, "Feedback", 0.0f, 1.0f, 0.2f));
         addParameter (mix = new juce::AudioParameterFloat ({ "mix", 1 }, "Mix", 0.0f, 1.0f, 0.5f));
+        addParameter (history = new juce::AudioParameterInt ({ "history", 1 }, "History (Float/16-bit/bfloat16)", 0, 2, 0)); // Takes effect when playback is next prepared
     }
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override
     {
-        // Sets specs for a JUCE DSP processor
-        juce::dsp::ProcessSpec spec;
-        spec.maximumBlockSize = samplesPerBlock;
-        spec.sampleRate = sampleRate;
-        spec.numChannels = getTotalNumOutputChannels();
-        
-        // Initializes delay line processors
-        delayCHNL1.prepare (spec);
-        delayCHNL2.prepare (spec);
-        
-        // Since the delay parameter is limited to a maximum of 1s, the maximum possible delay in samples is sampleRate in samples/s * 1s
-        delayCHNL1.setMaximumDelayInSamples (sampleRate);
-        delayCHNL2.setMaximumDelayInSamples (sampleRate);
+        // One ring per channel. Since the delay parameter is limited to a maximum of 1s, the maximum possible delay in samples is sampleRate in samples/s * 1s
+        delayHistory.prepare (getTotalNumOutputChannels(), (int) sampleRate, (DelayMemory::Format) history->get());
+        allpassState.fill (0.0f);
         
-        // Delay in seconds is converted to delay in samples
-        delayFloat = delay->get();
-        delayCHNL1.setDelay (delayFloat * sampleRate);
-        delayCHNL2.setDelay (delayFloat * sampleRate);
+        // Mix and gain glide to new values instead of stepping once per block
+        smoothedMix.prepare (sampleRate, samplesPerBlock, mix->get());
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
     }
     
     void releaseResources() override {}
 
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
-        gainFloat = gain->get();
         delayFloat = delay->get();
         feedbackFloat = feedback->get();
-        mixFloat = mix->get();
+        
+        smoothedMix.update (mix->get(), buffer.getNumSamples());
+        smoothedGain.update (gain->get(), buffer.getNumSamples());
         
         sampleRate = this->getSampleRate();
         totalNumInputChannels  = getTotalNumInputChannels();
         
-        delayCHNL1.setDelay (delayFloat * sampleRate);
-        delayCHNL2.setDelay (delayFloat * sampleRate);
+        setThiranDelay (delayFloat * (float) sampleRate);
         
-        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+        // Handles the second channel for stereo input but doesn't run for mono input
+        for (int channel = 0; channel < juce::jmin (totalNumInputChannels, delayHistory.getNumChannels()); ++channel)
         {
             auto* channelData = buffer.getWritePointer (channel);
             
-            if (channel == 0)
+            // The storage format is resolved once per channel, the loop is compiled for each format
+            delayHistory.withChannel (channel, [&] (auto ring)
             {
+                auto& state = allpassState[(size_t) channel];
+                
                 for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
                 {
                     drySample = channelData[sample];
-                    wetSample = delayCHNL1.popSample(channel, -1, true); // Second argument of popSample is -1 to use value from setDelay function
-                    
-                    // No feedback currently for testing purposes
-                    delayCHNL1.pushSample(channel, channelData[sample]);//delayCHNL1.pushSample(channel, drySample + wetSample * feedbackFloat);//delayCHNL1.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
                     
-                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat); // Mix dry sample with delayed sample
-                    channelData[sample] *= gainFloat; // Gain
-                }
-            }
-            else // Handles the second channel for stereo input but doesn't run for mono input
-            {
-                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                {    
-                    drySample = channelData[sample];
-                    wetSample = delayCHNL2.popSample(channel, -1, true);
+                    // Thiran all-pass interpolation between the two samples around the delay, as juce::dsp::DelayLine does
+                    wetSample = ring.read (delayInt + 1) + alpha * (ring.read (delayInt) - state);
+                    state = wetSample;
                     
                     // No feedback currently for testing purposes
-                    delayCHNL2.pushSample(channel, channelData[sample]);//delayCHNL2.pushSample(channel, drySample + wetSample * feedbackFloat);//delayCHNL2.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
+                    ring.push (drySample);//ring.push (drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
                     
-                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat);
-                    channelData[sample] *= gainFloat;
+                    mixFloat = smoothedMix.getValue (sample);
+                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat); // Mix dry sample with delayed sample
+                    channelData[sample] *= smoothedGain.getValue (sample); // Gain
                 }
-            }
+            });
         }
     }
 
@@ -162,18 +150,12 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-        juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeFloat (*delay);
-        juce::MemoryOutputStream (destData, true).writeFloat (*feedback);
-        juce::MemoryOutputStream (destData, true).writeFloat (*mix);
+        PluginState::save (*this, destData);
     }
 
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        delay->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        feedback->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        mix->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -186,13 +168,31 @@ public:
     }
 
 private:
+    //==============================================================================
+    // Splits the delay into whole samples and an all-pass coefficient. The fraction is kept between 0.618 and 1.618,
+    // where the first-order Thiran all-pass is stable and its group delay is flattest.
+    void setThiranDelay (float delayInSamples)
+    {
+        const auto delayLimited = juce::jlimit (0.0f, (float) delayHistory.getMaximumDelayInSamples(), delayInSamples);
+        delayInt = (int) delayLimited;
+        auto delayFrac = delayLimited - (float) delayInt;
+        
+        if (delayFrac < 0.618f && delayInt >= 1)
+        {
+            delayFrac += 1.0f;
+            delayInt -= 1;
+        }
+        
+        alpha = (1.0f - delayFrac) / (1.0f + delayFrac);
+    }
+    
     //==============================================================================
     juce::AudioParameterFloat* gain;
     juce::AudioParameterFloat* delay;
     juce::AudioParameterFloat* feedback;
     juce::AudioParameterFloat* mix;
+    juce::AudioParameterInt* history;
     
-    float gainFloat;
     float delayFloat;
     float feedbackFloat;
     float mixFloat;
@@ -202,8 +202,14 @@ private:
     double sampleRate;
     int totalNumInputChannels;
     
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Thiran> delayCHNL1;
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Thiran> delayCHNL2;
+    int delayInt = 0;
+    float alpha = 0.0f;
+    
+    DelayMemory delayHistory;
+    std::array<float, 2> allpassState {}; // Last all-pass output, per channel
+    
+    SmoothedParameter smoothedMix;
+    SmoothedParameter smoothedGain;
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DelayProcessor)
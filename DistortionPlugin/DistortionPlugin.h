@@ -20,9 +20,15 @@
 
 #pragma once
 
+#include "AntiderivativeWaveshaper.h"
+#include "OversampledWaveshaper.h"
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
 
 //==============================================================================
-class DistortionProcessor final : public juce::AudioProcessor
+class DistortionProcessor final : public juce::AudioProcessor,
+                                  private juce::AsyncUpdater
 {
 public:
 
@@ -34,11 +40,27 @@ public:
     {
         addParameter (gain = new juce::AudioParameterFloat ({ "gain", 1 }, "Gain", 0.0f, 3.0f, 1.0f));
         addParameter (di = new juce::AudioParameterFloat({ "di", 1 }, "Distortion Intensity", 5.0f, 50.0f, 30.0f));
+        addParameter (oversampling = new juce::AudioParameterInt ({ "oversampling", 1 }, "Oversampling (1x/2x/4x/8x)", 0, OversampledWaveshaper::maxFactorLog2, 2));
+        addParameter (filter = new juce::AudioParameterInt ({ "filter", 1 }, "Oversampling Filter (IIR/FIR)", 0, 1, OversampledWaveshaper::iir));
+        addParameter (antialiasing = new juce::AudioParameterInt ({ "antialiasing", 1 }, "Antialiasing (Off/ADAA1/ADAA2)", 0, 2, AntiderivativeWaveshaper::off));
     }
 
     //==============================================================================
     // This function is used before audio processing. It lets you initialize variables and set up any other resources prior to running the plugin
-    void prepareToPlay (double, int) override {}
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        // gain and intensity glide to new values instead of jumping once per block
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
+        smoothedDi.prepare (sampleRate, samplesPerBlock, di->get());
+
+        // the clipper runs oversampled so its harmonics are filtered out instead of aliasing
+        waveshaper.prepare (getTotalNumOutputChannels(), samplesPerBlock);
+        adaa.prepare (getTotalNumOutputChannels());
+        waveshaper.setOversampling (oversampling->get(), filter->get());
+        adaa.setOrder (antialiasing->get());
+        latency = waveshaper.getLatencyInSamples (adaa.getLatencyInSamples());
+        setLatencySamples (latency);
+    }
     // This function is usually called after the plugin stops taking in audio. It can deallocate any memory used and clean out buffers
     void releaseResources() override {}
 
@@ -46,17 +68,30 @@ public:
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
         
-        auto gainValue = gain->get();
-        auto diValue = di->get();
+        smoothedGain.update (gain->get(), buffer.getNumSamples());
+        smoothedDi.update (di->get(), buffer.getNumSamples());
+        
+        waveshaper.setOversampling (oversampling->get(), filter->get());
+        adaa.setOrder (antialiasing->get());
+        
+        // The host is told about a new latency from the message thread, never from here
+        const int newLatency = waveshaper.getLatencyInSamples (adaa.getLatencyInSamples());
+        
+        if (latency.exchange (newLatency) != newLatency)
+            triggerAsyncUpdate();
         
         for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
             auto* channelData = buffer.getWritePointer(channel);
-            for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-                float processedSample = channelData[sample] * gainValue; // applying gain
-                processedSample = copysign((1-1/(abs(diValue*processedSample)+1)), processedSample); // apply reciprocal clipping function
-                channelData[sample] = processedSample;
-            }
+            
+            // the intensity is a positive gain in front of the clipping function, so both gains are applied to the whole block first
+            smoothedGain.applyGain (channelData, buffer.getNumSamples()); // applying gain
+            smoothedDi.applyGain (channelData, buffer.getNumSamples());
         }
+        
+        // apply reciprocal clipping function, copysign(1-1/(|x|+1), x), optionally antialiased
+        waveshaper.processChannels (buffer, [this] (int channel, float* channelData, int numSamples, int) {
+            adaa.process<ClippingCurve::Reciprocal> (channel, channelData, numSamples, [] (int) { return 0.0f; });
+        });
     }
 
     //==============================================================================
@@ -94,15 +129,13 @@ public:
     // in the next session of running the pedal
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeFloat (*di);
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        di->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -117,9 +150,26 @@ public:
     }
 
 private:
+    //==============================================================================
+    // Reports the latency processBlock() last switched to
+    void handleAsyncUpdate() override
+    {
+        setLatencySamples (latency.load());
+    }
+    
     //==============================================================================
     juce::AudioParameterFloat* gain;
     juce::AudioParameterFloat* di;
+    juce::AudioParameterInt* oversampling;
+    juce::AudioParameterInt* filter;
+    juce::AudioParameterInt* antialiasing;
+    
+    SmoothedParameter smoothedGain;
+    SmoothedParameter smoothedDi;
+    
+    OversampledWaveshaper waveshaper;
+    AntiderivativeWaveshaper adaa;
+    std::atomic<int> latency { 0 }; // Of the settings in use, in samples
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (DistortionProcessor)
@@ -52,6 +52,9 @@
 
 #pragma once
 
+#include "MultiTapDelay.h"
+#include "PluginState.h"
+
 
 //==============================================================================
 class EchoProcessor final : public juce::AudioProcessor
@@ -67,214 +70,52 @@ public:
         addParameter (delay = new juce::AudioParameterFloat ({ "delay", 1 }, "Delay", 0.001f, 1.0f, 0.1f)); // Delay is in seconds
         addParameter (feedback = new juce::AudioParameterFloat ({ "feedback", 1 }, "Feedback", 0.0f, 1.0f, 0.2f));
         addParameter (mix = new juce::AudioParameterFloat ({ "mix", 1 }, "Mix", 0.0f, 1.0f, 0.3f));
-        addParameter (echo = new juce::AudioParameterInt ({ "echo", 1 }, "Amount of Echoes", 0, 4, 2)); // Zero echoes is pass-through
+        addParameter (echo = new juce::AudioParameterInt ({ "echo", 1 }, "Amount of Echoes", 0, maxEchoes, 2)); // Zero echoes is pass-through
+        addParameter (history = new juce::AudioParameterInt ({ "history", 1 }, "History (Float/16-bit/bfloat16)", 0, 2, 0)); // Takes effect when playback is next prepared
     }
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override
     {
-        // Sets specs for a JUCE DSP processor
-        juce::dsp::ProcessSpec spec;
-        spec.maximumBlockSize = samplesPerBlock;
-        spec.sampleRate = sampleRate;
-        spec.numChannels = getTotalNumOutputChannels();
-        
-        // Initializes delay line processors
-        delayCHNL1.prepare (spec);
-        delayCHNL2.prepare (spec);
-        
         // Since the delay parameter is limited to a maximum of 1s, the maximum possible delay in samples is sampleRate in samples/s * 1s
-        delayCHNL1.setMaximumDelayInSamples (sampleRate);
-        delayCHNL2.setMaximumDelayInSamples (sampleRate);
+        echoDelay.prepare (getTotalNumOutputChannels(), (int) sampleRate, samplesPerBlock, (DelayMemory::Format) history->get());
         
-        // Delay in seconds is converted to delay in samples
-        delayFloat = delay->get();
-        delayCHNL1.setDelay (delayFloat * sampleRate);
-        delayCHNL2.setDelay (delayFloat * sampleRate);
+        // Feedback, mix and gain glide to new values instead of stepping once per block
+        smoothedFeedback.prepare (sampleRate, samplesPerBlock, feedback->get());
+        smoothedMix.prepare (sampleRate, samplesPerBlock, mix->get());
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
     }
     
     void releaseResources() override {}
 
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
-        gainFloat = gain->get();
         delayFloat = delay->get();
-        feedbackFloat = feedback->get();
-        mixFloat = mix->get();
         echoInt = echo->get();
         
         sampleRate = this->getSampleRate();
         totalNumInputChannels  = getTotalNumInputChannels();
         
-        delayCHNL1.setDelay (delayFloat * sampleRate);
-        delayCHNL2.setDelay (delayFloat * sampleRate);
+        smoothedFeedback.update (feedback->get(), buffer.getNumSamples());
+        smoothedMix.update (mix->get(), buffer.getNumSamples());
+        smoothedGain.update (gain->get(), buffer.getNumSamples());
         
-        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+        if (echoInt == 0) // Pass-Through
+            return;
+        
+        // Echo k of n sits at k/n of the delay time and its weight falls off linearly, with all weights summing to 1
+        // (n = 4 gives delays of 0.25, 0.5, 0.75 and 1 times the delay and weights of 0.4, 0.3, 0.2 and 0.1)
+        for (int tap = 0; tap < echoInt; ++tap)
         {
-            auto* channelData = buffer.getWritePointer (channel);
-            
-            switch(echoInt)
-            {
-                case 1: // 1 Echo
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            delayInSamples1 = sampleRate * delayFloat;
-
-                            wetSample1 = delayCHNL1.popSample(channel, delayInSamples1, true);
-                            
-                            drySample = channelData[sample];
-                            
-                            delayCHNL1.pushSample(channel, (drySample * (1.0f - feedbackFloat)) + (wetSample1 * feedbackFloat)); // Feedback
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat); // Mix dry sample with wet sample
-                            channelData[sample] *= gainFloat; // Gain
-                        }
-                    }
-                    else // Handles the second channel for stereo input but doesn't run for mono input
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            delayInSamples1 = sampleRate * delayFloat;
-
-                            wetSample1 = delayCHNL2.popSample(channel, delayInSamples1, true);
-                            
-                            drySample = channelData[sample];
-                            
-                            delayCHNL2.pushSample(channel, (drySample * (1.0f - feedbackFloat)) + (wetSample1 * feedbackFloat));
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat);
-                            channelData[sample] *= gainFloat;
-                        }
-                    }
-                    break;
-                    
-                case 2: // 2 Echoes
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            delayInSamples1 = sampleRate * delayFloat * 0.5f;
-                            delayInSamples2 = sampleRate * delayFloat;
-
-                            wetSample1 = delayCHNL1.popSample(channel, delayInSamples1, true);
-                            wetSample2 = delayCHNL1.popSample(channel, delayInSamples2, true);
-                            
-                            drySample = channelData[sample];
-                            
-                            delayCHNL1.pushSample(channel, (drySample * (1.0f - feedbackFloat)) + (wetSample1 * feedbackFloat / 1.5f) + (wetSample2 * feedbackFloat / 3.0f)); // Feedback
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat / 1.5f) + (wetSample2 * mixFloat / 3.0f); // Mix
-                            channelData[sample] *= gainFloat; // Gain
-                        }
-                    }
-                    else
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            delayInSamples1 = sampleRate * delayFloat * 0.5f;
-                            delayInSamples2 = sampleRate * delayFloat;
-
-                            wetSample1 = delayCHNL2.popSample(channel, delayInSamples1, true);
-                            wetSample2 = delayCHNL2.popSample(channel, delayInSamples2, true);
-                            
-                            drySample = channelData[sample];
-                            
-                            delayCHNL2.pushSample(channel, (drySample * (1.0f - feedbackFloat)) + (wetSample1 * feedbackFloat / 1.5f) + (wetSample2 * feedbackFloat / 3.0f));
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat / 1.5f) + (wetSample2 * mixFloat / 3.0f);
-                            channelData[sample] *= gainFloat;
-                        }
-                    }
-                    break;
-                    
-                case 3: // 3 Echoes
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            delayInSamples1 = sampleRate * delayFloat * 1.0f / 3.0f;
-                            delayInSamples2 = sampleRate * delayFloat * 2.0f / 3.0f;
-                            delayInSamples3 = sampleRate * delayFloat;
-
-                            wetSample1 = delayCHNL1.popSample(channel, delayInSamples1, true);
-                            wetSample2 = delayCHNL1.popSample(channel, delayInSamples2, true);
-                            wetSample3 = delayCHNL1.popSample(channel, delayInSamples3, true);
-                            
-                            drySample = channelData[sample];
-                            
-                            delayCHNL1.pushSample(channel, (drySample * (1.0f - feedbackFloat)) + (wetSample1 * feedbackFloat / 2.0f) + (wetSample2 * feedbackFloat / 3.0f) + (wetSample3 * feedbackFloat / 6.0f)); // Feedback
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat / 2.0f) + (wetSample2 * mixFloat / 3.0f) + (wetSample3 * mixFloat / 6.0f); // Mix
-                            channelData[sample] *= gainFloat; // Gain
-                        }
-                    }
-                    else
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            delayInSamples1 = sampleRate * delayFloat * 1.0f / 3.0f;
-                            delayInSamples2 = sampleRate * delayFloat * 2.0f / 3.0f;
-                            delayInSamples3 = sampleRate * delayFloat;
-
-                            wetSample1 = delayCHNL2.popSample(channel, delayInSamples1, true);
-                            wetSample2 = delayCHNL2.popSample(channel, delayInSamples2, true);
-                            wetSample3 = delayCHNL2.popSample(channel, delayInSamples3, true);
-                            
-                            drySample = channelData[sample];
-                            
-                            delayCHNL2.pushSample(channel, (drySample * (1.0f - feedbackFloat)) + (wetSample1 * feedbackFloat / 2.0f) + (wetSample2 * feedbackFloat / 3.0f) + (wetSample3 * feedbackFloat / 6.0f));
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat / 2.0f) + (wetSample2 * mixFloat / 3.0f) + (wetSample3 * mixFloat / 6.0f);
-                            channelData[sample] *= gainFloat;
-                        }
-                    }
-                    break;
-                    
-                case 4: // 4 Echoes
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            delayInSamples1 = sampleRate * delayFloat * 0.25f;
-                            delayInSamples2 = sampleRate * delayFloat * 0.5f;
-                            delayInSamples3 = sampleRate * delayFloat * 0.75f;
-                            delayInSamples4 = sampleRate * delayFloat;
-
-                            wetSample1 = delayCHNL1.popSample(channel, delayInSamples1, true);
-                            wetSample2 = delayCHNL1.popSample(channel, delayInSamples2, true);
-                            wetSample3 = delayCHNL1.popSample(channel, delayInSamples3, true);
-                            wetSample4 = delayCHNL1.popSample(channel, delayInSamples4, true);
-                            
-                            drySample = channelData[sample];
-                            
-                            delayCHNL1.pushSample(channel, (drySample * (1.0f - feedbackFloat)) + (wetSample1 * feedbackFloat * 0.4f) + (wetSample2 * feedbackFloat * 0.3f) + (wetSample3 * feedbackFloat * 0.2f) + (wetSample4 * feedbackFloat * 0.1f)); // Feedback
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat * 0.4f) + (wetSample2 * mixFloat * 0.3f) + (wetSample3 * mixFloat * 0.2f) + (wetSample4 * mixFloat * 0.1f); // Mix
-                            channelData[sample] *= gainFloat; // Gain
-                        }
-                    }
-                    else
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            delayInSamples1 = sampleRate * delayFloat * 0.25f;
-                            delayInSamples2 = sampleRate * delayFloat * 0.5f;
-                            delayInSamples3 = sampleRate * delayFloat * 0.75f;
-                            delayInSamples4 = sampleRate * delayFloat;
-
-                            wetSample1 = delayCHNL2.popSample(channel, delayInSamples1, true);
-                            wetSample2 = delayCHNL2.popSample(channel, delayInSamples2, true);
-                            wetSample3 = delayCHNL2.popSample(channel, delayInSamples3, true);
-                            wetSample4 = delayCHNL2.popSample(channel, delayInSamples4, true);
-                            
-                            drySample = channelData[sample];
-                            
-                            delayCHNL2.pushSample(channel, (drySample * (1.0f - feedbackFloat)) + (wetSample1 * feedbackFloat * 0.4f) + (wetSample2 * feedbackFloat * 0.3f) + (wetSample3 * feedbackFloat * 0.2f) + (wetSample4 * feedbackFloat * 0.1f));
-                            channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample1 * mixFloat * 0.4f) + (wetSample2 * mixFloat * 0.3f) + (wetSample3 * mixFloat * 0.2f) + (wetSample4 * mixFloat * 0.1f);
-                            channelData[sample] *= gainFloat;
-                        }
-                    }
-                    break;
-                    
-                default: // Pass-Through
-                    break;
-            }
+            delayInSamples[tap] = (int) (sampleRate * delayFloat * (float) (tap + 1) / (float) echoInt);
+            tapWeights[tap] = 2.0f * (float) (echoInt - tap) / (float) (echoInt * (echoInt + 1));
         }
+        
+        echoDelay.setTaps (delayInSamples, tapWeights, echoInt);
+        
+        // Taps are constant for the block so each channel is processed as whole spans
+        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+            echoDelay.process (channel, buffer.getWritePointer (channel), buffer.getNumSamples(), smoothedFeedback, smoothedMix, smoothedGain);
     }
 
     //==============================================================================
@@ -297,20 +138,12 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-        juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeFloat (*delay);
-        juce::MemoryOutputStream (destData, true).writeFloat (*feedback);
-        juce::MemoryOutputStream (destData, true).writeFloat (*mix);
-        juce::MemoryOutputStream (destData, true).writeInt (*echo);
+        PluginState::save (*this, destData);
     }
 
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        delay->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        feedback->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        mix->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        echo->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readInt());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -329,29 +162,24 @@ private:
     juce::AudioParameterFloat* feedback;
     juce::AudioParameterFloat* mix;
     juce::AudioParameterInt* echo;
+    juce::AudioParameterInt* history;
     
-    float gainFloat;
     float delayFloat;
-    float feedbackFloat;
-    float mixFloat;
     int echoInt;
     
+    SmoothedParameter smoothedFeedback;
+    SmoothedParameter smoothedMix;
+    SmoothedParameter smoothedGain;
+    
     double sampleRate;
     int totalNumInputChannels;
-    float drySample;
     
-    float wetSample1;
-    float wetSample2;
-    float wetSample3;
-    float wetSample4;
+    static constexpr int maxEchoes = 8;
     
-    int delayInSamples1;
-    int delayInSamples2;
-    int delayInSamples3;
-    int delayInSamples4;
+    int delayInSamples[maxEchoes];
+    float tapWeights[maxEchoes];
     
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Thiran> delayCHNL1;
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Thiran> delayCHNL2;
+    MultiTapDelay echoDelay;
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EchoProcessor)
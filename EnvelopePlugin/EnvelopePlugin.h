@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include "EnvelopeFollower.h"
+#include "PluginState.h"
+
 
 //==============================================================================
 class EnvelopeProcessor final : public juce::AudioProcessor
@@ -37,11 +40,16 @@ public:
 	// addParameter (gain = new juce::AudioParameterFloat ({ "gain", 1 }, "Gain", 0.0f, 2.0f, 0.5f));
 	addParameter (attack = new juce::AudioParameterFloat ({ "attack", 1 }, "Attack", 0.0f, 100.0f, 50.0f));
 	addParameter (release = new juce::AudioParameterFloat ({ "release", 1 }, "Release", 0.0f, 100.0f, 50.0f));
+	addParameter (detector = new juce::AudioParameterInt ({ "detector", 1 }, "Detector (Peak/RMS/Loudness)", 0, 2, EnvelopeFollower::peak));
     }
 
     //==============================================================================
     // This function is used before audio processing. It lets you initialize variables and set up any other resources prior to running the plugin
-    void prepareToPlay (double, int) override {}
+    void prepareToPlay (double sampleRate, int) override
+    {
+        // every channel keeps its envelope from block to block
+        follower.prepare (getTotalNumOutputChannels(), sampleRate);
+    }
     // This function is usually called after the plugin stops taking in audio. It can deallocate any memory used and clean out buffers
     void releaseResources() override {}
 
@@ -51,29 +59,16 @@ public:
         // TODO: Read the value for your parameters in from the GUI using get()
 	// Example:
 	// auto gainValue = gain->get();
-	auto attackValue = attack->get();
-	auto releaseValue = release->get();
-
-	float attackStrength = pow( 0.01, 1.0 / ( attackValue * getSampleRate() * 0.001 ) );
-	float releaseStrength = pow( 0.01, 1.0 / ( releaseValue * getSampleRate() * 0.001 ) );
-	float envelope = 0;
+	// the coefficients are only recomputed when attack or release change
+	follower.setTimes (attack->get(), release->get());
+	follower.setDetector (detector->get());
         
         for (int channel = 0; channel < buffer.getNumChannels(); ++channel) 
         {
             auto* channelData = buffer.getWritePointer(channel);
-            for (int sample = 0; sample < buffer.getNumSamples(); ++sample) 
-            {
-		// TODO: process the audio sample-by-sample here
-                //float processedSample = channelData[sample] * gain;
-		float inputEnvelope = fabsf(channelData[sample]);
-		if (inputEnvelope > envelope)
-			envelope = attackStrength * envelope + (1 - attackStrength) * inputEnvelope;
-		    else
-			envelope = releaseStrength * envelope + (1 - releaseStrength) * inputEnvelope;
-		    
-                // write processed sample back to buffer
-                channelData[sample] = envelope;
-            }
+
+            // the envelope replaces the signal
+            follower.process (channel, channelData, channelData, buffer.getNumSamples());
         }
     }
 
@@ -111,23 +106,17 @@ public:
     //==============================================================================
     // This function saves the current state of each parameter to memory so that we can load the state of each parameter 
     // in the next session of running the pedal
-    // TODO: Save the value of your parameter to memory. Make sure you do this for every one of your parameters.
+    // Every parameter added with addParameter is saved, so there is nothing to add here
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	// Example: 
-	// juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-	juce::MemoryOutputStream (destData, true).writeFloat (*attack);
-	juce::MemoryOutputStream (destData, true).writeFloat (*release);
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
-    // TODO: Read the value into your parameter from memory. Make sure you do this for every one of your parameters.
+    // Parameters missing from an older state keep their current value
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        // Example:
-	// gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	attack->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	release->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -148,6 +137,9 @@ private:
     // juce::AudioParameterFloat* gain;
     juce::AudioParameterFloat* attack;
     juce::AudioParameterFloat* release;
+    juce::AudioParameterInt* detector;
+
+    EnvelopeFollower follower;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (EnvelopeProcessor)
@@ -52,9 +52,15 @@
 
 #pragma once
 
+#include "FlangerEngine.h"
+#include "PerChannelProcessor.h"
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
 
 //==============================================================================
-class FlangerProcessor final : public juce::AudioProcessor
+class FlangerProcessor final : public juce::AudioProcessor,
+                               public PerChannelProcessor
 {
 public:
 
@@ -75,393 +81,60 @@ public:
         
         // Mode 0: Pass-Through, Mode 1: Additive Flanging, Mode 2: Subtractive Flanging, Mode 3: Through-Zero Flanging
         addParameter (flangMode = new juce::AudioParameterInt ({ "flangMode", 1 }, "Flanging Mode", 0, 3, 1));
+        
+        // Linear is the cheapest, Lagrange is flatter at high frequencies, Thiran is flat but rings when the square LFO jumps
+        addParameter (interpolation = new juce::AudioParameterInt ({ "interpolation", 1 }, "Interpolation (Linear/Lagrange/Thiran)", 0, 2, FlangerEngine::linear));
     }
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override
     {  
-        // Sets specs for a JUCE DSP processor
-        juce::dsp::ProcessSpec spec;
-        spec.maximumBlockSize = samplesPerBlock;
-        spec.sampleRate = sampleRate;
-        spec.numChannels = getTotalNumOutputChannels();
-        
-        
-        // Delay Lines
-        
-        // Initializes both delay lines
-        chnl1delay.prepare (spec);
-        chnl2delay.prepare (spec);
-        
-        // Since the delay parameter is limited to a maximum of 0.01s, and based on delayInSamples
-        // which can double the value of the delay parameter based on the LFO, the maximum possible number of samples is sampleRate in samples/s * 0.02s
-        chnl1delay.setMaximumDelayInSamples (sampleRate * 0.02f);
-        chnl2delay.setMaximumDelayInSamples (sampleRate * 0.02f);
-        
-        // Converts delay in seconds to delay in samples and updates delay of both delay lines
-        delayFloat = delay->get();
-        chnl1delay.setDelay (delay->get() * sampleRate);
-        chnl2delay.setDelay (delay->get() * sampleRate);
-        
+        // The delay parameter is limited to a maximum of 0.01s, and the LFO can double it, so the engine keeps 0.02s of history per channel.
+        // The delays are a few milliseconds, so the history is always stored as float.
+        flanger.setParameters (getFlangerParameters());
+        flanger.prepare (sampleRate, samplesPerBlock, getTotalNumOutputChannels(), 0.01);
         
-        // LFOs
-        
-        // Initializes all LFOs
-        chnl1sineLFO.prepare (spec);
-        chnl2sineLFO.prepare (spec);
-        chnl1sawLFO.prepare (spec);
-        chnl2sawLFO.prepare (spec);
-        chnl1squareLFO.prepare (spec);
-        chnl2squareLFO.prepare (spec);
-        
-        // Updates rate of all LFOs
-        rateFloat = rate->get();
-        chnl1sineLFO.setFrequency (rateFloat);
-        chnl2sineLFO.setFrequency (rateFloat);
-        chnl1sawLFO.setFrequency (rateFloat);
-        chnl2sawLFO.setFrequency (rateFloat);
-        chnl1squareLFO.setFrequency (rateFloat);
-        chnl2squareLFO.setFrequency (rateFloat);
+        // Gain glides to new values instead of stepping once per block, the engine smooths the other parameters
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
     }
     
     void releaseResources() override {}
 
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
-        gainFloat = gain->get();
-        rateFloat = rate->get();
-        depthFloat = depth->get();
-        delayFloat = delay->get();
-        feedbackFloat = feedback->get();
-        mixFloat = mix->get();
-        waveformInt = waveform->get();
-        mode = flangMode->get();
-        
-        sampleRate = this->getSampleRate();
-        totalNumInputChannels  = getTotalNumInputChannels();
-        
-        chnl1sineLFO.setFrequency (rateFloat);
-        chnl2sineLFO.setFrequency (rateFloat);
-        chnl1sawLFO.setFrequency (rateFloat);
-        chnl2sawLFO.setFrequency (rateFloat);
-        chnl1squareLFO.setFrequency (rateFloat);
-        chnl2squareLFO.setFrequency (rateFloat);
+        auto* const* channels = buffer.getArrayOfWritePointers();
         
-        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+        // Blocks larger than the prepared size are handled in prepared-size chunks
+        for (int start = 0; start < buffer.getNumSamples(); start += flanger.getMaximumBlockSize())
         {
-            auto* channelData = buffer.getWritePointer (channel);
+            const int chunk = juce::jmin (flanger.getMaximumBlockSize(), buffer.getNumSamples() - start);
             
-            switch(waveformInt)
-            {
-                case 1: // Sinusoidal LFO
-                    switch(mode)
-                    {
-                        case 1: // Additive Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1sineLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat); // Mix Delay (wet added to dry)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else // Handles the second channel for stereo input but doesn't run for mono input
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2sineLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                                    
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        case 2: // Subtractive Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1sineLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) - (wetSample * mixFloat); // Mix Delay (wet subtracted from dry)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2sineLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) - (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        case 3: // Through-Zero Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1sineLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                            
-                                    drySample = chnl1delay.popSample(channel, delayFloat * sampleRate, true); // Note: not actually dry since it's delayed but reusing the variable name for simplicity
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) - (wetSample * mixFloat); // Mix Delay (modulated wet added to delayed wet)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2sineLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                            
-                                    drySample = chnl2delay.popSample(channel, delayFloat * sampleRate, true);
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) - (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        default: // Pass-Through
-                            break;
-                    }
-                    break;
-                    
-                case 2: // Saw Wave LFO
-                    switch(mode)
-                    {
-                        case 1: // Additive Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1sawLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat); // Mix Delay (wet added to dry)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else // Handles the second channel for stereo input but doesn't run for mono input
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2sawLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        case 2: // Subtractive Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1sawLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) - (wetSample * mixFloat); // Mix Delay (wet subtracted from dry)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2sawLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) - (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        case 3: // Through-Zero Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1sawLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                            
-                                    drySample = chnl1delay.popSample(channel, delayFloat * sampleRate, true); // Note: not actually dry since it's delayed but reusing the variable name for simplicity
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat); // Mix Delay (modulated wet added to delayed wet)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2sawLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                            
-                                    drySample = chnl2delay.popSample(channel, delayFloat * sampleRate, true);
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        default: // Pass-Through
-                            break;
-                    }
-                    break;
-                    
-                case 3: // Square Wave LFO
-                    switch(mode)
-                    {
-                        case 1: // Additive Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1squareLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat); // Mix Delay (wet added to dry)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else // Handles the second channel for stereo input but doesn't run for mono input
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2squareLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        case 2: // Subtractive Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1squareLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) - (wetSample * mixFloat); // Mix Delay (wet subtracted from dry)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2squareLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                    
-                                    drySample = channelData[sample];
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                    
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) - (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        case 3: // Through-Zero Flanging
-                            if (channel == 0)
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl1squareLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                            
-                                    drySample = chnl1delay.popSample(channel, delayFloat * sampleRate, true); // Note: not actually dry since it's delayed but reusing the variable name for simplicity
-                                    wetSample = chnl1delay.popSample(channel, delayInSamples, true);
-                                    chnl1delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat); // Feedback
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat); // Mix Delay (modulated wet added to delayed wet)
-                                    channelData[sample] *= gainFloat; // Gain
-                                }
-                            }
-                            else
-                            {
-                                for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                                {
-                                    delayInSamples = (depthFloat * chnl2squareLFO.processSample(0.0f) * delayFloat + delayFloat) * sampleRate;
-                            
-                                    drySample = chnl2delay.popSample(channel, delayFloat * sampleRate, true);
-                                    wetSample = chnl2delay.popSample(channel, delayInSamples, true);
-                                    chnl2delay.pushSample(channel, drySample * (1.0f - feedbackFloat) + wetSample * feedbackFloat);
-                            
-                                    channelData[sample] = (drySample * (1.0f - mixFloat)) + (wetSample * mixFloat);
-                                    channelData[sample] *= gainFloat;
-                                }
-                            }
-                            break;
-                    
-                        default: // Pass-Through
-                            break;
-                    }
-                    break;
-                    
-                default: // Pass-Through
-                    break;
-            }       
+            if (! beginBlock (chunk)) // Pass-Through
+                return;
+            
+            for (int channel = 0; channel < buffer.getNumChannels(); ++channel)
+                processChannel (channel, channels[channel] + start, chunk);
         }
     }
+    
+    //==============================================================================
+    bool beginBlock (int numSamples) override
+    {
+        smoothedGain.update (gain->get(), numSamples);
+        
+        flanger.setParameters (getFlangerParameters());
+        return flanger.beginBlock (numSamples);
+    }
+    
+    // Both channels have their own LFO for stereo input
+    void processChannel (int channel, float* channelData, int numSamples) override
+    {
+        if (channel >= juce::jmin (getTotalNumInputChannels(), 2))
+            return;
+        
+        flanger.processChannel (channel, channelData, numSamples);
+        smoothedGain.applyGain (channelData, numSamples);
+    }
 
     //==============================================================================
     juce::AudioProcessorEditor* createEditor() override         { return new juce::GenericAudioProcessorEditor (*this); }
@@ -483,26 +156,12 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-        juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeFloat (*rate);
-        juce::MemoryOutputStream (destData, true).writeFloat (*depth);
-        juce::MemoryOutputStream (destData, true).writeFloat (*delay);
-        juce::MemoryOutputStream (destData, true).writeFloat (*feedback);
-        juce::MemoryOutputStream (destData, true).writeFloat (*mix);
-        juce::MemoryOutputStream (destData, true).writeInt (*waveform);
-        juce::MemoryOutputStream (destData, true).writeInt (*flangMode);
+        PluginState::save (*this, destData);
     }
 
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        rate->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        depth->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        delay->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        feedback->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        mix->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        waveform->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readInt());
-        flangMode->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readInt());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -515,6 +174,21 @@ public:
     }
 
 private:
+    //==============================================================================
+    FlangerEngine::Parameters getFlangerParameters() const
+    {
+        FlangerEngine::Parameters parameters;
+        parameters.rate = rate->get();
+        parameters.depth = depth->get();
+        parameters.delay = delay->get();
+        parameters.feedback = feedback->get();
+        parameters.mix = mix->get();
+        parameters.waveform = waveform->get();
+        parameters.mode = flangMode->get();
+        parameters.interpolation = interpolation->get();
+        return parameters;
+    }
+    
     //==============================================================================
     juce::AudioParameterFloat* gain;
     juce::AudioParameterFloat* rate;
@@ -524,32 +198,10 @@ private:
     juce::AudioParameterFloat* mix;
     juce::AudioParameterInt* waveform;
     juce::AudioParameterInt* flangMode;
+    juce::AudioParameterInt* interpolation;
     
-    float gainFloat;
-    float rateFloat;
-    float depthFloat;
-    float delayFloat;
-    float feedbackFloat;
-    float mixFloat;
-    int waveformInt;
-    int mode;
-    
-    float drySample;
-    float wetSample;
-    double sampleRate;
-    int totalNumInputChannels;
-    int delayInSamples;
-    
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Thiran> chnl1delay;
-    juce::dsp::DelayLine<float, juce::dsp::DelayLineInterpolationTypes::Thiran> chnl2delay;
-    
-    // The last argument for the following lines is the number of points in the lookup table
-    juce::dsp::Oscillator<float> chnl1sineLFO { [](float x) { return std::sin (x); }, 500 }; // Sine Wave
-    juce::dsp::Oscillator<float> chnl1sawLFO { [](float x) { return x / juce::MathConstants<float>::pi; }, 10000 }; // Saw Wave
-    juce::dsp::Oscillator<float> chnl1squareLFO { [](float x) { return x < 0.0f ? -1.0f : 1.0f; }, 10000 }; // Square Wave
-    juce::dsp::Oscillator<float> chnl2sineLFO { [](float x) { return std::sin (x); }, 500 }; // Sine Wave
-    juce::dsp::Oscillator<float> chnl2sawLFO { [](float x) { return x / juce::MathConstants<float>::pi; }, 10000 }; // Saw Wave
-    juce::dsp::Oscillator<float> chnl2squareLFO { [](float x) { return x < 0.0f ? -1.0f : 1.0f; }, 10000 }; // Square Wave
+    FlangerEngine flanger;
+    SmoothedParameter smoothedGain;
     
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FlangerProcessor)
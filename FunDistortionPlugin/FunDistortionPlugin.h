@@ -20,6 +20,10 @@
 
 #pragma once
 
+#include "BlockRandom.h"
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
 
 //==============================================================================
 class FunDistortionProcessor final : public juce::AudioProcessor
@@ -42,7 +46,15 @@ public:
 
     //==============================================================================
     // This function is used before audio processing. It lets you initialize variables and set up any other resources prior to running the plugin
-    void prepareToPlay (double, int) override {}
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        // the gain glides to a new value instead of jumping once per block
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
+        
+        // the dropout pattern restarts from the same seed every time playback starts, so renders are repeatable
+        randomValues.resize ((size_t) juce::jmax (1, samplesPerBlock));
+        random.setSeed (BlockRandom::defaultSeed);
+    }
     // This function is usually called after the plugin stops taking in audio. It can deallocate any memory used and clean out buffers
     void releaseResources() override {}
 
@@ -50,7 +62,8 @@ public:
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
         
-        auto gainValue = gain->get();
+        // gain is applied to the whole block before or after each effect (as whole-block multiplies) rather than inside the loops
+        smoothedGain.update (gain->get(), buffer.getNumSamples());
         
         //int modeValue = juce::roundToInt(mode->get());
         int modeValue = mode->get();
@@ -65,17 +78,23 @@ public:
         float wavefoldThreshold = 0.05f / hthres;
         
         auto nbits = nBits->get(); // can be int or float for plugins
-        auto ampValues = pow(2, nbits-1);
+        
+        // pow() returns a double, which made the whole crushing loop run in double. Past 25 bits the steps are below
+        // -140 dB, so clamping there keeps the float version from overflowing without an audible change
+        float ampValues = std::exp2 (juce::jmin (nbits, 25.0f) - 1.0f);
+        float stepSize = 1.0f / ampValues;
         
         auto pDrop = percentDrop->get();
+        auto dropThreshold = BlockRandom::getThreshold (pDrop / 100.0); // random values below this drop their sample
         
         
         switch(modeValue) {
             case 1: // pause distortion - self made
                 for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
                     auto* channelData = buffer.getWritePointer(channel);
+                    smoothedGain.applyGain (channelData, buffer.getNumSamples()); // applying gain
                     for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-                        float processedSample = channelData[sample] * gainValue; // applying gain
+                        float processedSample = channelData[sample];
                         if(processedSample <= (-1 * highThreshold)) {
                             processedSample = processedSample + (highThreshold - lowThreshold);
                         }
@@ -96,29 +115,25 @@ public:
                 for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
                     auto* channelData = buffer.getWritePointer(channel);
                     for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-                        float processedSample = ceil(ampValues*channelData[sample])*(1/ampValues); // apply bit crushing
-                        channelData[sample] = gainValue*(processedSample);
+                        float processedSample = std::ceil(ampValues*channelData[sample])*stepSize; // apply bit crushing
+                        channelData[sample] = processedSample;
                     }
+                    smoothedGain.applyGain (channelData, buffer.getNumSamples()); // applying gain
                 }
                 break;
             case 3: // sample dropout
                 for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
                     auto* channelData = buffer.getWritePointer(channel);
-                    for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-                        int randomNum = fmod(rand(),100);
-                        if(randomNum < pDrop) {
-                            channelData[sample] = 0;
-                            continue;
-                        }
-                        channelData[sample] = channelData[sample] * gainValue;
-                    }
+                    dropSamples (channelData, buffer.getNumSamples(), dropThreshold);
+                    smoothedGain.applyGain (channelData, buffer.getNumSamples()); // applying gain
                 }
                 break;
             case 4: // wave folding
                 for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
                     auto* channelData = buffer.getWritePointer(channel);
+                    smoothedGain.applyGain (channelData, buffer.getNumSamples()); // applying gain
                     for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-                        float processedSample = channelData[sample] * gainValue; // applying gain
+                        float processedSample = channelData[sample];
                         float dif = 0;
                         if(processedSample > wavefoldThreshold) {
                             dif = processedSample - wavefoldThreshold;
@@ -175,23 +190,13 @@ public:
     // in the next session of running the pedal
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeInt (*mode);
-        juce::MemoryOutputStream (destData, true).writeFloat (*lowthres);
-        juce::MemoryOutputStream (destData, true).writeFloat (*highthres);
-        juce::MemoryOutputStream (destData, true).writeFloat (*nBits);
-        juce::MemoryOutputStream (destData, true).writeFloat (*percentDrop);
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        mode->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readInt());
-        lowthres->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        highthres->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        nBits->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        percentDrop->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -206,6 +211,20 @@ public:
     }
 
 private:
+    //==============================================================================
+    // Zeroes each sample whose random value falls below dropThreshold. The random values are made a block at a time
+    // and compared as integers, so both loops vectorize.
+    void dropSamples (float* channelData, int numSamples, juce::uint32 dropThreshold)
+    {
+        for (int start = 0; start < numSamples; start += (int) randomValues.size()) {
+            const int count = juce::jmin ((int) randomValues.size(), numSamples - start);
+            random.fill (randomValues.data(), count);
+            
+            for (int sample = 0; sample < count; ++sample)
+                channelData[start + sample] = randomValues[(size_t) sample] < dropThreshold ? 0.0f : channelData[start + sample];
+        }
+    }
+    
     //==============================================================================
     juce::AudioParameterFloat* gain;
     juce::AudioParameterInt* mode;
@@ -213,6 +232,11 @@ private:
     juce::AudioParameterFloat* highthres;
     juce::AudioParameterFloat* nBits;
     juce::AudioParameterFloat* percentDrop;
+    
+    SmoothedParameter smoothedGain;
+    
+    BlockRandom random;
+    std::vector<juce::uint32> randomValues;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FunDistortionProcessor)
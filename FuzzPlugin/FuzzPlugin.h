@@ -20,9 +20,15 @@
 
 #pragma once
 
+#include "AntiderivativeWaveshaper.h"
+#include "OversampledWaveshaper.h"
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
 
 //==============================================================================
-class FuzzProcessor final : public juce::AudioProcessor
+class FuzzProcessor final : public juce::AudioProcessor,
+                            private juce::AsyncUpdater
 {
 public:
 
@@ -34,11 +40,27 @@ public:
     {
         addParameter (gain = new juce::AudioParameterFloat ({ "gain", 1 }, "Gain", 0.0f, 3.0f, 0.5f));
         addParameter (clip = new juce::AudioParameterFloat ({ "clip", 1 }, "Clip", 0.0f, 9.0f, 5.0f));
+        addParameter (oversampling = new juce::AudioParameterInt ({ "oversampling", 1 }, "Oversampling (1x/2x/4x/8x)", 0, OversampledWaveshaper::maxFactorLog2, 2));
+        addParameter (filter = new juce::AudioParameterInt ({ "filter", 1 }, "Oversampling Filter (IIR/FIR)", 0, 1, OversampledWaveshaper::iir));
+        addParameter (antialiasing = new juce::AudioParameterInt ({ "antialiasing", 1 }, "Antialiasing (Off/ADAA1/ADAA2)", 0, 2, AntiderivativeWaveshaper::off));
     }
 
     //==============================================================================
     // This function is used before audio processing. It lets you initialize variables and set up any other resources prior to running the plugin
-    void prepareToPlay (double, int) override {}
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        // gain and clip glide to new values instead of jumping once per block
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
+        smoothedClip.prepare (sampleRate, samplesPerBlock, clip->get());
+
+        // the hard clipper runs oversampled so its harmonics are filtered out instead of aliasing
+        waveshaper.prepare (getTotalNumOutputChannels(), samplesPerBlock);
+        adaa.prepare (getTotalNumOutputChannels());
+        waveshaper.setOversampling (oversampling->get(), filter->get());
+        adaa.setOrder (antialiasing->get());
+        latency = waveshaper.getLatencyInSamples (adaa.getLatencyInSamples());
+        setLatencySamples (latency);
+    }
     // This function is usually called after the plugin stops taking in audio. It can deallocate any memory used and clean out buffers
     void releaseResources() override {}
 
@@ -46,24 +68,29 @@ public:
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
         
-        auto gainValue = gain->get();
-        auto clipValue = clip->get();
+        smoothedGain.update (gain->get(), buffer.getNumSamples());
+        smoothedClip.update (clip->get(), buffer.getNumSamples());
         
-        float clipThreshold = 0.05f / clipValue;
+        waveshaper.setOversampling (oversampling->get(), filter->get());
+        adaa.setOrder (antialiasing->get());
+        
+        // The host is told about a new latency from the message thread, never from here
+        const int newLatency = waveshaper.getLatencyInSamples (adaa.getLatencyInSamples());
+        
+        if (latency.exchange (newLatency) != newLatency)
+            triggerAsyncUpdate();
         
         for (int channel = 0; channel < buffer.getNumChannels(); ++channel) 
         {
             auto* channelData = buffer.getWritePointer(channel);
-            for (int sample = 0; sample < buffer.getNumSamples(); ++sample) 
-            {
-                float processedSample = channelData[sample] * gainValue; // applying gain
-                
-                processedSample = (processedSample > clipThreshold) ? clipThreshold : ((processedSample < -clipThreshold) ? -clipThreshold : processedSample);
-                
-                // write processed sample back to buffer
-                channelData[sample] = processedSample;
-            }
+            smoothedGain.applyGain (channelData, buffer.getNumSamples()); // applying gain
         }
+        
+        // the threshold only needs to be recomputed per sample while the clip parameter is moving
+        if (smoothedClip.isSmoothing())
+            clipBuffer<true> (buffer);
+        else
+            clipBuffer<false> (buffer);
     }
 
     //==============================================================================
@@ -101,15 +128,13 @@ public:
     // in the next session of running the pedal
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	    juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeFloat (*clip);;
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        clip->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -124,9 +149,40 @@ public:
     }
 
 private:
+    //==============================================================================
+    // Hard clips every channel at 0.05 / clip, oversampled and optionally antialiased. isRamping selects whether the clip
+    // value is read per sample or once
+    template <bool isRamping>
+    void clipBuffer (juce::AudioBuffer<float>& buffer)
+    {
+        const float settledThreshold = 0.05f / smoothedClip.getTargetValue();
+        
+        waveshaper.processChannels (buffer, [this, settledThreshold] (int channel, float* channelData, int numSamples, int firstSample) {
+            adaa.process<ClippingCurve::HardClip> (channel, channelData, numSamples, [this, settledThreshold, firstSample] (int sample) {
+                return isRamping ? 0.05f / smoothedClip.get<true> (waveshaper.getBaseSample (firstSample, sample)) : settledThreshold;
+            });
+        });
+    }
+    
+    // Reports the latency processBlock() last switched to
+    void handleAsyncUpdate() override
+    {
+        setLatencySamples (latency.load());
+    }
+    
     //==============================================================================
     juce::AudioParameterFloat* gain;
     juce::AudioParameterFloat* clip;
+    juce::AudioParameterInt* oversampling;
+    juce::AudioParameterInt* filter;
+    juce::AudioParameterInt* antialiasing;
+    
+    SmoothedParameter smoothedGain;
+    SmoothedParameter smoothedClip;
+    
+    OversampledWaveshaper waveshaper;
+    AntiderivativeWaveshaper adaa;
+    std::atomic<int> latency { 0 }; // Of the settings in use, in samples
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (FuzzProcessor)
@@ -4,6 +4,13 @@
 #include <cstdint>
 #include <iomanip>
 #include <sstream>
+#include <chrono>
+#include <cstring>
+#include <utility>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 
 struct Parameter{
     std::string name;
@@ -43,11 +50,115 @@ std::vector<Plugins> plugins = {
     {"reverb", reverb}
 };
 
+/*OSC over UDP
+*One socket stays open for the whole session. Parameter changes are queued by
+*address and sent by flush() at most once per UI frame, so an encoder sweep
+*sends the latest value of each fader once per frame instead of one message
+*per 0.01 step.
+*/
+const char* OSC_HOST = "127.0.0.1";
+const uint16_t OSC_PORT = 24024;
+const int FRAME_MS = 16;
+
+struct OscArgument{
+    char type;      // 'f' or 'i'
+    float f;
+    int32_t i;
+};
+
+class OscSender{
+public:
+    OscSender(const char* host, uint16_t port){
+        sock = socket(AF_INET, SOCK_DGRAM, 0);
+        std::memset(&dest, 0, sizeof(dest));
+        dest.sin_family = AF_INET;
+        dest.sin_port = htons(port);
+        inet_pton(AF_INET, host, &dest.sin_addr);
+    }
+
+    ~OscSender(){
+        if(sock >= 0){
+            close(sock);
+        }
+    }
+
+    void queue_float(const std::string& address, float value){
+        queue(address, {'f', value, 0});
+    }
+
+    void queue_int(const std::string& address, int32_t value){
+        queue(address, {'i', 0.0f, value});
+    }
+
+    //Sends everything queued if a frame has passed since the last send, or straight away if forced
+    void flush(bool force = false){
+        auto now = std::chrono::steady_clock::now();
+        if(pending.empty() || (!force && now - lastFlush < std::chrono::milliseconds(FRAME_MS))){
+            return;
+        }
+        for(auto& message : pending){
+            send_message(message.first, message.second);
+        }
+        pending.clear();
+        lastFlush = now;
+    }
+
+private:
+    //A newer value for an address replaces the queued one
+    void queue(const std::string& address, OscArgument argument){
+        for(auto& message : pending){
+            if(message.first == address){
+                message.second = argument;
+                return;
+            }
+        }
+        pending.emplace_back(address, argument);
+    }
+
+    //OSC strings are null terminated and padded to a multiple of 4 bytes
+    static void append_string(std::string& packet, const std::string& text){
+        packet += text;
+        packet.append(4 - (text.size() % 4), '\0');
+    }
+
+    //OSC numbers are 32 bit big endian
+    static void append_int32(std::string& packet, uint32_t value){
+        value = htonl(value);
+        packet.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void send_message(const std::string& address, const OscArgument& argument){
+        if(sock < 0){
+            return;
+        }
+        std::string packet;
+        append_string(packet, address);
+        append_string(packet, std::string(",") + argument.type);
+        if(argument.type == 'f'){
+            uint32_t bits;
+            std::memcpy(&bits, &argument.f, sizeof(bits));
+            append_int32(packet, bits);
+        }
+        else{
+            append_int32(packet, (uint32_t) argument.i);
+        }
+        sendto(sock, packet.data(), packet.size(), 0, (const sockaddr*) &dest, sizeof(dest));
+    }
+
+    int sock;
+    sockaddr_in dest;
+    std::vector<std::pair<std::string, OscArgument>> pending;
+    std::chrono::steady_clock::time_point lastFlush;
+};
+
+OscSender osc(OSC_HOST, OSC_PORT);
+
 void initscreen(){
     initscr();              // Initialize ncurses screen
     cbreak();               // Disable line buffering
     noecho();               // Disable echoing of characters
     keypad(stdscr, TRUE);   // Enable keypad for arrow keys
+    timeout(FRAME_MS);      // Wake up every frame so coalesced OSC messages get sent
     curs_set(FALSE);        // Dont show cursor
 
     // Check if the terminal supports color
@@ -443,13 +554,12 @@ uint8_t draw_text(int16_t y, int16_t x, std::string text, bool selected){
     return x-oldx;
 }
 
-void send_osc_parameter(Plugins plugin, Parameter param){
-    std::string command = "oscsend localhost 24024 /parameter/" + plugin.name + '/' + param.name + " f " + std::to_string(param.value);
-    system(command.c_str());
+void send_osc_parameter(const Plugins& plugin, const Parameter& param){
+    osc.queue_float("/parameter/" + plugin.name + '/' + param.name, (float) param.value);
 }
 
-void send_osc_bypass(Plugins plugin, Parameter param){
-    std::string command = "oscsend localhost 24024 /bypass/" + plugin.name + " i " + std::to_string(param.value);
+void send_osc_bypass(const Plugins& plugin, const Parameter& param){
+    osc.queue_int("/bypass/" + plugin.name, (int32_t) param.value);
 }
 
 void draw_parameter_bypass(uint16_t y, uint16_t x, Parameter param, bool Selected){
@@ -609,12 +719,14 @@ int main() {
 
 
         case 'q':
+            osc.flush(true);
             endwin();  // End ncurses mode
             return 0;
         
         default:
             break;
         }
+        osc.flush();
     }
 
     endwin();  // End ncurses mode
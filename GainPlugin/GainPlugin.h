@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
 
 //==============================================================================
 class GainProcessor final : public juce::AudioProcessor
@@ -37,7 +40,11 @@ public:
 
     //==============================================================================
     // This function is used before audio processing. It lets you initialize variables and set up any other resources prior to running the plugin
-    void prepareToPlay (double, int) override {}
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        // the gain glides to a new value instead of jumping once per block
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
+    }
     // This function is usually called after the plugin stops taking in audio. It can deallocate any memory used and clean out buffers
     void releaseResources() override {}
 
@@ -45,15 +52,12 @@ public:
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
         
-        auto gainValue = gain->get();
+        smoothedGain.update (gain->get(), buffer.getNumSamples());
         
         for (int channel = 0; channel < buffer.getNumChannels(); ++channel) 
         {
             auto* channelData = buffer.getWritePointer(channel);
-            for (int sample = 0; sample < buffer.getNumSamples(); ++sample) 
-            {
-                channelData[sample] = channelData[sample] * gainValue; // apply gain
-            }
+            smoothedGain.applyGain (channelData, buffer.getNumSamples()); // apply gain
         }
     }
 
@@ -92,13 +96,13 @@ public:
     // in the next session of running the pedal
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	    juce::MemoryOutputStream (destData, true).writeFloat (*gain);
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -115,6 +119,8 @@ public:
 private:
     //==============================================================================
     juce::AudioParameterFloat* gain;
+    
+    SmoothedParameter smoothedGain;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (GainProcessor)
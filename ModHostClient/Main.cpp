@@ -0,0 +1,54 @@
+#include <JuceHeader.h>
+#include "ModHostClient.h"
+
+//==============================================================================
+// Loads a board into a running mod-host and reports how long it took
+int main (int argc, char* argv[])
+{
+    juce::ArgumentList args (argc, argv);
+
+    if (args.size() == 0 || args.containsOption ("--help|-h"))
+    {
+        std::printf ("usage: ModHostBoardLoader BOARD.json [--host HOST] [--port N]\n");
+        return args.size() == 0 ? 1 : 0;
+    }
+
+    const auto file = juce::File::getCurrentWorkingDirectory().getChildFile (args[0].text);
+    const auto commands = ModHostClient::getBoardCommands (juce::JSON::parse (file));
+
+    if (commands.isEmpty())
+    {
+        std::fprintf (stderr, "%s: no plugins\n", file.getFullPathName().toRawUTF8());
+        return 1;
+    }
+
+    ModHostClient client;
+    const auto host = args.containsOption ("--host") ? args.getValueForOption ("--host") : juce::String ("localhost");
+    const int port = args.containsOption ("--port") ? args.getValueForOption ("--port").getIntValue() : 5555;
+
+    if (! client.connect (host, port))
+    {
+        std::fprintf (stderr, "Could not connect to %s:%d\n", host.toRawUTF8(), port);
+        return 1;
+    }
+
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+    const auto responses = client.sendCommands (commands, 5000);
+    const auto elapsed = juce::Time::getMillisecondCounterHiRes() - start;
+    int failed = 0;
+
+    // "add" replies with the instance number, everything else with 0
+    for (int i = 0; i < commands.size(); ++i)
+    {
+        const int expected = commands[i].startsWith ("add ") ? commands[i].fromLastOccurrenceOf (" ", false, false).getIntValue() : 0;
+
+        if (responses[(size_t) i] != expected)
+        {
+            std::fprintf (stderr, "%s -> %d\n", commands[i].toRawUTF8(), responses[(size_t) i]);
+            ++failed;
+        }
+    }
+
+    std::printf ("%d commands in %.1f ms, %d failed\n", commands.size(), elapsed, failed);
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,204 @@
+/*******************************************************************************
+
+ name:             ModHostClient
+ description:      pipelined client for mod-host's socket protocol.
+
+ mod-host answers every command with "resp <code>" and a null byte, in the
+ order the commands arrived. So a client does not have to wait for one reply
+ before sending the next command: sendCommands() writes a whole batch back to
+ back, collecting whatever replies are already waiting as it goes, then
+ matches the replies to the commands by position. Loading a board this way
+ costs about one round trip instead of one per command.
+
+ getBoardCommands() builds the add, connect and parameter commands for one of
+ the GUI's Json boards, following the same rules as modhostmanager.py.
+
+*******************************************************************************/
+
+#pragma once
+
+
+//==============================================================================
+class ModHostClient
+{
+public:
+    // Code returned for a command that got no reply, the same one modhostmanager.py uses
+    static constexpr int noReply = -5;
+
+    //==============================================================================
+    bool connect (const juce::String& host = "localhost", int port = 5555, int timeoutMs = 1000)
+    {
+        return socket.connect (host, port, timeoutMs);
+    }
+
+    void disconnect()                                           { socket.close(); }
+    bool isConnected() const                                    { return socket.isConnected(); }
+
+    //==============================================================================
+    // Sends every command without waiting in between and returns their response codes, in the same order
+    std::vector<int> sendCommands (const juce::StringArray& commands, int timeoutMs = 1000)
+    {
+        std::vector<int> responses;
+        responses.reserve ((size_t) commands.size());
+
+        for (const auto& command : commands)
+        {
+            if (socket.write (command.toRawUTF8(), (int) command.getNumBytesAsUTF8() + 1) < 0) // Includes the null terminator
+                break;
+
+            // Reading while writing keeps mod-host from blocking on a full socket during long batches
+            readReplies (responses, 0);
+        }
+
+        const auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32) timeoutMs;
+
+        while ((int) responses.size() < commands.size() && juce::Time::getMillisecondCounter() < deadline)
+            if (! readReplies (responses, (int) (deadline - juce::Time::getMillisecondCounter())))
+                break;
+
+        responses.resize ((size_t) commands.size(), noReply);
+        return responses;
+    }
+
+    int sendCommand (const juce::String& command, int timeoutMs = 1000)
+    {
+        return sendCommands (juce::StringArray (command), timeoutMs)[0];
+    }
+
+    //==============================================================================
+    static juce::String add (const juce::String& uri, int instance)
+    {
+        return "add " + uri + " " + juce::String (instance);
+    }
+
+    static juce::String connectPorts (const juce::String& source, const juce::String& destination)
+    {
+        return "connect " + source + " " + destination;
+    }
+
+    // LV2 control ports use param_set, the JUCE plugins' parameters use patch_set
+    static juce::String setParameter (int instance, const juce::String& type, const juce::String& symbol, double value)
+    {
+        return (type == "plug" ? "patch_set " : "param_set ") + juce::String (instance) + " " + symbol + " " + juce::String (value);
+    }
+
+    static juce::String bypass (int instance, bool shouldBeBypassed)
+    {
+        return "bypass " + juce::String (instance) + " " + juce::String (shouldBeBypassed ? 1 : 0);
+    }
+
+    //==============================================================================
+    // Every command needed to load a board: the plugins, the connections from capture to playback, then the parameters
+    static juce::StringArray getBoardCommands (const juce::var& board)
+    {
+        juce::StringArray commands;
+        const auto pluginList = board.getProperty ("plugins", {});
+
+        if (const auto* plugins = pluginList.getArray())
+        {
+            for (int instance = 0; instance < plugins->size(); ++instance)
+                commands.add (add ((*plugins)[instance].getProperty ("uri", {}).toString(), instance));
+
+            const juce::StringArray capture { "system:capture_1", "system:capture_2" };
+            const juce::StringArray playback { "system:playback_1", "system:playback_2" };
+            juce::StringArray sources = capture;
+            bool sourceIsMono = false;
+
+            for (int instance = 0; instance < plugins->size(); ++instance)
+            {
+                const auto& plugin = (*plugins)[instance];
+                const auto inputs = getPorts (plugin, "inputs", "in", instance);
+                const bool isMono = plugin.getProperty ("channels", "mono").toString() == "mono";
+
+                connectLayers (commands, sources, sourceIsMono, inputs, isMono);
+
+                sources = getPorts (plugin, "outputs", "out", instance);
+                sourceIsMono = isMono;
+            }
+
+            if (! plugins->isEmpty())
+                connectLayers (commands, sources, sourceIsMono, playback, false);
+
+            for (int instance = 0; instance < plugins->size(); ++instance)
+            {
+                const auto parameterList = (*plugins)[instance].getProperty ("parameters", {});
+
+                if (const auto* parameters = parameterList.getArray())
+                    for (const auto& parameter : *parameters)
+                        commands.add (setParameter (instance,
+                                                    parameter.getProperty ("type", "lv2").toString(),
+                                                    parameter.getProperty ("symbol", {}).toString(),
+                                                    (double) parameter.getProperty ("default", 1.0)));
+            }
+        }
+
+        return commands;
+    }
+
+private:
+    //==============================================================================
+    // Reads whatever replies arrive within timeoutMs. Returns false if the connection failed.
+    bool readReplies (std::vector<int>& responses, int timeoutMs)
+    {
+        while (socket.waitUntilReady (true, timeoutMs) == 1)
+        {
+            char data[512];
+            const int bytesRead = socket.read (data, (int) sizeof (data), false);
+
+            if (bytesRead <= 0)
+                return false;
+
+            for (int i = 0; i < bytesRead; ++i)
+            {
+                if (data[i] != '\0')
+                {
+                    pending << data[i];
+                    continue;
+                }
+
+                // "resp <code>", possibly followed by a value
+                const auto tokens = juce::StringArray::fromTokens (pending, " ", "");
+                responses.push_back (tokens.size() >= 2 && tokens[0] == "resp" ? tokens[1].getIntValue() : noReply);
+                pending.clear();
+            }
+
+            timeoutMs = 0;
+        }
+
+        return true;
+    }
+
+    // Full port names of a plugin, like "effect_2:audio_in_1"
+    static juce::StringArray getPorts (const juce::var& plugin, const char* property, const char* defaultPort, int instance)
+    {
+        juce::StringArray ports;
+        const auto portList = plugin.getProperty (property, {});
+
+        if (const auto* names = portList.getArray())
+            for (const auto& name : *names)
+                ports.add ("effect_" + juce::String (instance) + ":" + name.toString());
+        else
+            ports.add ("effect_" + juce::String (instance) + ":" + defaultPort);
+
+        return ports;
+    }
+
+    // A mono source feeds every destination, a mono destination mixes both sources, otherwise channels pair up
+    static void connectLayers (juce::StringArray& commands, const juce::StringArray& sources, bool sourceIsMono,
+                               const juce::StringArray& destinations, bool destinationIsMono)
+    {
+        for (int channel = 0; channel < 2; ++channel)
+        {
+            const int source = sourceIsMono ? 0 : channel;
+            const int destination = destinationIsMono ? 0 : channel;
+
+            if (source < sources.size() && destination < destinations.size()
+                 && ! (sourceIsMono && destinationIsMono && channel > 0))
+                commands.add (connectPorts (sources[source], destinations[destination]));
+        }
+    }
+
+    //==============================================================================
+    juce::StreamingSocket socket;
+    juce::String pending;   // Reply received so far, up to its null terminator
+};
@@ -23,6 +23,8 @@
 
 #pragma once
 
+#include "PluginState.h"
+
 
 //==============================================================================
 class PassThruProcessor final : public juce::AudioProcessor
@@ -64,10 +66,12 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override
     {
+        PluginState::save (*this, destData);
     }
 
     void setStateInformation (const void* data, int sizeInBytes) override
     {
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -2,10 +2,10 @@ import sys
 import time
 from PyQt5.QtWidgets import QApplication, QLabel, QWidget, QVBoxLayout, QHBoxLayout, QStackedWidget
 from PyQt5.QtGui import QFont, QPixmap, QPainter, QPen, QColor, QPolygon, QTransform
-from PyQt5.QtCore import Qt, QRect, QPoint
+from PyQt5.QtCore import Qt, QRect, QPoint, QTimer
 from plugin_manager import PluginManager, Plugin, Parameter
 import os
-from modhostmanager import startModHost, connectToModHost, updateParameter, updateBypass, quitModHost, setUpPatch, setUpPlugins, varifyParameters, startJackdServer
+from modhostmanager import startModHost, startChainHost, isChainHostBoard, connectToModHost, loadChainHostBoard, getPedalLoads, updateParameter, updateBypass, quitModHost, setUpPatch, setUpPlugins, varifyParameters, startJackdServer
 
 class BoxWidget(QWidget):
     def __init__(self, indicator : int, plugin_name = "", bypass : int = 0):
@@ -13,6 +13,7 @@ class BoxWidget(QWidget):
         self.plugin_name = plugin_name
         self.indicator = indicator
         self.bypass = bypass
+        self.load = None
         self.setFixedSize(240, 801//3)
         self.initUI()
     
@@ -80,6 +81,25 @@ class BoxWidget(QWidget):
         rect = QRect(0, 0, self.width()-1, self.height())
         painter.drawRect(rect)
 
+        #CPU bar along the bottom, the length is the average load and the colour follows the p99 load
+        if self.load is not None:
+            minimum, average, p99, maximum, xruns = self.load
+            if p99 >= 50 or xruns > 0:
+                color = QColor("red")
+            elif p99 >= 25:
+                color = QColor("orange")
+            else:
+                color = QColor("green")
+            width = int((self.width() - 80) * min(average, 100) / 100)
+            painter.fillRect(QRect(40, self.height() - 30, width, 12), color)
+            painter.setPen(QPen(Qt.black, 2))
+            painter.drawRect(QRect(40, self.height() - 30, self.width() - 80, 12))
+            painter.setFont(QFont("Comic Sans MS", 9))
+            painter.drawText(QRect(40, self.height() - 58, self.width() - 80, 26), Qt.AlignCenter, f"CPU {average:.1f}% (max {maximum:.1f}%)")
+
+    def updateLoad(self, load):
+        self.load = load
+        self.update()
     
     def updateBypass(self, bypass : int):
         self.bypass = bypass
@@ -126,6 +146,11 @@ class BoxofPlugins(QWidget):
         except:
             pass
 
+    def updateLoads(self, page, loads : list):
+        for index, box in enumerate(self.boxes):
+            position = index + 3*page
+            box.updateLoad(loads[position] if position < len(loads) else None)
+
 class Cursor(QWidget):
     def __init__(self, position : int = 0):
         super().__init__()
@@ -406,11 +431,13 @@ class ParameterPanel(QWidget):
         painter.fillRect(rect, self.background_color)
 
 class BoardWindow(QWidget):
-    def __init__(self, manager : PluginManager, mod_host_manager, restart_callback):
+    def __init__(self, manager : PluginManager, mod_host_manager, restart_callback, chain_host : bool = False):
         super().__init__()
         self.plugins = manager
         self.mod_host_manager = mod_host_manager
         self.restart_callback = restart_callback
+        self.chain_host = chain_host
+        self.loads = []
         self.backgroundColor = "#E2C290"
 
         self.rcount = 0
@@ -441,6 +468,19 @@ class BoardWindow(QWidget):
 
         self.setFocusPolicy(Qt.StrongFocus)
 
+        #Only the chain host measures each pedal's load, so there is nothing to show under mod-host
+        self.loadTimer = QTimer(self)
+        self.loadTimer.timeout.connect(self.updateLoads)
+        if chain_host:
+            self.loadTimer.start(1000)
+
+    def updateLoads(self):
+        loads = getPedalLoads(self.mod_host_manager)
+        if loads is None:
+            return
+        self.loads = loads
+        self.pluginbox.updateLoads(self.page, self.loads)
+
     def keyPressEvent(self, event):
         key = event.key()
 
@@ -465,7 +505,9 @@ class BoardWindow(QWidget):
             self.rcount += 1
             if self.rcount >= 7:
                 self.rcount = 0
-                quitModHost(self.mod_host_manager)
+                #The chain host keeps playing while the next board is chosen, then switches to it without a gap
+                if not self.chain_host:
+                    quitModHost(self.mod_host_manager)
                 self.restart_callback()
         else:
             self.rcount = 0
@@ -598,6 +640,7 @@ class BoardWindow(QWidget):
             del self.pluginbox
             self.pluginbox = BoxofPlugins(self.page, self.plugins)
             self.pluginbox.setParent(self)
+            self.pluginbox.updateLoads(self.page, self.loads)
             self.pluginbox.show()
 
             self.pageNum.setText("Pgn " + str(self.page))
@@ -612,6 +655,7 @@ class BoardWindow(QWidget):
             del self.pluginbox
             self.pluginbox = BoxofPlugins(self.page, self.plugins)
             self.pluginbox.setParent(self)
+            self.pluginbox.updateLoads(self.page, self.loads)
             self.pluginbox.show()
 
             self.pageNum.setText("Pgn " + str(self.page))
@@ -742,6 +786,8 @@ class MainWindow(QWidget):
         self.stack.addWidget(self.start_screen)
 
         self.board_window = None  # Placeholder for later
+        self.modhost = None
+        self.chain_host = False
 
         self.show()
 
@@ -749,14 +795,32 @@ class MainWindow(QWidget):
         """Called when a JSON file is selected to load the board"""
         board = PluginManager()
         board.initFromJSON(selected_json)
-        startModHost()
-        modhost = connectToModHost()
+        modhost = None
+        chain_host = False
+        #a chain host that is still running switches to the new board itself, crossfading from the old one
+        if self.chain_host and isChainHostBoard(board):
+            if loadChainHostBoard(self.modhost, selected_json) == 0:
+                modhost = self.modhost
+                chain_host = True
+            else:
+                print("Board switch failed, restarting the chain host")
+        #boards made only of this repository's plugins run in the chain host, which loads and connects them itself
+        if modhost is None and isChainHostBoard(board) and startChainHost(selected_json) is not None:
+            modhost = connectToModHost()
+            chain_host = modhost is not None
+            if modhost is None:
+                print("Chain host failed, falling back to mod-host")
         if modhost is None:
-            print("Failed Closing...")
-            return
-        setUpPlugins(modhost, board)
-        setUpPatch(modhost, board)
+            startModHost()
+            modhost = connectToModHost()
+            if modhost is None:
+                print("Failed Closing...")
+                return
+            setUpPlugins(modhost, board)
+            setUpPatch(modhost, board)
         varifyParameters(modhost, board)
+        self.modhost = modhost
+        self.chain_host = chain_host
 
         # Remove old board window if it exists
         if self.board_window is not None:
@@ -764,7 +828,7 @@ class MainWindow(QWidget):
             self.board_window.deleteLater()
 
         # Create new board window and add it to the stack
-        self.board_window = BoardWindow(board, mod_host_manager=modhost, restart_callback=self.show_start_screen)
+        self.board_window = BoardWindow(board, mod_host_manager=modhost, restart_callback=self.show_start_screen, chain_host=chain_host)
         self.stack.addWidget(self.board_window)
         self.stack.setCurrentWidget(self.board_window)  # Switch view
         self.board_window.setFocus()
@@ -12,7 +12,7 @@ def startModHost():
     try:
         mod_host_cmd = ["mod-host","-n","-p","5555"] #Starting mod-host -n(no ui) -p 5555(w/ port 5555)
         
-        subprocess.run(["killall","mod-host"],check=False)
+        subprocess.run(["killall","mod-host","PedalChainHost"],check=False)
 
         if sys.platform.startswith("linux"):
             process = subprocess.Popen(mod_host_cmd,
@@ -28,6 +28,32 @@ def startModHost():
         print(f"Failed to start: {e}")
         return None
 
+REPO_PLUGIN_URI = "https://github.com/AnnaAndres28/PedalboardPlugins/tree/main/"
+
+def isChainHostBoard(manager: plugin_manager.PluginManager):
+    #the chain host only runs the plugins in this repository
+    return manager.size() > 0 and all(plugin.uri.startswith(REPO_PLUGIN_URI) for plugin in manager.plugins)
+
+def startChainHost(jsonFile: str):
+    try:
+        chain_host_cmd = ["PedalChainHost", jsonFile, "--port", "5555"] #Runs the whole board in one JACK client, answers mod-host commands on the same port
+
+        subprocess.run(["killall","mod-host","PedalChainHost"],check=False)
+
+        if sys.platform.startswith("linux"):
+            process = subprocess.Popen(chain_host_cmd,
+                                       stdout=subprocess.PIPE,
+                                       stderr=subprocess.PIPE,
+                                         preexec_fn=os.setpgrp)
+        else:
+            print("Unsupported OS")
+            return None
+        return process
+    
+    except Exception as e:
+        print(f"Failed to start: {e}")
+        return None
+
 def startJackdServer():
     try:
         jackd_cmd = ["/usr/bin/jackd", "-d", "alsa", "-d", "hw:sndrpihifiberry", "-r", "96000", "-p", "128", "-n", "2"]
@@ -85,146 +111,82 @@ def sendCommand(sock, command):
         print(f"Failed to send command: {e}")
         return None
 
-def quitModHost(sock):
-    command = f"quit"
-    try:
-        return int(sendCommand(sock, command).split()[1])
-    except Exception as e:
-        print(e)
-        return -5
-
-def addEffect(sock, plugin: plugin_manager.Plugin, instanceNum : int):
-    command = f"add {plugin.uri} {instanceNum}"
-    try:
-        return int(sendCommand(sock, command).split()[1])
-    except Exception as e:
-        print(f"Error addingEffect {e}")
-        return -5
-
-def connectMonoToMono(sock,source, dest):
-    command = f"connect {source} {dest}"
+def sendCommands(sock, commands: list):
+    #Pipelines a batch of commands: writes them all back to back, then matches the "resp N" replies to them in order
+    #Returns one response code per command, -5 for any that got no reply
+    if not commands:
+        return []
     try:
-        return int(sendCommand(sock, command).split()[1])
+        sock.sendall(b"".join(command.encode() + b"\x00" for command in commands))
     except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
+        print(f"Failed to send commands: {e}")
+        return [-5] * len(commands)
 
-def connectMonoToStereo(sock, source, dest_in_1, dest_in_2):
-    command = f"connect {source} {dest_in_1}"
+    responses = []
+    pending = b""
     try:
-        response = sendCommand(sock, command).split()[1]
-    except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
-    
-    command = f"connect {source} {dest_in_2}"
-    try:
-        return [response, sendCommand(sock, command).split()[1]]
+        while len(responses) < len(commands):
+            data = sock.recv(4096)
+            if not data:
+                break
+            pending += data
+            #Replies are null terminated, the last piece may be an incomplete reply
+            *replies, pending = pending.split(b"\x00")
+            for reply in replies:
+                reply = reply.decode().split()
+                if len(reply) >= 2 and reply[0] == "resp":
+                    try:
+                        responses.append(int(reply[1]))
+                    except ValueError:
+                        responses.append(-5)
+    except socket.timeout:
+        print(f"Timed out after {len(responses)} of {len(commands)} replies")
     except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
-
-def connectStereoToStereo(sock, source_out_1, source_out_2, dest_in_1, dest_in_2, flipped: bool = False):
-    if flipped:
-        command = f"connect {source_out_1} {dest_in_2}"
-        try:
-            response = sendCommand(sock, command).split()[1]
-        except Exception as e:
-            print(f"Error connectingEffects {e}")
-            return -5
-        command = f"connect {source_out_2} {dest_in_1}"
-        try:
-            return [response, sendCommand(sock, command).split()[1]]
-        except Exception as e:
-            print(f"Error connectingEffects {e}")
-            return -5
-    else:
-        command = f"connect {source_out_1} {dest_in_1}"
-        try:
-            response = sendCommand(sock, command).split()[1]
-        except Exception as e:
-            print(f"Error connectingEffects {e}")
-            return -5
-        command = f"connect {source_out_2} {dest_in_2}"
-        try:
-            return [response, sendCommand(sock, command).split()[1]]
-        except Exception as e:
-            print(f"Error connectingEffects {e}")
-            return -5
+        print(f"Failed to read replies: {e}")
 
-def connectStereoToMono(sock, source_out_1,source_out_2, dest):
-    command = f"connect {source_out_1} {dest}"
-    try:
-        response = sendCommand(sock, command).split()[1]
-    except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
-    
-    command = f"connect {source_out_2} {dest}"
-    try:
-        return [response, sendCommand(sock, command).split()[1]]
-    except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
+    return responses + [-5] * (len(commands) - len(responses))
 
-def connectSystemCapturMono(sock, dest):
-    command = f"connect system:capture_1 {dest}"
-    try:
-        response = sendCommand(sock, command).split()[1]
-    except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
-    
-    command = f"connect system:capture_2 {dest}"
+def quitModHost(sock):
+    command = f"quit"
     try:
-        return [response, sendCommand(sock, command).split()[1]]
+        return int(sendCommand(sock, command).split()[1])
     except Exception as e:
-        print(f"Error connectingEffects {e}")
+        print(e)
         return -5
 
-def connectSystemCapturStereo(sock, dest_in_1, dest_in_2):
-    command = f"connect system:capture_1 {dest_in_1}"
+def loadChainHostBoard(sock, jsonFile: str):
+    #Switches a running chain host to another board, the old one rings out under the new one instead of stopping
+    #The host builds and prepares the new board before it answers, so the reply can take longer than other commands
+    command = f"load_board {os.path.abspath(jsonFile)}"
+    timeout = sock.gettimeout()
     try:
-        response = sendCommand(sock, command).split()[1]
-    except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
-    
-    command = f"connect system:capture_2 {dest_in_2}"
-    try:
-        return [response, sendCommand(sock, command).split()[1]]
+        sock.settimeout(5)
+        return int(sendCommand(sock, command).split()[1])
     except Exception as e:
-        print(f"Error connectingEffects {e}")
+        print(e)
         return -5
+    finally:
+        sock.settimeout(timeout)
 
-def connectSystemPlaybackStereo(sock, source_out_1, source_out_2):
-    command = f"connect {source_out_1} system:playback_1"
-    try:
-        response = sendCommand(sock, command).split()[1]
-    except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
-    
-    command = f"connect {source_out_2} system:playback_2"
+def getPedalLoads(sock):
+    #Only the chain host answers pedal_load, with min, average, p99 and max load in percent then the xrun count of each pedal
+    #Returns one (min, average, p99, max, xruns) tuple per pedal in chain order, or None if there was no usable reply
     try:
-        return [response, sendCommand(sock, command).split()[1]]
+        reply = sendCommand(sock, "pedal_load").split()
+        if len(reply) < 2 or reply[0] != "resp" or int(reply[1]) != 0:
+            return None
+        values = reply[2:]
+        return [(float(values[i]), float(values[i+1]), float(values[i+2]), float(values[i+3]), int(values[i+4])) for i in range(0, len(values) - 4, 5)]
     except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
+        print(e)
+        return None
 
-def connectSystemPlaybackMono(sock, source):
-    command = f"connnect {source} system:playback_1"
-    try:
-        response = sendCommand(sock, command).split()[1]
-    except Exception as e:
-        print(f"Error connectingEffects {e}")
-        return -5
-    
-    command = f"connect {source} system:playback_2"
+def addEffect(sock, plugin: plugin_manager.Plugin, instanceNum : int):
+    command = f"add {plugin.uri} {instanceNum}"
     try:
-        return [response, sendCommand(sock, command).split()[1]]
+        return int(sendCommand(sock, command).split()[1])
     except Exception as e:
-        print(f"Error connectingEffects {e}")
+        print(f"Error addingEffect {e}")
         return -5
 
 def updateParameter(sock, instanceNum , parameter: plugin_manager.Parameter):
@@ -252,77 +214,76 @@ def updateBypass(sock, instanceNum, plugin: plugin_manager.Plugin):
         return -5
 
 def setUpPlugins(sock, manager: plugin_manager.PluginManager):
-    added=0
-    for instanceNum, plugin in enumerate(manager.plugins):
-        response = addEffect(sock, plugin, instanceNum)
+    commands = [f"add {plugin.uri} {instanceNum}" for instanceNum, plugin in enumerate(manager.plugins)]
+    responses = sendCommands(sock, commands)
+
+    for instanceNum, (plugin, response) in enumerate(zip(manager.plugins, responses)):
         if(response != instanceNum):
             print(instanceNum)
             print(response)
             print(f"Invalid Plugin found {plugin.name}")
             print("invalid JSON")
             return -5
-        else:
-            print(f"added {plugin.name}")
-            added =+1
-    return added
+        print(f"added {plugin.name}")
+    return len(commands)
 
-def setUpPatch(sock, manager: plugin_manager.PluginManager):
+def patchConnections(manager: plugin_manager.PluginManager):
+    #Port pairs that chain the board from system capture to system playback, or None if a plugin has an invalid channel type
+    connections = []
+    previous = None
     for instanceNum, plugin in enumerate(manager.plugins):
-        if instanceNum == 0:
-            if(plugin.channels == "mono"):
-                connectSystemCapturMono(sock, f"effect_{instanceNum}:{plugin.inputs[0]}")
-            elif(plugin.channels == "stereo"):
-                connectSystemCapturStereo(sock, f"effect_{instanceNum}:{plugin.inputs[0]}", f"effect_{instanceNum}:{plugin.inputs[1]}")
-            else:
-                print(f"Error in plugin JSON {plugin.name}. Invalid channel type: {plugin.channels}")
-                return -5
+        if plugin.channels not in ("mono", "stereo"):
+            print(f"Error in plugin JSON {plugin.name}. Invalid channel type: {plugin.channels}")
+            return None
+        inputs = [f"effect_{instanceNum}:{port}" for port in plugin.inputs]
+        if previous is None:
+            sources = ["system:capture_1", "system:capture_2"]
         else:
-            if(previous.channels == "mono"):
-                if(plugin.channels == "mono"):
-                    connectMonoToMono(sock, f"effect_{instanceNum-1}:{previous.outputs[0]}",
-                                      f"effect_{instanceNum}:{plugin.inputs[0]}")
-                elif(plugin.channels == "stereo"):
-                    connectMonoToStereo(sock, f"effect_{instanceNum-1}:{previous.outputs[0]}",
-                                        f"effect_{instanceNum}:{plugin.inputs[0]}",
-                                        f"effect_{instanceNum}:{plugin.inputs[1]}")
-                else:
-                    print(f"Error in plugin JSON {plugin.name}. Invalid channel type: {plugin.channels}")
-                    return -5
-            elif(previous.channels == "stereo"):
-                if(plugin.channels == "mono"):
-                    connectStereoToMono(sock, f"effect_{instanceNum-1}:{previous.outputs[0]}",
-                                        f"effect_{instanceNum-1}:{previous.outputs[1]}",
-                                        f"effect_{instanceNum}:{plugin.inputs[0]}" )
-                elif(plugin.channels == "stereo"):
-                    connectStereoToStereo(sock, f"effect_{instanceNum-1}:{previous.outputs[0]}",
-                                        f"effect_{instanceNum-1}:{previous.outputs[1]}",
-                                        f"effect_{instanceNum}:{plugin.inputs[0]}",
-                                        f"effect_{instanceNum}:{plugin.inputs[1]}" )
-                else:
-                    print(f"Error in plugin JSON {plugin.name}. Invalid channel type: {plugin.channels}")
-                    return -5
-            else:
-                print(f"Error in plugin JSON {previous.name}. Invalid channel type: {previous.channels}")
-                return -5
-            if instanceNum == len(manager.plugins) - 1:
-                if(plugin.channels == "mono"):
-                    connectSystemPlaybackMono(sock, f"effect_{instanceNum}:{plugin.outputs[0]}")
-                elif(plugin.channels == "stereo"):
-                    connectSystemPlaybackStereo(sock, f"effect_{instanceNum}:{plugin.outputs[0]}", f"effect_{instanceNum}:{plugin.outputs[1]}")
-                else:
-                    print(f"Error in plugin JSON {plugin.name}. Invalid channel type: {plugin.channels}")
-                    return -5
+            sources = [f"effect_{instanceNum-1}:{port}" for port in previous.outputs]
+        if previous is not None and previous.channels == "mono":
+            #A mono output feeds every input
+            connections += [(sources[0], dest) for dest in inputs[:2]]
+        elif plugin.channels == "mono":
+            #Both stereo sources are mixed into a mono input
+            connections += [(source, inputs[0]) for source in sources[:2]]
+        else:
+            connections += list(zip(sources[:2], inputs[:2]))
         previous = plugin
 
+    if previous is not None:
+        outputs = [f"effect_{len(manager.plugins)-1}:{port}" for port in previous.outputs]
+        if previous.channels == "mono":
+            outputs = [outputs[0], outputs[0]]
+        connections += list(zip(outputs[:2], ["system:playback_1", "system:playback_2"]))
+    return connections
+
+def setUpPatch(sock, manager: plugin_manager.PluginManager):
+    connections = patchConnections(manager)
+    if connections is None:
+        return -5
+    responses = sendCommands(sock, [f"connect {source} {dest}" for source, dest in connections])
+    for (source, dest), response in zip(connections, responses):
+        if response != 0:
+            print(f"Error connectingEffects {source} {dest}: {response}")
+    return 0
+
 def varifyParameters(sock, manager: plugin_manager.PluginManager):
+    commands = []
+    names = []
     badParameters = []
     for instanceNum, plugin in enumerate(manager.plugins):
-        for instanceNumP, parameter in enumerate(plugin.parameters):
-            val = updateParameter(sock, instanceNum, parameter)
-            if(val != 0):
+        for parameter in plugin.parameters:
+            if(parameter.type == "lv2"):
+                commands.append(f"param_set {instanceNum} {parameter.symbol} {parameter.value}")
+            elif(parameter.type == "plug"):
+                commands.append(f"patch_set {instanceNum} {parameter.symbol} {parameter.value}")
+            else:
                 badParameters.append((plugin.name,parameter.name))
-            time.sleep(.1)
+                continue
+            names.append((plugin.name,parameter.name))
+
+    for name, response in zip(names, sendCommands(sock, commands)):
+        if(response != 0):
+            badParameters.append(name)
     
     return badParameters
-
-
@@ -20,6 +20,9 @@
 
 #pragma once
 
+#include "PhaserEngine.h"
+#include "PluginState.h"
+
 
 //==============================================================================
 class PhaserProcessor final : public juce::AudioProcessor
@@ -35,23 +38,19 @@ public:
         // adding parameters as well as their bounds
 	    addParameter (rate = new juce::AudioParameterFloat ({ "rate", 1 }, "Rate", 0.0f, 25.0f, 0.5f));
 	    addParameter (depth = new juce::AudioParameterFloat ({ "depth", 1 }, "Depth", 0.01f, 0.99f, 0.5f));
-	    addParameter (centreFreq = new juce::AudioParameterFloat ({ "centreFreq", 1 }, "Centre Frequency", 0.0f, 600.0f, 100.0f)); 
+	    addParameter (centreFreq = new juce::AudioParameterFloat ({ "centreFreq", 1 }, "Centre Frequency", 0.0f, 4000.0f, 100.0f));
 	    addParameter (feedback = new juce::AudioParameterFloat ({ "feedback", 1 }, "Feedback", -0.99f, 0.99f, 0.0f));
 	    addParameter (mix = new juce::AudioParameterFloat ({ "mix", 1 }, "Mix", 0.0f, 1.0f, 0.5f));
+	    addParameter (stages = new juce::AudioParameterInt ({ "stages", 1 }, "Stages", PhaserEngine::minStages, PhaserEngine::maxStages, 6));
     }
 
     //==============================================================================
     // This function is used before audio processing. It lets you initialize variables and set up any other resources prior to running the plugin
     void prepareToPlay (double samplerate, int samplesPerBlock) override 
     {
-        // initialize the processor and set initial parameter values
-	    juce::dsp::ProcessSpec spec { samplerate, static_cast<uint32_t>(samplesPerBlock), static_cast<uint32_t>(getTotalNumOutputChannels()) };
-	    phaser.prepare(spec);
-	    phaser.setRate(0.5f);
-	    phaser.setDepth(0.5f);
-	    phaser.setCentreFrequency(100.0f);
-	    phaser.setFeedback(0.0f);
-	    phaser.setMix(0.5f);
+        // initialize the processor with the current parameter values, so it starts without a glide
+	    phaser.setParameters (getPhaserParameters());
+	    phaser.prepare (samplerate, samplesPerBlock);
     }
     // This function is usually called after the plugin stops taking in audio. It can deallocate any memory used and clean out buffers
     void releaseResources() override {}
@@ -59,23 +58,13 @@ public:
     // This is where all the audio processing happens. One block of audio input is handled at a time.
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
-        juce::dsp::AudioBlock<float> block (buffer);
-	    juce::dsp::ProcessContextReplacing<float> context (block);
-	
-	    // read the values of the parameters in from the GUI
-	    auto rateValue = rate->get();
-	    auto depthValue = depth->get();
-	    auto centreFreqValue = centreFreq->get();
-	    auto feedbackValue = feedback->get();
-	    auto mixValue = mix->get();
-
-	    // update parameters and apply them to the audio block with process()
-	    phaser.setRate(rateValue);
-	    phaser.setDepth(depthValue);
-	    phaser.setCentreFrequency(centreFreqValue);
-	    phaser.setFeedback(feedbackValue);
-	    phaser.setMix(mixValue);
-	    phaser.process(context);
+        // update parameters every block; the engine only recomputes what has changed since the last block
+	    phaser.setParameters (getPhaserParameters());
+
+	    if (buffer.getNumChannels() > 1)
+	        phaser.processStereo (buffer.getWritePointer (0), buffer.getWritePointer (1), buffer.getNumSamples());
+	    else if (buffer.getNumChannels() == 1)
+	        phaser.processMono (buffer.getWritePointer (0), buffer.getNumSamples());
     }
 
     //==============================================================================
@@ -107,21 +96,13 @@ public:
     // in the next session of running the pedal
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	    juce::MemoryOutputStream (destData, true).writeFloat (*rate);
-	    juce::MemoryOutputStream (destData, true).writeFloat (*depth);
-	    juce::MemoryOutputStream (destData, true).writeFloat (*centreFreq);
-	    juce::MemoryOutputStream (destData, true).writeFloat (*feedback);
-	    juce::MemoryOutputStream (destData, true).writeFloat (*mix);
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
     void setStateInformation (const void* data, int sizeInBytes) override
-    {    
-	    rate->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	    depth->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	    centreFreq->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	    feedback->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-	    mix->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+    {
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -136,12 +117,27 @@ public:
 
 private:
     //==============================================================================
-    juce::dsp::Phaser<float> phaser;
+    // read the values of the parameters in from the GUI
+    PhaserEngine::Parameters getPhaserParameters() const
+    {
+        PhaserEngine::Parameters parameters;
+        parameters.rate = rate->get();
+        parameters.depth = depth->get();
+        parameters.centreFrequency = centreFreq->get();
+        parameters.feedback = feedback->get();
+        parameters.mix = mix->get();
+        parameters.numStages = stages->get();
+        return parameters;
+    }
+
+    //==============================================================================
+    PhaserEngine phaser;
     juce::AudioParameterFloat* rate; //the rate (in Hz) of the LFO modulating the phaser all-pass filters. (Must be <100Hz)
     juce::AudioParameterFloat* depth; //the volume (between 0 and 1) of the LFO modulating the phaser all-pass filters
     juce::AudioParameterFloat* centreFreq; //the centre frequency (in Hz) of the phaser all-pass filters modulation
     juce::AudioParameterFloat* feedback; //the feedback volume (between -1 and 1) of the phaser. (Negative can be used to get specific phaser sounds)
     juce::AudioParameterFloat* mix; //the amount of dry and wet signal in the output of the phaser (between 0 for full dry and 1 for full wet)
+    juce::AudioParameterInt* stages; //the number of all-pass filters in the cascade (between 2 and 12). Each pair adds a notch to the sweep
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PhaserProcessor)
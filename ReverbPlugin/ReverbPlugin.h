@@ -52,6 +52,10 @@
 
 #pragma once
 
+#include "FdnReverbEngine.h"
+#include "FreeverbEngine.h"
+#include "PluginState.h"
+
 
 //==============================================================================
 class ReverbProcessor final : public juce::AudioProcessor
@@ -69,21 +73,29 @@ public:
         addParameter (dryLevel = new juce::AudioParameterFloat ({ "dryLevel", 1 }, "Dry Level", 0.0f, 1.0f, 0.5f));
         addParameter (width = new juce::AudioParameterFloat ({ "width", 1 }, "Width", 0.0f, 1.0f, 0.5f)); // 1 is very wide
         addParameter (freezeMode = new juce::AudioParameterFloat ({ "freezeMode", 1 }, "Freeze Mode", 0.0f, 1.0f, 0.0f)); // Enters freeze mode above 0.5
+        addParameter (quality = new juce::AudioParameterInt ({ "quality", 1 }, "Quality (Low/Medium/High)", 0, 2, 2)); // Low runs half the filters for about half the CPU, or 4 FDN lines instead of 16
+        addParameter (algorithm = new juce::AudioParameterInt ({ "algorithm", 1 }, "Algorithm (Freeverb/FDN)", 0, 1, 0));
     }
 
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override
     {   
-        // Sets reverb parameters
-        reverbParams.roomSize = roomSize->get();
-        reverbParams.damping = damping->get();
-        reverbParams.wetLevel = wetLevel->get();
-        reverbParams.dryLevel = dryLevel->get();
-        reverbParams.width = width->get();
-        reverbParams.freezeMode = freezeMode->get();
+        // The engine jumps to the parameters set before it is prepared instead of gliding from silence
+        reverb.setParameters (getReverbParameters());
+        reverb.setQuality (quality->get());
+        reverb.prepare (sampleRate, samplesPerBlock);
+        reverb.reset();
+        
+        fdnReverb.setParameters (getReverbParameters());
+        fdnReverb.setQuality (quality->get());
+        fdnReverb.prepare (sampleRate, samplesPerBlock);
+        
+        // Holds the output of the engine fading out while the two are crossfaded
+        fadeBuffer.setSize (2, juce::jmax (1, samplesPerBlock));
+        fadeStep = 1.0f / (float) juce::jmax (1.0, crossfadeSeconds * sampleRate);
+        fadeGain = 1.0f;
         
-        reverb.setParameters (reverbParams);
-        reverb.setSampleRate (sampleRate);
+        currentAlgorithm = algorithm->get();
     }
     
     void releaseResources() override {}
@@ -93,13 +105,54 @@ public:
         // Determines number of input channels for either mono or stereo processing
         totalNumInputChannels = getTotalNumInputChannels();
         
-        if (totalNumInputChannels == 1)
+        // The engine switched to starts from silence, it still holds the tail from when it last ran.
+        // The two are crossfaded the way the chain host crossfades boards, so the old tail fades out instead of stopping.
+        if (algorithm->get() != currentAlgorithm)
         {
-            reverb.processMono (buffer.getWritePointer(0), buffer.getNumSamples());
+            currentAlgorithm = algorithm->get();
+            
+            if (fadeGain < 1.0f)
+            {
+                // Switched back before the crossfade finished: the engine fading out is still playing, so it fades back in from where it is
+                fadeGain = 1.0f - fadeGain;
+            }
+            else
+            {
+                if (currentAlgorithm == 0)
+                    reverb.reset();
+                else
+                    fdnReverb.reset();
+                
+                fadeGain = 0.0f;
+            }
         }
-        else
+        
+        if (fadeGain >= 1.0f)
+        {
+            process (currentAlgorithm, buffer, 0, buffer.getNumSamples());
+            return;
+        }
+        
+        const int numChannels = juce::jmin (totalNumInputChannels, 2);
+        
+        for (int start = 0; start < buffer.getNumSamples(); start += fadeBuffer.getNumSamples())
         {
-            reverb.processStereo (buffer.getWritePointer(0), buffer.getWritePointer(1), buffer.getNumSamples());
+            const int chunk = juce::jmin (fadeBuffer.getNumSamples(), buffer.getNumSamples() - start);
+            const auto fadeEnd = juce::jmin (1.0f, fadeGain + fadeStep * (float) chunk);
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+                fadeBuffer.copyFrom (channel, 0, buffer, channel, start, chunk);
+            
+            process (1 - currentAlgorithm, fadeBuffer, 0, chunk);
+            process (currentAlgorithm, buffer, start, chunk);
+            
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                buffer.applyGainRamp (channel, start, chunk, fadeGain, fadeEnd);
+                buffer.addFromWithRamp (channel, start, fadeBuffer.getReadPointer (channel), chunk, 1.0f - fadeGain, 1.0f - fadeEnd);
+            }
+            
+            fadeGain = fadeEnd;
         }
     }
 
@@ -123,22 +176,12 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-        juce::MemoryOutputStream (destData, true).writeFloat (*roomSize);
-        juce::MemoryOutputStream (destData, true).writeFloat (*damping);
-        juce::MemoryOutputStream (destData, true).writeFloat (*wetLevel);
-        juce::MemoryOutputStream (destData, true).writeFloat (*dryLevel);
-        juce::MemoryOutputStream (destData, true).writeFloat (*width);
-        juce::MemoryOutputStream (destData, true).writeFloat (*freezeMode);
+        PluginState::save (*this, destData);
     }
 
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        roomSize->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        damping->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        wetLevel->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        dryLevel->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        width->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        freezeMode->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -152,8 +195,52 @@ public:
 
 private:
     //==============================================================================
-    juce::Reverb reverb;
-    juce::Reverb::Parameters reverbParams;
+    juce::Reverb::Parameters getReverbParameters() const
+    {
+        juce::Reverb::Parameters reverbParams;
+        reverbParams.roomSize = roomSize->get();
+        reverbParams.damping = damping->get();
+        reverbParams.wetLevel = wetLevel->get();
+        reverbParams.dryLevel = dryLevel->get();
+        reverbParams.width = width->get();
+        reverbParams.freezeMode = freezeMode->get();
+        return reverbParams;
+    }
+    
+    void process (int algorithmToUse, juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+    {
+        if (algorithmToUse == 0)
+            process (reverb, buffer, startSample, numSamples);
+        else
+            process (fdnReverb, buffer, startSample, numSamples);
+    }
+    
+    // Only does any work when a knob has moved since the last block
+    template <typename Engine>
+    void process (Engine& engine, juce::AudioBuffer<float>& buffer, int startSample, int numSamples)
+    {
+        engine.setParameters (getReverbParameters());
+        engine.setQuality (quality->get());
+        
+        if (totalNumInputChannels == 1)
+        {
+            engine.processMono (buffer.getWritePointer(0, startSample), numSamples);
+        }
+        else
+        {
+            engine.processStereo (buffer.getWritePointer(0, startSample), buffer.getWritePointer(1, startSample), numSamples);
+        }
+    }
+    
+    //==============================================================================
+    FreeverbEngine reverb;
+    FdnReverbEngine fdnReverb;
+    int currentAlgorithm = 0;
+    
+    static constexpr double crossfadeSeconds = 0.01;
+    juce::AudioBuffer<float> fadeBuffer;
+    float fadeGain = 1.0f;      // Of the current engine, the one fading out plays at 1 - fadeGain
+    float fadeStep = 0.0f;      // Per sample
     
     juce::AudioParameterFloat* roomSize;
     juce::AudioParameterFloat* damping;
@@ -161,9 +248,11 @@ private:
     juce::AudioParameterFloat* dryLevel;
     juce::AudioParameterFloat* width;
     juce::AudioParameterFloat* freezeMode;
+    juce::AudioParameterInt* quality;
+    juce::AudioParameterInt* algorithm;
     
     int totalNumInputChannels;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (ReverbProcessor)
-};
\ No newline at end of file
+};
\ No newline at end of file
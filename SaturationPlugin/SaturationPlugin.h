@@ -20,9 +20,15 @@
 
 #pragma once
 
+#include "AntiderivativeWaveshaper.h"
+#include "OversampledWaveshaper.h"
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
 
 //==============================================================================
-class SaturationProcessor final : public juce::AudioProcessor
+class SaturationProcessor final : public juce::AudioProcessor,
+                                  private juce::AsyncUpdater
 {
 public:
 
@@ -36,11 +42,29 @@ public:
         addParameter (mode = new juce::AudioParameterInt({ "mode", 1 }, "Mode", 0, 2, 0));
         addParameter (sc1 = new juce::AudioParameterFloat({ "sc1", 1 }, "Soft Clipping Factor (Mode 1)", 1.0f, 10.0f, 1.0f));
         addParameter (sc2 = new juce::AudioParameterFloat({ "sc2", 1 }, "Soft Clipping Factor (Mode 2)", 0.0f, 0.4f, 0.333f));
+        addParameter (oversampling = new juce::AudioParameterInt ({ "oversampling", 1 }, "Oversampling (1x/2x/4x/8x)", 0, OversampledWaveshaper::maxFactorLog2, 2));
+        addParameter (filter = new juce::AudioParameterInt ({ "filter", 1 }, "Oversampling Filter (IIR/FIR)", 0, 1, OversampledWaveshaper::iir));
+        addParameter (antialiasing = new juce::AudioParameterInt ({ "antialiasing", 1 }, "Antialiasing (Off/ADAA1/ADAA2)", 0, 2, AntiderivativeWaveshaper::off));
+        addParameter (approximation = new juce::AudioParameterInt ({ "approximation", 1 }, "Math (Exact/Fast)", 0, 1, 0));
     }
 
     //==============================================================================
     // This function is used before audio processing. It lets you initialize variables and set up any other resources prior to running the plugin
-    void prepareToPlay (double, int) override {}
+    void prepareToPlay (double sampleRate, int samplesPerBlock) override
+    {
+        // gain and both clipping factors glide to new values instead of jumping once per block
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
+        smoothedA1.prepare (sampleRate, samplesPerBlock, sc1->get());
+        smoothedA2.prepare (sampleRate, samplesPerBlock, sc2->get());
+
+        // both clipping curves run oversampled so their harmonics are filtered out instead of aliasing
+        waveshaper.prepare (getTotalNumOutputChannels(), samplesPerBlock);
+        adaa.prepare (getTotalNumOutputChannels());
+        waveshaper.setOversampling (mode->get() == 0 ? 0 : oversampling->get(), filter->get());
+        adaa.setOrder (mode->get() == 0 ? 0 : antialiasing->get());
+        latency = waveshaper.getLatencyInSamples (adaa.getLatencyInSamples());
+        setLatencySamples (latency);
+    }
     // This function is usually called after the plugin stops taking in audio. It can deallocate any memory used and clean out buffers
     void releaseResources() override {}
 
@@ -48,31 +72,49 @@ public:
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
         
-        auto gainValue = gain->get();
         int modeValue = mode->get();
-        auto a1Value = sc1->get();
-        auto a2Value = sc2->get();
+        
+        smoothedGain.update (gain->get(), buffer.getNumSamples());
+        smoothedA1.update (sc1->get(), buffer.getNumSamples());
+        smoothedA2.update (sc2->get(), buffer.getNumSamples());
+        
+        // mode 0 leaves the signal untouched, so it does not need the oversampler or its latency
+        waveshaper.setOversampling (modeValue == 0 ? 0 : oversampling->get(), filter->get());
+        adaa.setOrder (modeValue == 0 ? 0 : antialiasing->get());
+        
+        // The host is told about a new latency from the message thread, never from here
+        const int newLatency = waveshaper.getLatencyInSamples (adaa.getLatencyInSamples());
+        
+        if (latency.exchange (newLatency) != newLatency)
+            triggerAsyncUpdate();
         
         switch(modeValue) {
             case 1: // soft clipping
                 for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
                     auto* channelData = buffer.getWritePointer(channel);
-                    for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-                        float processedSample = channelData[sample] * gainValue; // applying gain
-                        processedSample = 2/(juce::MathConstants<float>::pi)*atan(a1Value*processedSample); // apply soft clipping
-                        channelData[sample] = processedSample;
-                    }
+                    
+                    // the clipping factor only scales the input of atan, so it is applied with the gain as whole-block multiplies
+                    smoothedGain.applyGain (channelData, buffer.getNumSamples()); // applying gain
+                    smoothedA1.applyGain (channelData, buffer.getNumSamples());
                 }
+                
+                // apply soft clipping, 2/pi*atan(x), optionally antialiased. The fast atan only replaces the curve
+                // itself, the antiderivatives need full precision
+                if (approximation->get() == 1)
+                    softClip<ClippingCurve::FastArctangent> (buffer);
+                else
+                    softClip<ClippingCurve::Arctangent> (buffer);
                 break;
             case 2: // cubic soft clipping
                 for (int channel = 0; channel < buffer.getNumChannels(); ++channel) {
                     auto* channelData = buffer.getWritePointer(channel);
-                    for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-                        float processedSample = channelData[sample] * gainValue; // applying gain
-                        processedSample = processedSample-a2Value*pow(processedSample,3); // apply soft clipping
-                        channelData[sample] = processedSample;
-                    }
+                    smoothedGain.applyGain (channelData, buffer.getNumSamples()); // applying gain
                 }
+                
+                if (smoothedA2.isSmoothing())
+                    cubicClip<true> (buffer);
+                else
+                    cubicClip<false> (buffer);
                 break;
             default: 
                 // do nothing
@@ -115,19 +157,13 @@ public:
     // in the next session of running the pedal
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	    juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeInt (*mode);
-        juce::MemoryOutputStream (destData, true).writeFloat (*sc1);
-        juce::MemoryOutputStream (destData, true).writeFloat (*sc2);
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        mode->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readInt());
-        sc1->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        sc2->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -142,11 +178,50 @@ public:
     }
 
 private:
+    //==============================================================================
+    template <typename Curve>
+    void softClip (juce::AudioBuffer<float>& buffer)
+    {
+        waveshaper.processChannels (buffer, [this] (int channel, float* channelData, int numSamples, int) {
+            adaa.process<Curve> (channel, channelData, numSamples, [] (int) { return 0.0f; });
+        });
+    }
+    
+    // Cubic soft clipping of every channel, x - a*x^3, oversampled and optionally antialiased. isRamping selects whether the
+    // factor is read per sample or once
+    template <bool isRamping>
+    void cubicClip (juce::AudioBuffer<float>& buffer)
+    {
+        waveshaper.processChannels (buffer, [this] (int channel, float* channelData, int numSamples, int firstSample) {
+            adaa.process<ClippingCurve::Cubic> (channel, channelData, numSamples, [this, firstSample] (int sample) {
+                return smoothedA2.get<isRamping> (waveshaper.getBaseSample (firstSample, sample));
+            });
+        });
+    }
+    
+    // Reports the latency processBlock() last switched to
+    void handleAsyncUpdate() override
+    {
+        setLatencySamples (latency.load());
+    }
+    
     //==============================================================================
     juce::AudioParameterFloat* gain;
     juce::AudioParameterInt* mode;
     juce::AudioParameterFloat* sc1;
     juce::AudioParameterFloat* sc2;
+    juce::AudioParameterInt* oversampling;
+    juce::AudioParameterInt* filter;
+    juce::AudioParameterInt* antialiasing;
+    juce::AudioParameterInt* approximation;
+    
+    SmoothedParameter smoothedGain;
+    SmoothedParameter smoothedA1;
+    SmoothedParameter smoothedA2;
+    
+    OversampledWaveshaper waveshaper;
+    AntiderivativeWaveshaper adaa;
+    std::atomic<int> latency { 0 }; // Of the settings in use, in samples
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SaturationProcessor)
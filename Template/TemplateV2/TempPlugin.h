@@ -20,6 +20,8 @@
 
 #pragma once
 
+#include "PluginState.h"
+
 
 //==============================================================================
 class TempProcessor final : public juce::AudioProcessor
@@ -118,19 +120,17 @@ public:
     //==============================================================================
     // This function saves the current state of each parameter to memory so that we can load the state of each parameter 
     // in the next session of running the pedal
-    // TODO: Save the value of your parameter to memory. Make sure you do this for every one of your parameters.
+    // Every parameter added with addParameter is saved, so there is nothing to add here
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-	// Example: 
-	// juce::MemoryOutputStream (destData, true).writeFloat (*gain);
+        PluginState::save (*this, destData);
     }
 
     // This function recalls the state of the parameters from the last session ran and restores it into the parameter
-    // TODO: Read the value into your parameter from memory. Make sure you do this for every one of your parameters.
+    // Parameters missing from an older state keep their current value
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        // Example:
-	// gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
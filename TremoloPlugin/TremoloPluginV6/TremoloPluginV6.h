@@ -51,6 +51,10 @@
 
 #pragma once
 
+#include "LFOShapes.h"
+#include "PluginState.h"
+#include "SmoothedParameter.h"
+
 
 //==============================================================================
 class TremoloProcessor final : public juce::AudioProcessor
@@ -73,28 +77,13 @@ public:
     //==============================================================================
     void prepareToPlay (double sampleRate, int samplesPerBlock) override
     {
-        // Same ProcessSpec used for all LFOs
-        juce::dsp::ProcessSpec spec;
-        spec.maximumBlockSize = samplesPerBlock;
-        spec.sampleRate = sampleRate;
-        spec.numChannels = getTotalNumOutputChannels();
-        
-        // Initializes all LFOs
-        chnl1sineLFO.prepare (spec);
-        chnl2sineLFO.prepare (spec);
-        chnl1sawLFO.prepare (spec);
-        chnl2sawLFO.prepare (spec);
-        chnl1squareLFO.prepare (spec);
-        chnl2squareLFO.prepare (spec);
+        // Initializes both LFOs
+        for (auto& lfo : channelLFO)
+            lfo.prepare (sampleRate);
         
-        // Updates rate of all LFOs
-        rateFloat = rate->get();
-        chnl1sineLFO.setFrequency (rateFloat);
-        chnl2sineLFO.setFrequency (rateFloat);
-        chnl1sawLFO.setFrequency (rateFloat);
-        chnl2sawLFO.setFrequency (rateFloat);
-        chnl1squareLFO.setFrequency (rateFloat);
-        chnl2squareLFO.setFrequency (rateFloat);
+        // Depth and gain glide to new values instead of stepping once per block
+        smoothedDepth.prepare (sampleRate, samplesPerBlock, depth->get());
+        smoothedGain.prepare (sampleRate, samplesPerBlock, gain->get());
     }
     
     void releaseResources() override {}
@@ -102,81 +91,24 @@ public:
     void processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer&) override
     {
         rateFloat = rate->get();
-        depthFloat = depth->get();
-        gainFloat = gain->get();
         waveformInt = waveform->get();
         
         totalNumInputChannels = getTotalNumInputChannels();
         
-        chnl1sineLFO.setFrequency (rateFloat);
-        chnl2sineLFO.setFrequency (rateFloat);
-        chnl1sawLFO.setFrequency (rateFloat);
-        chnl2sawLFO.setFrequency (rateFloat);
-        chnl1squareLFO.setFrequency (rateFloat);
-        chnl2squareLFO.setFrequency (rateFloat);
+        smoothedDepth.update (depth->get(), buffer.getNumSamples());
+        smoothedGain.update (gain->get(), buffer.getNumSamples());
+        
+        // The waveform and whether a parameter is ramping are resolved once per block, the kernel then runs without branching
+        auto* kernel = selectKernel (waveformInt, smoothedDepth.isSmoothing() || smoothedGain.isSmoothing());
+        
+        if (kernel == nullptr) // Pass-Through
+            return;
         
-        for (int channel = 0; channel < totalNumInputChannels; ++channel)
+        // Both channels have their own LFO for stereo input
+        for (int channel = 0; channel < juce::jmin (totalNumInputChannels, (int) channelLFO.size()); ++channel)
         {
-            auto* channelData = buffer.getWritePointer (channel);
-            
-            switch(waveformInt)
-            {
-                case 1: // Sinusoidal LFO
-                    // Both channels have their own LFO for stereo input
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            // Tremolo and gain applied to audio sample
-                            channelData[sample] = (channelData[sample] * (depthFloat * chnl1sineLFO.processSample(0.0f) + (1.0f - depthFloat))) * gainFloat;
-                        }
-                    }
-                    else // Handles the second channel for stereo input but doesn't run for mono input
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            channelData[sample] = (channelData[sample] * (depthFloat * chnl2sineLFO.processSample(0.0f) + (1.0f - depthFloat))) * gainFloat;
-                        }
-                    }
-                    break;
-                    
-                case 2: // Saw Wave LFO
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            channelData[sample] = (channelData[sample] * (depthFloat * chnl1sawLFO.processSample(0.0f) + (1.0f - depthFloat))) * gainFloat;
-                        }
-                    }
-                    else
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            channelData[sample] = (channelData[sample] * (depthFloat * chnl2sawLFO.processSample(0.0f) + (1.0f - depthFloat))) * gainFloat;
-                        }
-                    }
-                    break;
-                    
-                case 3: // Square Wave LFO
-                    if (channel == 0)
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            channelData[sample] = (channelData[sample] * (depthFloat * chnl1squareLFO.processSample(0.0f) + (1.0f - depthFloat))) * gainFloat;
-                        }
-                    }
-                    else
-                    {
-                        for (int sample = 0; sample < buffer.getNumSamples(); ++sample)
-                        {
-                            channelData[sample] = (channelData[sample] * (depthFloat * chnl2squareLFO.processSample(0.0f) + (1.0f - depthFloat))) * gainFloat;
-                        }
-                    }
-                    break;
-                    
-                default: // Pass-Through
-                    break;
-            } 
+            channelLFO[(size_t) channel].setFrequency (rateFloat);
+            kernel (buffer.getWritePointer (channel), buffer.getNumSamples(), channelLFO[(size_t) channel], smoothedDepth, smoothedGain);
         }
     }
 
@@ -200,18 +132,12 @@ public:
     //==============================================================================
     void getStateInformation (juce::MemoryBlock& destData) override
     {
-        juce::MemoryOutputStream (destData, true).writeFloat (*rate);
-        juce::MemoryOutputStream (destData, true).writeFloat (*depth);
-        juce::MemoryOutputStream (destData, true).writeFloat (*gain);
-        juce::MemoryOutputStream (destData, true).writeInt (*waveform);
+        PluginState::save (*this, destData);
     }
 
     void setStateInformation (const void* data, int sizeInBytes) override
     {
-        rate->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        depth->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        gain->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readFloat());
-        waveform->setValueNotifyingHost (juce::MemoryInputStream (data, static_cast<size_t> (sizeInBytes), false).readInt());
+        PluginState::load (*this, data, sizeInBytes);
     }
 
     //==============================================================================
@@ -224,6 +150,33 @@ public:
     }
 
 private:
+    //==============================================================================
+    using Kernel = void (*) (float*, int, LFOPhase&, const SmoothedParameter&, const SmoothedParameter&);
+    
+    // Tremolo and gain applied to one channel, with the LFO shape and whether depth and gain ramp fixed at compile time
+    template <typename Shape, bool isRamping>
+    static void tremoloKernel (float* channelData, int numSamples, LFOPhase& lfo, const SmoothedParameter& depth, const SmoothedParameter& gain)
+    {
+        for (int sample = 0; sample < numSamples; ++sample)
+        {
+            const float depthValue = depth.get<isRamping> (sample);
+            channelData[sample] = (channelData[sample] * (depthValue * Shape::value (lfo.phaseAt (sample)) + (1.0f - depthValue))) * gain.get<isRamping> (sample);
+        }
+        
+        lfo.advance (numSamples);
+    }
+    
+    // Returns the kernel for the waveform parameter, or nullptr for Pass-Through
+    static Kernel selectKernel (int waveformIndex, bool isRamping)
+    {
+        static constexpr Kernel kernels[][2] = { { nullptr, nullptr },                                                                  // Pass-Through
+                                                 { &tremoloKernel<LFOShape::Sine, false>,   &tremoloKernel<LFOShape::Sine, true> },     // Sinusoidal LFO
+                                                 { &tremoloKernel<LFOShape::Saw, false>,    &tremoloKernel<LFOShape::Saw, true> },      // Saw Wave LFO
+                                                 { &tremoloKernel<LFOShape::Square, false>, &tremoloKernel<LFOShape::Square, true> } }; // Square Wave LFO
+        
+        return kernels[juce::jlimit (0, 3, waveformIndex)][isRamping ? 1 : 0];
+    }
+    
     //==============================================================================
     juce::AudioParameterFloat* rate;
     juce::AudioParameterFloat* depth;
@@ -231,19 +184,14 @@ private:
     juce::AudioParameterInt* waveform;
     
     float rateFloat;
-    float depthFloat;
-    float gainFloat;
     int waveformInt;
     
     int totalNumInputChannels;
     
-    // The last argument for the following lines is the number of points in the lookup table
-    juce::dsp::Oscillator<float> chnl1sineLFO { [](float x) { return std::sin (x); }, 500 }; // Sine Wave
-    juce::dsp::Oscillator<float> chnl1sawLFO { [](float x) { return x / juce::MathConstants<float>::pi; }, 10000 }; // Saw Wave
-    juce::dsp::Oscillator<float> chnl1squareLFO { [](float x) { return x < 0.0f ? -1.0f : 1.0f; }, 10000 }; // Square Wave
-    juce::dsp::Oscillator<float> chnl2sineLFO { [](float x) { return std::sin (x); }, 500 }; // Sine Wave
-    juce::dsp::Oscillator<float> chnl2sawLFO { [](float x) { return x / juce::MathConstants<float>::pi; }, 10000 }; // Saw Wave
-    juce::dsp::Oscillator<float> chnl2squareLFO { [](float x) { return x < 0.0f ? -1.0f : 1.0f; }, 10000 }; // Square Wave
+    std::array<LFOPhase, 2> channelLFO; // One LFO per channel, shared by every waveform
+    
+    SmoothedParameter smoothedDepth;
+    SmoothedParameter smoothedGain;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TremoloProcessor)
@@ -0,0 +1,12 @@
+#include "juce_stub.h"
+#include "/root/repo/Common/FastMath.h"
+#include <cstdio>
+int main(){
+  double ea=0, et=0, ee=0, el=0, ela=0; float xa=0,xt=0,xe=0,xl=0;
+  for (double x=-1000; x<=1000; x+=0.0007){ float f=(float)x; double e=fabs(FastMath::atan(f)-atan((double)f)); if(e>ea){ea=e;xa=f;} }
+  for (double x=-20; x<=20; x+=0.00003){ float f=(float)x; double e=fabs(FastMath::tanh(f)-tanh((double)f)); if(e>et){et=e;xt=f;} }
+  for (double x=-87.3; x<=88.3; x+=0.0001){ float f=(float)x; double r=exp((double)f); double e=fabs(FastMath::exp(f)-r)/r; if(e>ee){ee=e;xe=f;} }
+  for (double x=1e-30; x<1e30; x*=1.00001){ float f=(float)x; double r=log((double)f); double e=fabs(FastMath::log(f)-r)/fabs(r); if (fabs(r)>1e-3 && e>el){el=e;xl=f;} if (f>=0.25f&&f<=4.0f){ double a=fabs(FastMath::log(f)-r); if(a>ela) ela=a;} }
+  printf("atan abs %.3g at %g\ntanh abs %.3g at %g\nexp rel %.3g at %g\nlog rel %.3g at %g, abs[0.25,4] %.3g\n", ea,xa,et,xt,ee,xe,el,xl,ela);
+  printf("exp(88.7)=%g exp(-88)=%g log(0)=%g log(-1)=%g\n", FastMath::exp(88.7f), FastMath::exp(-88.f), FastMath::log(0.f), FastMath::log(-1.f));
+}